@@ -0,0 +1,237 @@
+#include "alloc.h"
+#include "utils.h"
+#include <string.h>
+
+// Put in front of every block, it keeps the block itself 16-byte aligned
+typedef struct alloc_header {
+    _Alignas(16) allocator_t* owner;
+    size_t size;
+} alloc_header_t;
+
+static void* heap_alloc(allocator_t* self, size_t size)
+{
+    (void)self;
+    return malloc(size);
+}
+
+static void heap_free(allocator_t* self, void* ptr, size_t size)
+{
+    (void)self;
+    (void)size;
+    free(ptr);
+}
+
+static allocator_t heap = { .alloc = heap_alloc, .free = heap_free };
+
+static _Thread_local allocator_t* current = &heap;
+
+// Installs allocator as the current one of the calling thread, or the heap
+// if it is NULL. Returns the previous one, to restore it at the end of the
+// scope.
+allocator_t* alloc_use(allocator_t* allocator)
+{
+    allocator_t* previous = current;
+
+    current = allocator != NULL ? allocator : &heap;
+    return previous;
+}
+
+void* alloc_new(size_t size)
+{
+    alloc_header_t* header = current->alloc(current, sizeof(*header) + size);
+    CHECK_NOT_NULL(header);
+
+    header->owner = current;
+    header->size  = size;
+
+    return header + 1;
+}
+
+void alloc_free(void* ptr)
+{
+    if (ptr == NULL) {
+        return;
+    }
+
+    alloc_header_t* header = (alloc_header_t*)ptr - 1;
+    header->owner->free(header->owner, header, sizeof(*header) + header->size);
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+struct arena_chunk {
+    arena_chunk_t* next;
+    size_t         size;
+
+    _Alignas(16) char data[];
+};
+
+#define ARENA_ROUND(size) (((size) + 15) & ~(size_t)15)
+
+static void* arena_alloc(allocator_t* self, size_t size)
+{
+    arena_t* arena = (arena_t*)self;
+
+    size = ARENA_ROUND(size);
+
+    if (arena->chunk == NULL || arena->used + size > arena->chunk->size) {
+        arena_chunk_t* next = arena->chunk != NULL ? arena->chunk->next : arena->head;
+
+        // The chunks after a rewind are reused when the block fits, a new
+        // one is linked in before them otherwise
+        if (next == NULL || next->size < size) {
+            size_t         bytes = size > arena->chunk_size ? size : arena->chunk_size;
+            arena_chunk_t* chunk = malloc(sizeof(*chunk) + bytes);
+            CHECK_NOT_NULL(chunk);
+
+            chunk->size = bytes;
+            chunk->next = next;
+
+            if (arena->chunk != NULL) {
+                arena->chunk->next = chunk;
+            } else {
+                arena->head = chunk;
+            }
+
+            next = chunk;
+        }
+
+        arena->chunk = next;
+        arena->used  = 0;
+    }
+
+    void* ptr = &arena->chunk->data[arena->used];
+    arena->used += size;
+
+    return ptr;
+}
+
+// Only the latest block goes back, the others wait for a reset
+static void arena_free(allocator_t* self, void* ptr, size_t size)
+{
+    arena_t* arena = (arena_t*)self;
+
+    size = ARENA_ROUND(size);
+
+    if (arena->chunk != NULL && arena->used >= size && (char*)ptr == &arena->chunk->data[arena->used - size]) {
+        arena->used -= size;
+    }
+}
+
+arena_t* arena_new(size_t chunk_size)
+{
+    arena_t* arena = malloc(sizeof(*arena));
+    CHECK_NOT_NULL(arena);
+
+    arena->base       = (allocator_t){ .alloc = arena_alloc, .free = arena_free };
+    arena->head       = NULL;
+    arena->chunk      = NULL;
+    arena->used       = 0;
+    arena->chunk_size = chunk_size;
+
+    return arena;
+}
+
+// Releases every chunk, the arena can still be used afterwards
+void arena_clear(arena_t* arena)
+{
+    CHECK_NOT_NULL(arena);
+
+    while (arena->head != NULL) {
+        arena_chunk_t* next = arena->head->next;
+        free(arena->head);
+        arena->head = next;
+    }
+
+    arena->chunk = NULL;
+    arena->used  = 0;
+}
+
+// Takes back every block at once. The objects allocated from the arena must
+// not be used afterwards, nor deleted: promoted scalars among them should be
+// cleared before.
+void arena_reset(arena_t* arena)
+{
+    CHECK_NOT_NULL(arena);
+
+    arena->chunk = NULL;
+    arena->used  = 0;
+}
+
+arena_mark_t arena_mark(arena_t* arena)
+{
+    CHECK_NOT_NULL(arena);
+
+    return (arena_mark_t){ .chunk = arena->chunk, .used = arena->used };
+}
+
+// Takes back every block allocated since mark was taken
+void arena_rewind(arena_t* arena, arena_mark_t mark)
+{
+    CHECK_NOT_NULL(arena);
+
+    arena->chunk = mark.chunk;
+    arena->used  = mark.used;
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+// Size classes are indexed by 16-byte steps. A free block holds the next
+// one of its list.
+static void* slab_alloc(allocator_t* self, size_t size)
+{
+    slab_t* slab = (slab_t*)self;
+
+    if (size > SLAB_MAX) {
+        return malloc(size);
+    }
+
+    size_t k     = (ARENA_ROUND(size) >> 4) - 1;
+    void*  block = slab->free[k];
+
+    if (block != NULL) {
+        slab->free[k] = *(void**)block;
+        return block;
+    }
+
+    return arena_alloc(&slab->arena.base, size);
+}
+
+static void slab_free(allocator_t* self, void* ptr, size_t size)
+{
+    slab_t* slab = (slab_t*)self;
+
+    if (size > SLAB_MAX) {
+        free(ptr);
+        return;
+    }
+
+    size_t k = (ARENA_ROUND(size) >> 4) - 1;
+
+    *(void**)ptr  = slab->free[k];
+    slab->free[k] = ptr;
+}
+
+slab_t* slab_new(void)
+{
+    slab_t* slab = malloc(sizeof(*slab));
+    CHECK_NOT_NULL(slab);
+
+    slab->base = (allocator_t){ .alloc = slab_alloc, .free = slab_free };
+    memset(slab->free, 0, sizeof(slab->free));
+
+    // Chunks of 64 KiB, 2048 scalars with their headers
+    slab->arena = (arena_t){ .base = { .alloc = arena_alloc, .free = arena_free }, .chunk_size = 64 * 1024 };
+
+    return slab;
+}
+
+// Drops every block of the size classes at once, under the same terms as
+// arena_reset. Larger blocks are on the heap and must have been deleted.
+void slab_reset(slab_t* slab)
+{
+    CHECK_NOT_NULL(slab);
+
+    memset(slab->free, 0, sizeof(slab->free));
+    arena_reset(&slab->arena);
+}
@@ -0,0 +1,98 @@
+#ifndef TD_ALLOC_H
+#define TD_ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+// Where scalar_new, scalar_duplicate and the *_get helpers, vector_new and
+// matrix_new take their memory from. Each thread has a current allocator,
+// the heap unless one was installed with alloc_use, and every block records
+// the allocator it came from: the delete macros give it back to the right
+// one whatever is current by then.
+//
+// Only those blocks go through the allocator. The limbs of promoted scalars
+// stay on the heap, they are released by scalar_clear and the delete macros
+// as usual. An allocator serves one thread at a time.
+typedef struct allocator allocator_t;
+
+struct allocator {
+    // Returns a block of size bytes aligned on 16 bytes
+    void* (*alloc)(allocator_t* self, size_t size);
+
+    // Takes back a block of this allocator, of the size it was asked for
+    void (*free)(allocator_t* self, void* ptr, size_t size);
+};
+
+allocator_t* alloc_use(allocator_t* allocator);
+void*        alloc_new(size_t size);
+void         alloc_free(void* ptr);
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+typedef struct arena_chunk arena_chunk_t;
+
+// A bump allocator over a list of chunks. Blocks are only taken back all at
+// once, by arena_reset or down to a mark by arena_rewind, both in constant
+// time; the chunks are kept for the next allocations. Freeing the latest
+// block alone also takes it back, which suits scoped temporaries.
+typedef struct arena {
+    allocator_t base;
+
+    arena_chunk_t* head;
+    arena_chunk_t* chunk;
+
+    // Bytes taken from the current chunk
+    size_t used;
+
+    // The size of new chunks, larger blocks get a chunk of their own
+    size_t chunk_size;
+} arena_t;
+
+// A position of an arena, to rewind it to
+typedef struct arena_mark {
+    arena_chunk_t* chunk;
+    size_t         used;
+} arena_mark_t;
+
+#define arena_delete(arena)   \
+    if ((arena) != NULL) {    \
+        arena_clear(arena);   \
+        free(arena);          \
+        (arena) = NULL;       \
+    }
+
+arena_t*     arena_new(size_t chunk_size);
+void         arena_clear(arena_t* arena);
+void         arena_reset(arena_t* arena);
+arena_mark_t arena_mark(arena_t* arena);
+void         arena_rewind(arena_t* arena, arena_mark_t mark);
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+// Size classes of 16 bytes up to this
+#define SLAB_MAX 256
+
+// Free lists of blocks of the same size class, carved out of an arena, for
+// objects that come and go one by one: scalars, small vectors. Larger
+// blocks are left to the heap. slab_reset drops every block in constant
+// time.
+typedef struct slab {
+    allocator_t base;
+
+    void*   free[SLAB_MAX / 16];
+    arena_t arena;
+} slab_t;
+
+#define slab_delete(slab)            \
+    if ((slab) != NULL) {            \
+        arena_clear(&(slab)->arena); \
+        free(slab);                  \
+        (slab) = NULL;               \
+    }
+
+slab_t* slab_new(void);
+void    slab_reset(slab_t* slab);
+
+#endif /* alloc.h */
@@ -0,0 +1,88 @@
+#include "../matrix.h"
+#include "../vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define N      256
+#define ROUNDS 20
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// An element-wise loop: the sum of a[i][j] . a[j][i] / 2 over the matrix,
+// once through the allocating getters and helpers, once by value
+static double run(matrix_t* a, bool value, scalar_t* sum)
+{
+    scalar_t* half = scalar_new(1, 2, false);
+    double    t0   = seconds();
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        scalar_clear(sum);
+
+        for (size_t i = 0; i < N; i++) {
+            for (size_t j = 0; j < N; j++) {
+                if (value) {
+                    scalar_t p = scalar_mul_val(matrix_ptr(a, i, j), matrix_ptr(a, j, i));
+                    scalar_t q = scalar_mul_val(&p, half);
+
+                    scalar_add(sum, sum, &q);
+                    scalar_clear(&q);
+                    scalar_clear(&p);
+                } else {
+                    scalar_t* x = matrix_get(a, i, j);
+                    scalar_t* y = matrix_get(a, j, i);
+                    scalar_t* p = scalar_mul_get(x, y);
+                    scalar_t* q = scalar_mul_get(p, half);
+
+                    scalar_add(sum, sum, q);
+                    scalar_delete(q);
+                    scalar_delete(p);
+                    scalar_delete(y);
+                    scalar_delete(x);
+                }
+            }
+        }
+    }
+
+    double t1 = seconds();
+
+    scalar_delete(half);
+    return t1 - t0;
+}
+
+int main(void)
+{
+    matrix_t* a = matrix_new(N, N);
+
+    srand(1);
+    for (size_t i = 0; i < N * N; i++) {
+        scalar_t x = scalar_make(rand() % 100, 1 + rand() % 9, rand() % 2);
+
+        scalar_copy(&a->data[i], &x);
+    }
+    matrix_refresh_integer(a);
+
+    scalar_t x = zero, y = zero;
+
+    double get = run(a, false, &x);
+    double val = run(a, true, &y);
+
+    if (!scalar_equals(&x, &y)) {
+        fprintf(stderr, "results differ\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("%10s %12s %12s\n", "accessors", "time (s)", "ns / item");
+    printf("%10s %12.4f %12.1f\n", "get", get, get / ROUNDS / (N * N) * 1e9);
+    printf("%10s %12.4f %12.1f\n", "value", val, val / ROUNDS / (N * N) * 1e9);
+
+    scalar_clear(&y);
+    scalar_clear(&x);
+    matrix_delete(a);
+    return EXIT_SUCCESS;
+}
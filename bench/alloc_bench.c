@@ -0,0 +1,74 @@
+#include "../alloc.h"
+#include "../matrix.h"
+#include "../vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ROUNDS 2000000
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Temporaries made by the *_get helpers and small vectors, as expression
+// style code creates them, under the current allocator
+static double workload(arena_t* arena)
+{
+    scalar_t* a   = scalar_new(3, 7, false);
+    scalar_t* b   = scalar_new(5, 11, true);
+    double    t0  = seconds();
+    int64_t   sum = 0;
+
+    for (size_t i = 0; i < ROUNDS; i++) {
+        arena_mark_t mark = arena != NULL ? arena_mark(arena) : (arena_mark_t){ 0 };
+
+        scalar_t* x = scalar_add_get(a, b);
+        scalar_t* y = scalar_mul_get(x, a);
+        vector_t* v = vector_new(4);
+
+        sum += y->num + (int64_t)v->n;
+
+        vector_delete(v);
+        scalar_delete(y);
+        scalar_delete(x);
+
+        if (arena != NULL) {
+            arena_rewind(arena, mark);
+        }
+    }
+
+    double t1 = seconds();
+
+    scalar_delete(b);
+    scalar_delete(a);
+
+    return sum != 0 ? t1 - t0 : 0;
+}
+
+int main(void)
+{
+    printf("%10s %12s %12s\n", "allocator", "time (s)", "ns / round");
+
+    double heap = workload(NULL);
+    printf("%10s %12.4f %12.1f\n", "heap", heap, heap / ROUNDS * 1e9);
+
+    slab_t*      slab     = slab_new();
+    allocator_t* previous = alloc_use(&slab->base);
+    double       slabbed  = workload(NULL);
+    alloc_use(previous);
+    slab_delete(slab);
+    printf("%10s %12.4f %12.1f\n", "slab", slabbed, slabbed / ROUNDS * 1e9);
+
+    arena_t* arena = arena_new(64 * 1024);
+    previous       = alloc_use(&arena->base);
+    double arenaed = workload(arena);
+    alloc_use(previous);
+    arena_delete(arena);
+    printf("%10s %12.4f %12.1f\n", "arena", arenaed, arenaed / ROUNDS * 1e9);
+
+    return EXIT_SUCCESS;
+}
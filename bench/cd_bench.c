@@ -0,0 +1,69 @@
+#include "../cd.h"
+#include "../utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Fractions over divisors of 360, as scaled integer data would give
+static matrix_t* matrix_random(size_t n)
+{
+    static const uint64_t dens[] = { 1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 360 };
+
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_new(rand() % 1000, dens[rand() % 11], rand() % 2);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    return matrix;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    srand(42);
+
+    printf("%6s %12s %12s %12s %9s\n", "n", "convert (s)", "prod (s)", "cd prod (s)", "speedup");
+
+    for (size_t n = 16; n <= 512; n *= 2) {
+        matrix_t* a = matrix_random(n);
+        matrix_t* b = matrix_random(n);
+
+        double       t0 = seconds();
+        matrix_cd_t* x  = matrix_cd_from(a);
+        matrix_cd_t* y  = matrix_cd_from(b);
+        double       t1 = seconds();
+        matrix_t*    c  = matrix_prod(a, b);
+        double       t2 = seconds();
+        matrix_cd_t* z  = matrix_cd_prod(x, y);
+        double       t3 = seconds();
+
+        matrix_t* d = matrix_cd_to_matrix(z);
+        for (size_t i = 0; i < n * n; i++) {
+            if (!scalar_equals(&c->data[i], &d->data[i])) {
+                ERROR("results differ at (%zu, %zu)", i / n, i % n);
+            }
+        }
+
+        printf("%6zu %12.4f %12.4f %12.4f %8.1fx\n", n, t1 - t0, t2 - t1, t3 - t2, (t2 - t1) / (t3 - t2));
+        fflush(stdout);
+
+        matrix_delete(d);
+        matrix_cd_delete(z);
+        matrix_delete(c);
+        matrix_cd_delete(y);
+        matrix_cd_delete(x);
+        matrix_delete(b);
+        matrix_delete(a);
+    }
+
+    return EXIT_SUCCESS;
+}
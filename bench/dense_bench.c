@@ -0,0 +1,84 @@
+#include "../dense.h"
+#include "../utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static matrix_d_t* matrix_d_random(size_t n)
+{
+    matrix_d_t* matrix = matrix_d_new(n, n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        matrix->data[i] = rand() / (double)RAND_MAX - 0.5;
+    }
+
+    return matrix;
+}
+
+static matrix_f_t* matrix_f_random(size_t n)
+{
+    matrix_f_t* matrix = matrix_f_new(n, n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        matrix->data[i] = rand() / (float)RAND_MAX - 0.5f;
+    }
+
+    return matrix;
+}
+
+int main(void)
+{
+    static const char* names[] = { "scalar", "avx2", "avx512" };
+
+    srand(42);
+
+    printf("%6s %8s %14s %14s %14s\n", "n", "isa", "d prod GF/s", "f prod GF/s", "d lu GF/s");
+
+    for (size_t n = 128; n <= 1024; n *= 2) {
+        matrix_d_t* a = matrix_d_random(n);
+        matrix_d_t* b = matrix_d_random(n);
+        matrix_f_t* x = matrix_f_random(n);
+        matrix_f_t* y = matrix_f_random(n);
+
+        for (int isa = DENSE_ISA_SCALAR; isa <= DENSE_ISA_AVX512; isa++) {
+            if (dense_set_isa(isa) != (dense_isa_t)isa) {
+                continue;
+            }
+
+            double      t0 = seconds();
+            matrix_d_t* c  = matrix_d_prod(a, b);
+            double      t1 = seconds();
+            matrix_f_t* z  = matrix_f_prod(x, y);
+            double      t2 = seconds();
+
+            matrix_d_t *l, *u, *p;
+            matrix_d_lu(a, &l, &u, &p);
+            double t3 = seconds();
+
+            double flops = 2.0 * n * n * n;
+            printf("%6zu %8s %14.2f %14.2f %14.2f\n", n, names[isa], flops / (t1 - t0) * 1e-9,
+                   flops / (t2 - t1) * 1e-9, flops / 3 / (t3 - t2) * 1e-9);
+            fflush(stdout);
+
+            matrix_d_delete(p);
+            matrix_d_delete(u);
+            matrix_d_delete(l);
+            matrix_f_delete(z);
+            matrix_d_delete(c);
+        }
+
+        matrix_f_delete(y);
+        matrix_f_delete(x);
+        matrix_d_delete(b);
+        matrix_d_delete(a);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,87 @@
+#include "../dixon.h"
+#include "../lu.h"
+#include "../utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Integers below 1000 in magnitude
+static matrix_t* matrix_random(size_t n)
+{
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_new(rand() % 1000, 1, rand() % 2);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static vector_t* vector_random(size_t n)
+{
+    vector_t* vector = vector_new(n);
+
+    for (size_t i = 0; i < n; i++) {
+        scalar_t* x = scalar_new(rand() % 1000, 1, rand() % 2);
+        scalar_copy(&vector->items[i], x);
+        scalar_delete(x);
+    }
+
+    vector_refresh_integer(vector);
+    return vector;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    srand(42);
+
+    printf("%6s %12s %12s %9s\n", "n", "lu (s)", "dixon (s)", "speedup");
+
+    // LU only up to where it still finishes in reasonable time
+    for (size_t n = 16; n <= 512; n *= 2) {
+        matrix_t* a = matrix_random(n);
+        vector_t* b = vector_random(n);
+
+        double    t0 = seconds();
+        vector_t* y  = matrix_solve_exact(a, b);
+        double    t1 = seconds();
+
+        if (n <= 64) {
+            double    t2 = seconds();
+            lu_t*     lu = lu_new(a);
+            vector_t* x  = lu_solve(lu, b);
+            double    t3 = seconds();
+
+            for (size_t i = 0; i < n; i++) {
+                if (!scalar_equals(&x->items[i], &y->items[i])) {
+                    ERROR("solutions differ at %zu", i);
+                }
+            }
+
+            printf("%6zu %12.4f %12.4f %8.1fx\n", n, t3 - t2, t1 - t0, (t3 - t2) / (t1 - t0));
+
+            vector_delete(x);
+            lu_delete(lu);
+        } else {
+            printf("%6zu %12s %12.4f\n", n, "-", t1 - t0);
+        }
+
+        fflush(stdout);
+
+        vector_delete(y);
+        vector_delete(b);
+        matrix_delete(a);
+    }
+
+    return EXIT_SUCCESS;
+}
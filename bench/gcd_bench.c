@@ -0,0 +1,129 @@
+#include "../gcd.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define SAMPLES (1 << 20)
+#define ROUNDS 20
+
+typedef struct pair {
+    uint64_t a, b;
+} pair_t;
+
+static uint64_t rand64(void)
+{
+    return ((uint64_t)rand() << 42) ^ ((uint64_t)rand() << 21) ^ (uint64_t)rand();
+}
+
+// A product of a few random small primes, the shape denominators take once a
+// computation has gone through a number of sums and products
+static uint64_t smooth(size_t factors)
+{
+    static const uint64_t primes[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+
+    uint64_t x = 1;
+    for (size_t i = 0; i < factors; i++) {
+        x *= primes[rand() % (sizeof(primes) / sizeof(primes[0]))];
+    }
+
+    return x;
+}
+
+static void fill_small(pair_t* pairs)
+{
+    for (size_t i = 0; i < SAMPLES; i++) {
+        pairs[i] = (pair_t){ 1 + rand() % 1000, 1 + rand() % 1000 };
+    }
+}
+
+static void fill_smooth(pair_t* pairs)
+{
+    for (size_t i = 0; i < SAMPLES; i++) {
+        pairs[i] = (pair_t){ smooth(8), smooth(8) };
+    }
+}
+
+static void fill_wide(pair_t* pairs)
+{
+    for (size_t i = 0; i < SAMPLES; i++) {
+        pairs[i] = (pair_t){ rand64() | 1, rand64() | 1 };
+    }
+}
+
+static void fill_pow2(pair_t* pairs)
+{
+    for (size_t i = 0; i < SAMPLES; i++) {
+        pairs[i] = (pair_t){ rand64() >> (rand() % 48), (uint64_t)1 << (rand() % 40) };
+    }
+}
+
+static void fill_unit(pair_t* pairs)
+{
+    for (size_t i = 0; i < SAMPLES; i++) {
+        pairs[i] = (pair_t){ rand64() >> (rand() % 48), 1 };
+    }
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double bench(uint64_t (*gcd)(uint64_t, uint64_t), pair_t* pairs, uint64_t* checksum)
+{
+    uint64_t sum = 0;
+    double   t0  = seconds();
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        for (size_t i = 0; i < SAMPLES; i++) {
+            sum += gcd(pairs[i].a, pairs[i].b);
+        }
+    }
+
+    *checksum = sum;
+    return (seconds() - t0) * 1e9 / ((double)SAMPLES * ROUNDS);
+}
+
+int main(void)
+{
+    struct {
+        const char* name;
+        void (*fill)(pair_t*);
+    } sets[] = {
+        { "small (< 1000)", fill_small },
+        { "smooth", fill_smooth },
+        { "wide 64-bit", fill_wide },
+        { "power of two", fill_pow2 },
+        { "one operand 1", fill_unit },
+    };
+
+    pair_t* pairs = malloc(SAMPLES * sizeof(pair_t));
+    if (pairs == NULL) {
+        return EXIT_FAILURE;
+    }
+
+    srand(42);
+
+    printf("%-16s %14s %14s %9s\n", "operands", "euclid (ns)", "binary (ns)", "speedup");
+
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        uint64_t c1, c2;
+
+        sets[s].fill(pairs);
+
+        double euclid = bench(uint64_gcd_euclid, pairs, &c1);
+        double binary = bench(uint64_gcd_binary, pairs, &c2);
+
+        if (c1 != c2) {
+            fprintf(stderr, "checksums differ on %s\n", sets[s].name);
+            return EXIT_FAILURE;
+        }
+
+        printf("%-16s %14.2f %14.2f %8.2fx\n", sets[s].name, euclid, binary, euclid / binary);
+    }
+
+    free(pairs);
+    return EXIT_SUCCESS;
+}
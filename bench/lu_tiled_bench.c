@@ -0,0 +1,89 @@
+#include "../lu.h"
+#include "../pool.h"
+#include "../utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Small integers, the factors are fractions of growing size
+static matrix_t* matrix_random(size_t n)
+{
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        matrix->data[i] = scalar_of(rand() % 21 - 10);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Factorizes a copy of a, tiled or not, and returns the time taken
+static double factorize(matrix_t* a, matrix_t* x, size_t* perm, bool tiled)
+{
+    for (size_t i = 0; i < a->m * a->n; i++) {
+        scalar_copy(&x->data[i], &a->data[i]);
+    }
+
+    bool   odd;
+    double t0 = seconds();
+
+    if (tiled) {
+        lu_factorize_tiled(x, perm, &odd);
+    } else {
+        lu_factorize(x, perm, &odd);
+    }
+
+    return seconds() - t0;
+}
+
+int main(void)
+{
+    size_t sizes[]   = { 32, 48, 64 };
+    size_t threads[] = { 1, 2, 4, 8 };
+
+    srand(42);
+
+    printf("%6s %8s %12s %12s %9s\n", "n", "threads", "crout (s)", "tiled (s)", "speedup");
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t    n    = sizes[s];
+        matrix_t* a    = matrix_random(n);
+        matrix_t* x    = matrix_square(n);
+        matrix_t* y    = matrix_square(n);
+        size_t*   perm = malloc(n * sizeof(size_t));
+        CHECK_NOT_NULL(perm);
+
+        double crout = factorize(a, x, perm, false);
+
+        for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+            pool_set_threads(threads[k]);
+            lu_set_tile(n / 4);
+
+            double tiled = factorize(a, y, perm, true);
+
+            for (size_t i = 0; i < n * n; i++) {
+                if (!scalar_equals(&x->data[i], &y->data[i])) {
+                    ERROR("factors differ for n=%zu", n);
+                }
+            }
+
+            printf("%6zu %8zu %12.4f %12.4f %9.2f\n", n, threads[k], crout, tiled, crout / tiled);
+        }
+
+        free(perm);
+        matrix_delete(y);
+        matrix_delete(x);
+        matrix_delete(a);
+    }
+
+    pool_shutdown();
+    return EXIT_SUCCESS;
+}
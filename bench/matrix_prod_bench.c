@@ -0,0 +1,83 @@
+#include "../matrix.h"
+#include "../utils.h"
+#include "../vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Reference product: one row and one column copy plus a heap-allocated dot
+// product per output cell, as matrix_prod used to do it.
+static matrix_t* matrix_prod_naive(matrix_t* a, matrix_t* b)
+{
+    matrix_t* mat = matrix_new(a->m, b->n);
+
+    scalar_t* val;
+    vector_t *col, *row;
+    for (size_t i = 0; i < a->m; i++) {
+        for (size_t j = 0; j < b->n; j++) {
+            row = matrix_row(a, i);
+            col = matrix_col(b, j);
+            val = vector_dot_prod(row, col);
+            scalar_copy(&matrix_at(mat, i, j), val);
+            scalar_delete(val);
+            vector_delete(row);
+            vector_delete(col);
+        }
+    }
+
+    return mat;
+}
+
+static matrix_t* matrix_random(size_t n)
+{
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_from(rand() % 10);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    return matrix;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    srand(42);
+
+    printf("%6s %12s %12s %9s\n", "n", "naive (s)", "blocked (s)", "speedup");
+
+    for (size_t n = 16; n <= 512; n *= 2) {
+        matrix_t* a = matrix_random(n);
+        matrix_t* b = matrix_random(n);
+
+        double    t0    = seconds();
+        matrix_t* naive = matrix_prod_naive(a, b);
+        double    t1    = seconds();
+        matrix_t* fast  = matrix_prod(a, b);
+        double    t2    = seconds();
+
+        for (size_t i = 0; i < n * n; i++) {
+            if (!scalar_equals(&naive->data[i], &fast->data[i])) {
+                ERROR("results differ at (%zu, %zu)", i / n, i % n);
+            }
+        }
+
+        printf("%6zu %12.4f %12.4f %8.1fx\n", n, t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+        fflush(stdout);
+
+        matrix_delete(fast);
+        matrix_delete(naive);
+        matrix_delete(b);
+        matrix_delete(a);
+    }
+
+    return EXIT_SUCCESS;
+}
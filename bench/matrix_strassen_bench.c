@@ -0,0 +1,83 @@
+#include "../matrix.h"
+#include "../pool.h"
+#include "../utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Entries p/q with small p and q in {1, 2, 3}: every scalar_mul has to
+// normalize, while denominators of the sums stay bounded by 36
+static matrix_t* matrix_random(size_t n)
+{
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_new(rand() % 10, 1 + rand() % 3, rand() % 2);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    return matrix;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    size_t cutoffs[] = { 16, 32, 64, 128 };
+    size_t ncutoffs  = sizeof(cutoffs) / sizeof(cutoffs[0]);
+
+    srand(42);
+    pool_set_threads(1);
+
+    printf("%6s %12s", "n", "classic (s)");
+    for (size_t c = 0; c < ncutoffs; c++) {
+        printf("   cutoff %-4zu", cutoffs[c]);
+    }
+    printf("\n");
+
+    for (size_t n = 64; n <= 512; n *= 2) {
+        matrix_t* a = matrix_random(n);
+        matrix_t* b = matrix_random(n);
+
+        matrix_set_strassen_cutoff(0);
+
+        double    t0      = seconds();
+        matrix_t* classic = matrix_prod(a, b);
+        double    t1      = seconds();
+
+        double elapsed = t1 - t0;
+        printf("%6zu %12.4f", n, elapsed);
+
+        for (size_t c = 0; c < ncutoffs; c++) {
+            matrix_set_strassen_cutoff(cutoffs[c]);
+
+            t0            = seconds();
+            matrix_t* mat = matrix_prod(a, b);
+            t1            = seconds();
+
+            for (size_t i = 0; i < n * n; i++) {
+                if (!scalar_equals(&classic->data[i], &mat->data[i])) {
+                    ERROR("results differ at (%zu, %zu)", i / n, i % n);
+                }
+            }
+
+            printf(" %8.4f %4.2fx", t1 - t0, elapsed / (t1 - t0));
+            matrix_delete(mat);
+        }
+
+        printf("\n");
+        fflush(stdout);
+
+        matrix_delete(classic);
+        matrix_delete(b);
+        matrix_delete(a);
+    }
+
+    return EXIT_SUCCESS;
+}
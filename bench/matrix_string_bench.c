@@ -0,0 +1,92 @@
+#include "../matrix.h"
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define N      300
+#define ROUNDS 10
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The text of every entry through snprintf, as matrix_string used to do it,
+// without the padding
+static size_t sprintf_entries(const matrix_t* a, char* dst)
+{
+    char* ofs = dst;
+
+    for (size_t i = 0; i < a->m; i++) {
+        for (size_t j = 0; j < a->n; j++) {
+            const scalar_t* x = &matrix_at(a, i, j);
+
+            if (x->den == 1) {
+                ofs += sprintf(ofs, "%" PRId64 " ", x->num);
+            } else {
+                ofs += sprintf(ofs, "%" PRId64 "/%" PRIu64 " ", x->num, x->den);
+            }
+        }
+    }
+
+    return ofs - dst;
+}
+
+static bool discard(void* ctx, const char* chunk, size_t len)
+{
+    (void)chunk;
+
+    *(size_t*)ctx += len;
+    return true;
+}
+
+int main(void)
+{
+    matrix_t* a = matrix_new(N, N);
+
+    srand(1);
+    for (size_t i = 0; i < N * N; i++) {
+        a->data[i] = scalar_make(rand() % 1000000, 1 + rand() % 1000, rand() % 2);
+    }
+    matrix_refresh_integer(a);
+
+    size_t widths[N];
+    size_t len    = matrix_string_length(a);
+    char*  ref    = malloc(len);
+    size_t total  = 0;
+    double t0     = seconds();
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        total += sprintf_entries(a, ref);
+    }
+
+    double t1 = seconds();
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        char* str = matrix_string(a);
+        total += strlen(str);
+        free(str);
+    }
+
+    double t2 = seconds();
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        matrix_stream(a, widths, discard, &total);
+    }
+
+    double t3 = seconds();
+
+    printf("%8s %12s %12s\n", "format", "time (s)", "MB / s");
+    printf("%8s %12.4f %12.1f\n", "sprintf", t1 - t0, ROUNDS * len / (t1 - t0) / 1e6);
+    printf("%8s %12.4f %12.1f\n", "string", t2 - t1, ROUNDS * len / (t2 - t1) / 1e6);
+    printf("%8s %12.4f %12.1f\n", "stream", t3 - t2, ROUNDS * len / (t3 - t2) / 1e6);
+    printf("(%zu bytes)\n", total);
+
+    free(ref);
+    matrix_delete(a);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,73 @@
+#include "../matrix.h"
+#include "../utils.h"
+#include "../vector.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Fractions over small denominators
+static matrix_t* matrix_random(size_t n)
+{
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_new(rand() % 1000, 1 + rand() % 12, rand() % 2);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Every row of A against every column of A, the access pattern of a naive
+// product or of a row reduction reading its pivot column
+int main(void)
+{
+    srand(42);
+
+    printf("%6s %12s %12s %9s\n", "n", "copies (s)", "views (s)", "speedup");
+
+    for (size_t n = 16; n <= 128; n *= 2) {
+        matrix_t* a = matrix_random(n);
+
+        double t0 = seconds();
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                vector_t* r = matrix_row(a, i);
+                vector_t* c = matrix_col(a, j);
+                scalar_t* x = vector_dot_prod(r, c);
+
+                scalar_delete(x);
+                vector_delete(c);
+                vector_delete(r);
+            }
+        }
+
+        double t1 = seconds();
+        for (size_t i = 0; i < n; i++) {
+            for (size_t j = 0; j < n; j++) {
+                vector_t  r = matrix_row_view(a, i);
+                vector_t  c = matrix_col_view(a, j);
+                scalar_t* x = vector_dot_prod(&r, &c);
+
+                scalar_delete(x);
+            }
+        }
+        double t2 = seconds();
+
+        printf("%6zu %12.4f %12.4f %8.1fx\n", n, t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+        fflush(stdout);
+
+        matrix_delete(a);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+#include "../lu.h"
+#include "../modp.h"
+#include "../utils.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Fractions over divisors of 360, whose minors soon outgrow 128 bits
+static matrix_t* matrix_random(size_t n)
+{
+    static const uint64_t dens[] = { 1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 360 };
+
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_new(rand() % 1000, dens[rand() % 11], rand() % 2);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+    srand(42);
+
+    printf("%6s %12s %12s %9s\n", "n", "lu det (s)", "modp det (s)", "speedup");
+
+    for (size_t n = 8; n <= 64; n *= 2) {
+        matrix_t* a = matrix_random(n);
+
+        double    t0 = seconds();
+        lu_t*     lu = lu_new(a);
+        scalar_t* x  = lu_det(lu);
+        double    t1 = seconds();
+        scalar_t  y  = zero;
+        matrix_modp_det(a, &y);
+        double t2 = seconds();
+
+        if (!scalar_equals(x, &y)) {
+            ERROR("determinants differ for n=%zu", n);
+        }
+
+        printf("%6zu %12.4f %12.4f %8.1fx\n", n, t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+        fflush(stdout);
+
+        scalar_clear(&y);
+        scalar_delete(x);
+        lu_delete(lu);
+        matrix_delete(a);
+    }
+
+    return EXIT_SUCCESS;
+}
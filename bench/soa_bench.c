@@ -0,0 +1,117 @@
+#include "../soa.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Small enough for the operands to stay in cache
+#define SIZE (1 << 14)
+#define ROUNDS 1000
+
+static double seconds(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Small values over denominator den, or over random ones when den is 0.
+// The buffer is filled directly, scalars would reduce the shared denominator.
+static soa_t* soa_random(uint64_t den)
+{
+    soa_t* soa = soa_new(SIZE);
+
+    for (size_t i = 0; i < SIZE; i++) {
+        soa->num[i] = rand() % 2001 - 1000;
+        soa->den[i] = den != 0 ? den : 1 + (uint64_t)(rand() % 1000);
+    }
+
+    return soa;
+}
+
+// Nanoseconds per element of alternating additions and subtractions, which
+// keeps the values bounded
+static double bench_aos(vector_t* u, vector_t* v)
+{
+    double t0 = seconds();
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        if (r % 2 == 0) {
+            vector_add(u, v);
+        } else {
+            vector_sub(u, v);
+        }
+    }
+
+    return (seconds() - t0) * 1e9 / ((double)ROUNDS * SIZE);
+}
+
+static double bench_soa(soa_t* u, soa_t* v)
+{
+    double t0 = seconds();
+
+    for (size_t r = 0; r < ROUNDS; r++) {
+        if (r % 2 == 0) {
+            soa_add(u, u, v);
+        } else {
+            soa_sub(u, u, v);
+        }
+    }
+
+    return (seconds() - t0) * 1e9 / ((double)ROUNDS * SIZE);
+}
+
+int main(void)
+{
+    static const struct {
+        const char* name;
+        uint64_t    den;
+    } sets[] = {
+        { "integers", 1 },
+        { "shared (1/360)", 360 },
+        { "mixed", 0 },
+    };
+
+    srand(42);
+
+    printf("%-16s %12s %12s %12s %12s\n", "ns / element", "aos", "soa scalar", "soa avx2", "soa avx512");
+
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        soa_t* x = soa_random(sets[s].den);
+        soa_t* y = soa_random(sets[s].den);
+
+        vector_t* u = soa_to_vector(x);
+        vector_t* v = soa_to_vector(y);
+
+        printf("%-16s %12.2f", sets[s].name, bench_aos(u, v));
+
+        for (soa_isa_t isa = SOA_ISA_SCALAR; isa <= SOA_ISA_AVX512; isa++) {
+            if (soa_set_isa(isa) != isa) {
+                printf(" %12s", "-");
+                continue;
+            }
+
+            soa_t* a = soa_new(SIZE);
+            soa_t* b = soa_new(SIZE);
+            memcpy(a->num, x->num, SIZE * sizeof(int64_t));
+            memcpy(a->den, x->den, SIZE * sizeof(uint64_t));
+            memcpy(b->num, y->num, SIZE * sizeof(int64_t));
+            memcpy(b->den, y->den, SIZE * sizeof(uint64_t));
+
+            printf(" %12.2f", bench_soa(a, b));
+
+            soa_delete(b);
+            soa_delete(a);
+        }
+
+        printf("\n");
+        fflush(stdout);
+
+        vector_delete(v);
+        vector_delete(u);
+        soa_delete(y);
+        soa_delete(x);
+    }
+
+    return EXIT_SUCCESS;
+}
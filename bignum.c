@@ -0,0 +1,450 @@
+#include "bignum.h"
+#include "decimal.h"
+#include "gcd.h"
+#include "utils.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Largest power of ten that fits in a limb, used for decimal conversion
+#define BIGNUM_DEC_BASE 10000000000000000000ULL
+#define BIGNUM_DEC_DIGITS 19
+
+static void bignum_reserve(bignum_t* x, size_t n)
+{
+    if (n <= x->capacity) {
+        return;
+    }
+
+    x->limbs = realloc(x->limbs, n * sizeof(uint64_t));
+    CHECK_NOT_NULL(x->limbs);
+    x->capacity = n;
+}
+
+static void bignum_trim(bignum_t* x)
+{
+    while (x->size > 0 && x->limbs[x->size - 1] == 0) {
+        x->size--;
+    }
+}
+
+// Moves the result t into r, releasing what r held. Arithmetic builds its
+// result in a fresh t, which makes r free to alias an operand.
+static void bignum_move(bignum_t* r, bignum_t* t)
+{
+    bignum_trim(t);
+    bignum_clear(r);
+    *r = *t;
+}
+
+void bignum_clear(bignum_t* x)
+{
+    free(x->limbs);
+    *x = BIGNUM_INIT;
+}
+
+void bignum_set_u64(bignum_t* x, uint64_t v)
+{
+    bignum_reserve(x, 1);
+    x->limbs[0] = v;
+    x->size     = v != 0;
+}
+
+void bignum_set_u128(bignum_t* x, uint128_t v)
+{
+    bignum_reserve(x, 2);
+    x->limbs[0] = (uint64_t)v;
+    x->limbs[1] = (uint64_t)(v >> 64);
+    x->size     = 2;
+    bignum_trim(x);
+}
+
+void bignum_copy(bignum_t* dst, const bignum_t* src)
+{
+    if (dst == src) {
+        return;
+    }
+
+    bignum_reserve(dst, src->size);
+    if (src->size > 0) {
+        memcpy(dst->limbs, src->limbs, src->size * sizeof(uint64_t));
+    }
+    dst->size = src->size;
+}
+
+void bignum_swap(bignum_t* x, bignum_t* y)
+{
+    bignum_t tmp = *x;
+    *x           = *y;
+    *y           = tmp;
+}
+
+bool bignum_is_zero(const bignum_t* x)
+{
+    return x->size == 0;
+}
+
+bool bignum_fits_u64(const bignum_t* x)
+{
+    return x->size <= 1;
+}
+
+uint64_t bignum_to_u64(const bignum_t* x)
+{
+    return x->size == 0 ? 0 : x->limbs[0];
+}
+
+size_t bignum_bits(const bignum_t* x)
+{
+    if (x->size == 0) {
+        return 0;
+    }
+
+    return 64 * x->size - __builtin_clzll(x->limbs[x->size - 1]);
+}
+
+int bignum_cmp(const bignum_t* x, const bignum_t* y)
+{
+    if (x->size != y->size) {
+        return x->size > y->size ? 1 : -1;
+    }
+
+    for (size_t i = x->size; i-- > 0;) {
+        if (x->limbs[i] != y->limbs[i]) {
+            return x->limbs[i] > y->limbs[i] ? 1 : -1;
+        }
+    }
+
+    return 0;
+}
+
+void bignum_add(bignum_t* r, const bignum_t* x, const bignum_t* y)
+{
+    if (x->size < y->size) {
+        const bignum_t* tmp = x;
+        x                   = y;
+        y                   = tmp;
+    }
+
+    bignum_t t = BIGNUM_INIT;
+    bignum_reserve(&t, x->size + 1);
+
+    uint64_t carry = 0;
+    for (size_t i = 0; i < x->size; i++) {
+        uint128_t s = (uint128_t)x->limbs[i] + (i < y->size ? y->limbs[i] : 0) + carry;
+        t.limbs[i]  = (uint64_t)s;
+        carry       = (uint64_t)(s >> 64);
+    }
+
+    t.limbs[x->size] = carry;
+    t.size           = x->size + 1;
+
+    bignum_move(r, &t);
+}
+
+void bignum_sub(bignum_t* r, const bignum_t* x, const bignum_t* y)
+{
+    if (bignum_cmp(x, y) < 0) {
+        ERROR_MESSAGE("negative difference of natural numbers");
+    }
+
+    bignum_t t = BIGNUM_INIT;
+    bignum_reserve(&t, x->size);
+
+    uint64_t borrow = 0;
+    for (size_t i = 0; i < x->size; i++) {
+        uint64_t yi = i < y->size ? y->limbs[i] : 0;
+        uint64_t d  = x->limbs[i] - yi - borrow;
+
+        borrow     = x->limbs[i] < yi || (x->limbs[i] == yi && borrow);
+        t.limbs[i] = d;
+    }
+
+    t.size = x->size;
+    bignum_move(r, &t);
+}
+
+void bignum_mul(bignum_t* r, const bignum_t* x, const bignum_t* y)
+{
+    bignum_t t = BIGNUM_INIT;
+
+    if (x->size == 0 || y->size == 0) {
+        bignum_move(r, &t);
+        return;
+    }
+
+    bignum_reserve(&t, x->size + y->size);
+    memset(t.limbs, 0, (x->size + y->size) * sizeof(uint64_t));
+
+    for (size_t i = 0; i < x->size; i++) {
+        uint64_t carry = 0;
+
+        for (size_t j = 0; j < y->size; j++) {
+            uint128_t p    = (uint128_t)x->limbs[i] * y->limbs[j] + t.limbs[i + j] + carry;
+            t.limbs[i + j] = (uint64_t)p;
+            carry          = (uint64_t)(p >> 64);
+        }
+
+        t.limbs[i + y->size] = carry;
+    }
+
+    t.size = x->size + y->size;
+    bignum_move(r, &t);
+}
+
+void bignum_mul_u64(bignum_t* r, const bignum_t* x, uint64_t y)
+{
+    bignum_t t = BIGNUM_INIT;
+    bignum_reserve(&t, x->size + 1);
+
+    uint64_t carry = 0;
+    for (size_t i = 0; i < x->size; i++) {
+        uint128_t p = (uint128_t)x->limbs[i] * y + carry;
+        t.limbs[i]  = (uint64_t)p;
+        carry       = (uint64_t)(p >> 64);
+    }
+
+    t.limbs[x->size] = carry;
+    t.size           = x->size + 1;
+
+    bignum_move(r, &t);
+}
+
+void bignum_add_u64(bignum_t* r, const bignum_t* x, uint64_t y)
+{
+    bignum_t t = BIGNUM_INIT;
+    bignum_reserve(&t, x->size + 1);
+
+    uint64_t carry = y;
+    for (size_t i = 0; i < x->size; i++) {
+        uint128_t s = (uint128_t)x->limbs[i] + carry;
+        t.limbs[i]  = (uint64_t)s;
+        carry       = (uint64_t)(s >> 64);
+    }
+
+    t.limbs[x->size] = carry;
+    t.size           = x->size + 1;
+
+    bignum_move(r, &t);
+}
+
+// Stores x / d in q (unless q is NULL) and returns x % d
+uint64_t bignum_divmod_u64(bignum_t* q, const bignum_t* x, uint64_t d)
+{
+    if (d == 0) {
+        ERROR_MESSAGE("division by 0");
+    }
+
+    bignum_t t = BIGNUM_INIT;
+    bignum_reserve(&t, x->size);
+
+    uint64_t rem = 0;
+    for (size_t i = x->size; i-- > 0;) {
+        uint128_t cur = ((uint128_t)rem << 64) | x->limbs[i];
+        t.limbs[i]    = (uint64_t)(cur / d);
+        rem           = (uint64_t)(cur % d);
+    }
+
+    t.size = x->size;
+
+    if (q != NULL) {
+        bignum_move(q, &t);
+    } else {
+        bignum_clear(&t);
+    }
+
+    return rem;
+}
+
+// Stores x / y in q and x % y in r, either of them may be NULL. Multi-limb
+// divisors go through Knuth's algorithm D on normalized operands.
+void bignum_divmod(bignum_t* q, bignum_t* r, const bignum_t* x, const bignum_t* y)
+{
+    if (y->size == 0) {
+        ERROR_MESSAGE("division by 0");
+    }
+
+    if (bignum_cmp(x, y) < 0) {
+        if (r != NULL) {
+            bignum_copy(r, x);
+        }
+        if (q != NULL) {
+            bignum_set_u64(q, 0);
+        }
+        return;
+    }
+
+    if (y->size == 1) {
+        uint64_t rem = bignum_divmod_u64(q, x, y->limbs[0]);
+        if (r != NULL) {
+            bignum_set_u64(r, rem);
+        }
+        return;
+    }
+
+    size_t n = y->size;
+    size_t m = x->size - n;
+    int    s = __builtin_clzll(y->limbs[n - 1]);
+
+    uint64_t* vn = malloc(n * sizeof(uint64_t));
+    uint64_t* un = malloc((x->size + 1) * sizeof(uint64_t));
+    CHECK_NOT_NULL(vn);
+    CHECK_NOT_NULL(un);
+
+    // Shift both so that the top limb of the divisor has its high bit set,
+    // which bounds the error of each estimated quotient limb by 2
+    for (size_t i = n - 1; i > 0; i--) {
+        vn[i] = (y->limbs[i] << s) | (s == 0 ? 0 : y->limbs[i - 1] >> (64 - s));
+    }
+    vn[0] = y->limbs[0] << s;
+
+    un[x->size] = s == 0 ? 0 : x->limbs[x->size - 1] >> (64 - s);
+    for (size_t i = x->size - 1; i > 0; i--) {
+        un[i] = (x->limbs[i] << s) | (s == 0 ? 0 : x->limbs[i - 1] >> (64 - s));
+    }
+    un[0] = x->limbs[0] << s;
+
+    bignum_t t = BIGNUM_INIT;
+    bignum_reserve(&t, m + 1);
+    t.size = m + 1;
+
+    for (size_t j = m + 1; j-- > 0;) {
+        uint128_t num  = ((uint128_t)un[j + n] << 64) | un[j + n - 1];
+        uint128_t qhat = num / vn[n - 1];
+        uint128_t rhat = num % vn[n - 1];
+
+        while ((qhat >> 64) != 0 || qhat * vn[n - 2] > ((rhat << 64) | un[j + n - 2])) {
+            qhat--;
+            rhat += vn[n - 1];
+            if ((rhat >> 64) != 0) {
+                break;
+            }
+        }
+
+        // un[j .. j + n] -= qhat * vn
+        int128_t  k = 0;
+        int128_t  d;
+        uint128_t p;
+
+        for (size_t i = 0; i < n; i++) {
+            p         = qhat * vn[i];
+            d         = (int128_t)un[i + j] - k - (int128_t)(uint64_t)p;
+            un[i + j] = (uint64_t)d;
+            k         = (int128_t)(p >> 64) - (d >> 64);
+        }
+
+        d         = (int128_t)un[j + n] - k;
+        un[j + n] = (uint64_t)d;
+
+        // The estimate was one too large, add the divisor back
+        if (d < 0) {
+            qhat--;
+
+            uint128_t c = 0;
+            for (size_t i = 0; i < n; i++) {
+                c         = (uint128_t)un[i + j] + vn[i] + (uint64_t)c;
+                un[i + j] = (uint64_t)c;
+                c >>= 64;
+            }
+            un[j + n] += (uint64_t)c;
+        }
+
+        t.limbs[j] = (uint64_t)qhat;
+    }
+
+    if (q != NULL) {
+        bignum_move(q, &t);
+    } else {
+        bignum_clear(&t);
+    }
+
+    if (r != NULL) {
+        bignum_t rem = BIGNUM_INIT;
+        bignum_reserve(&rem, n);
+
+        for (size_t i = 0; i < n; i++) {
+            rem.limbs[i] = (un[i] >> s) | (s == 0 ? 0 : un[i + 1] << (64 - s));
+        }
+
+        rem.size = n;
+        bignum_move(r, &rem);
+    }
+
+    free(un);
+    free(vn);
+}
+
+void bignum_gcd(bignum_t* r, const bignum_t* x, const bignum_t* y)
+{
+    bignum_t a = BIGNUM_INIT;
+    bignum_t b = BIGNUM_INIT;
+    bignum_t t = BIGNUM_INIT;
+
+    bignum_copy(&a, x);
+    bignum_copy(&b, y);
+
+    // Euclid on limbs until both operands fit in a word
+    while (!bignum_is_zero(&b) && !(bignum_fits_u64(&a) && bignum_fits_u64(&b))) {
+        bignum_divmod(NULL, &t, &a, &b);
+        bignum_swap(&a, &b);
+        bignum_swap(&b, &t);
+    }
+
+    if (!bignum_is_zero(&b)) {
+        bignum_set_u64(&a, uint64_gcd(bignum_to_u64(&a), bignum_to_u64(&b)));
+    }
+
+    bignum_move(r, &a);
+    bignum_clear(&b);
+    bignum_clear(&t);
+}
+
+// Splits x into base 10^19 chunks, least significant first
+static uint64_t* bignum_decimal_chunks(const bignum_t* x, size_t* count)
+{
+    uint64_t* chunks = malloc((2 * x->size + 1) * sizeof(uint64_t));
+    CHECK_NOT_NULL(chunks);
+
+    bignum_t t = BIGNUM_INIT;
+    bignum_copy(&t, x);
+
+    *count = 0;
+    do {
+        chunks[(*count)++] = bignum_divmod_u64(&t, &t, BIGNUM_DEC_BASE);
+    } while (!bignum_is_zero(&t));
+
+    bignum_clear(&t);
+    return chunks;
+}
+
+// The number of decimal digits of x
+size_t bignum_string_length(const bignum_t* x)
+{
+    size_t    count;
+    uint64_t* chunks = bignum_decimal_chunks(x, &count);
+    size_t    len    = decimal_length(chunks[count - 1]) + (count - 1) * BIGNUM_DEC_DIGITS;
+
+    free(chunks);
+    return len;
+}
+
+// Writes the decimal digits of x followed by a '\0' to dst, and returns the
+// number of digits written
+size_t bignum_write(char* dst, const bignum_t* x)
+{
+    size_t    count;
+    uint64_t* chunks = bignum_decimal_chunks(x, &count);
+    size_t    len    = decimal_length(chunks[count - 1]);
+
+    // the leading chunk unpadded, the others on exactly 19 digits
+    decimal_write(dst, chunks[count - 1], len);
+
+    for (size_t c = count - 1; c-- > 0;) {
+        decimal_write(dst + len, chunks[c], BIGNUM_DEC_DIGITS);
+        len += BIGNUM_DEC_DIGITS;
+    }
+
+    dst[len] = '\0';
+
+    free(chunks);
+    return len;
+}
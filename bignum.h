@@ -0,0 +1,42 @@
+#ifndef TD_BIGNUM_H
+#define TD_BIGNUM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// An arbitrary precision natural number
+typedef struct bignum {
+    // The number of limbs in use, the most significant one is never zero
+    // (zero itself has no limb)
+    size_t size;
+    size_t capacity;
+
+    // Least significant limb first
+    uint64_t* limbs;
+} bignum_t;
+
+#define BIGNUM_INIT ((bignum_t){ .size = 0, .capacity = 0, .limbs = NULL })
+
+void     bignum_clear(bignum_t* x);
+void     bignum_set_u64(bignum_t* x, uint64_t v);
+void     bignum_set_u128(bignum_t* x, unsigned __int128 v);
+void     bignum_copy(bignum_t* dst, const bignum_t* src);
+void     bignum_swap(bignum_t* x, bignum_t* y);
+bool     bignum_is_zero(const bignum_t* x);
+bool     bignum_fits_u64(const bignum_t* x);
+uint64_t bignum_to_u64(const bignum_t* x);
+size_t   bignum_bits(const bignum_t* x);
+int      bignum_cmp(const bignum_t* x, const bignum_t* y);
+void     bignum_add(bignum_t* r, const bignum_t* x, const bignum_t* y);
+void     bignum_sub(bignum_t* r, const bignum_t* x, const bignum_t* y);
+void     bignum_mul(bignum_t* r, const bignum_t* x, const bignum_t* y);
+void     bignum_mul_u64(bignum_t* r, const bignum_t* x, uint64_t y);
+void     bignum_add_u64(bignum_t* r, const bignum_t* x, uint64_t y);
+uint64_t bignum_divmod_u64(bignum_t* q, const bignum_t* x, uint64_t d);
+void     bignum_divmod(bignum_t* q, bignum_t* r, const bignum_t* x, const bignum_t* y);
+void     bignum_gcd(bignum_t* r, const bignum_t* x, const bignum_t* y);
+size_t   bignum_string_length(const bignum_t* x);
+size_t   bignum_write(char* dst, const bignum_t* x);
+
+#endif /* bignum.h */
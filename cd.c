@@ -0,0 +1,531 @@
+#include "cd.h"
+#include "gcd.h"
+#include "integer.h"
+#include "pool.h"
+#include "utils.h"
+#include <stdlib.h>
+
+// The least common multiple of the denominators of the nonzero items, which
+// are stride scalars apart. Returns false if an item is promoted or the
+// multiple doesn't fit 64 bits.
+static bool cd_common_den(const scalar_t* items, size_t n, size_t stride, uint64_t* den)
+{
+    for (size_t i = 0; i < n; i++) {
+        const scalar_t* x = &items[i * stride];
+
+        if (scalar_is_big(x)) {
+            return false;
+        }
+
+        if (x->num != 0 && *den % x->den != 0) {
+            uint128_t lcm = (uint128_t)(*den / uint64_gcd(*den, x->den)) * x->den;
+
+            if (lcm > UINT64_MAX) {
+                return false;
+            }
+
+            *den = lcm;
+        }
+    }
+
+    return true;
+}
+
+// Writes the numerators of the items, stride scalars apart, over den.
+// Returns false if one of them doesn't fit.
+static bool cd_load(int64_t* num, const scalar_t* items, size_t n, size_t stride, uint64_t den)
+{
+    for (size_t i = 0; i < n; i++) {
+        const scalar_t* x = &items[i * stride];
+
+        if (x->num == 0) {
+            num[i] = 0;
+        } else if (__builtin_mul_overflow(x->num, (int64_t)(den / x->den), &num[i]) || num[i] == INT64_MIN) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// num / den in lowest terms
+static scalar_t cd_scalar(int64_t num, uint64_t den)
+{
+    if (num == 0) {
+        return zero;
+    }
+
+    uint64_t g = uint64_gcd(num < 0 ? -(uint64_t)num : (uint64_t)num, den);
+
+    return (scalar_t){ .num = num / (int64_t)g, .den = den / g };
+}
+
+// Divides the numerators and den by their common factor, returns the new
+// denominator. An all-zero buffer ends up over 1.
+static uint64_t cd_reduce(int64_t* num, size_t n, uint64_t den)
+{
+    uint64_t g = den;
+
+    for (size_t i = 0; i < n && g != 1; i++) {
+        if (num[i] != 0) {
+            g = uint64_gcd(num[i] < 0 ? -(uint64_t)num[i] : (uint64_t)num[i], g);
+        }
+    }
+
+    if (g != 1) {
+        for (size_t i = 0; i < n; i++) {
+            num[i] /= (int64_t)g;
+        }
+    }
+
+    return den / g;
+}
+
+// result = a / b, promoted if it doesn't fit once reduced
+static void cd_store(scalar_t* result, int128_t a, uint128_t b)
+{
+    bool      negative = a < 0;
+    uint128_t x        = negative ? -(uint128_t)a : (uint128_t)a;
+
+    scalar_clear(result);
+
+    if (x == 0) {
+        *result = zero;
+        return;
+    }
+
+    uint128_t g = x <= UINT64_MAX && b <= UINT64_MAX ? uint64_gcd(x, b) : uint128_gcd(x, b);
+
+    x /= g;
+    b /= g;
+
+    if (x <= INT64_MAX && b <= UINT64_MAX) {
+        result->num = negative ? -(int64_t)x : (int64_t)x;
+        result->den = b;
+        return;
+    }
+
+    bignum_t p = BIGNUM_INIT, q = BIGNUM_INIT;
+
+    bignum_set_u128(&p, x);
+    bignum_set_u128(&q, b);
+    scalar_set_bignum(result, &p, &q, negative);
+
+    bignum_clear(&p);
+    bignum_clear(&q);
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+static vector_cd_t* vector_cd_alloc(size_t n)
+{
+    vector_cd_t* vector = malloc(sizeof(*vector) + n * sizeof(int64_t));
+    CHECK_NOT_NULL(vector);
+
+    vector->n   = n;
+    vector->den = 1;
+    vector->num = (int64_t*)(vector + 1);
+
+    return vector;
+}
+
+vector_cd_t* vector_cd_new(size_t n)
+{
+    vector_cd_t* vector = vector_cd_alloc(n);
+
+    for (size_t i = 0; i < n; i++) {
+        vector->num[i] = 0;
+    }
+
+    return vector;
+}
+
+vector_cd_t* vector_cd_from(const vector_t* vector)
+{
+    CHECK_NOT_NULL(vector);
+
+    vector_cd_t* cd = vector_cd_alloc(vector->n);
+
+    if (!cd_common_den(vector->items, vector->n, vector->stride, &cd->den)
+        || !cd_load(cd->num, vector->items, vector->n, vector->stride, cd->den)) {
+        vector_cd_delete(cd);
+    }
+
+    return cd;
+}
+
+vector_t* vector_cd_to_vector(const vector_cd_t* vector)
+{
+    CHECK_NOT_NULL(vector);
+
+    vector_t* result = vector_new(vector->n);
+
+    for (size_t i = 0; i < vector->n; i++) {
+        result->items[i] = cd_scalar(vector->num[i], vector->den);
+    }
+
+    vector_refresh_integer(result);
+
+    return result;
+}
+
+void vector_cd_normalize(vector_cd_t* vector)
+{
+    CHECK_NOT_NULL(vector);
+
+    vector->den = cd_reduce(vector->num, vector->n, vector->den);
+}
+
+// u = u + v or u = u - v. With equal denominators the numerators are added
+// with wrapping arithmetic and overflow is tested once at the end, which
+// keeps the loop branch-free; the sums are undone if it was hit. Otherwise
+// both sides are brought to the lcm of the denominators, after checking
+// that every result fits.
+static scalar_status_t vector_cd_add_sub(vector_cd_t* u, const vector_cd_t* v, bool sub)
+{
+    CHECK_NOT_NULL(u);
+    CHECK_NOT_NULL(v);
+
+    if (u->n != v->n) {
+        ERROR("vector dimension mismatch (u=%zu, v=%zu)", u->n, v->n);
+    }
+
+    if (u->den == v->den) {
+        return integer_num_add(u->num, v->num, u->n, 1, sub) ? SCALAR_OK : SCALAR_OVERFLOW;
+    }
+
+    uint64_t  g   = uint64_gcd(u->den, v->den);
+    uint128_t lcm = (uint128_t)(u->den / g) * v->den;
+
+    if (lcm > UINT64_MAX) {
+        return SCALAR_OVERFLOW;
+    }
+
+    uint64_t x = v->den / g;
+    uint64_t y = u->den / g;
+
+    for (size_t i = 0; i < u->n; i++) {
+        int128_t s = (int128_t)u->num[i] * x;
+        int128_t t = (int128_t)v->num[i] * y;
+
+        if (__builtin_add_overflow(s, sub ? -t : t, &s) || s > INT64_MAX || s < -INT64_MAX) {
+            return SCALAR_OVERFLOW;
+        }
+    }
+
+    for (size_t i = 0; i < u->n; i++) {
+        int128_t t = (int128_t)v->num[i] * y;
+        u->num[i]  = (int128_t)u->num[i] * x + (sub ? -t : t);
+    }
+
+    u->den = lcm;
+    return SCALAR_OK;
+}
+
+scalar_status_t vector_cd_add(vector_cd_t* u, const vector_cd_t* v)
+{
+    return vector_cd_add_sub(u, v, false);
+}
+
+scalar_status_t vector_cd_sub(vector_cd_t* u, const vector_cd_t* v)
+{
+    return vector_cd_add_sub(u, v, true);
+}
+
+// The sum of the products is exact in 64 bits when the bit lengths of the
+// largest entries and of n add up to at most 63, otherwise it runs in 128
+// bits and spills into a rational whenever that would overflow.
+scalar_t* vector_cd_dot_prod(const vector_cd_t* u, const vector_cd_t* v)
+{
+    CHECK_NOT_NULL(u);
+    CHECK_NOT_NULL(v);
+
+    if (u->n != v->n) {
+        ERROR("vector dimension mismatch (u=%zu, v=%zu)", u->n, v->n);
+    }
+
+    scalar_t* prod = scalar_from(0);
+    uint128_t den  = (uint128_t)u->den * v->den;
+
+    int128_t sum;
+
+    if (integer_num_dot(u->num, v->num, u->n, 1, &sum)) {
+        cd_store(prod, sum, den);
+        return prod;
+    }
+
+    scalar_t part = zero;
+
+    sum = 0;
+
+    for (size_t i = 0; i < u->n; i++) {
+        int128_t p = (int128_t)u->num[i] * v->num[i];
+        int128_t s;
+
+        if (__builtin_add_overflow(sum, p, &s)) {
+            cd_store(&part, sum, den);
+            scalar_add(prod, prod, &part);
+            s = p;
+        }
+
+        sum = s;
+    }
+
+    cd_store(&part, sum, den);
+    scalar_add(prod, prod, &part);
+    scalar_clear(&part);
+
+    return prod;
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+static matrix_cd_t* matrix_cd_alloc(size_t m, size_t n)
+{
+    matrix_cd_t* matrix = malloc(sizeof(*matrix) + m * n * sizeof(int64_t));
+    CHECK_NOT_NULL(matrix);
+
+    matrix->m   = m;
+    matrix->n   = n;
+    matrix->den = 1;
+    matrix->num = (int64_t*)(matrix + 1);
+
+    return matrix;
+}
+
+matrix_cd_t* matrix_cd_new(size_t m, size_t n)
+{
+    matrix_cd_t* matrix = matrix_cd_alloc(m, n);
+
+    for (size_t i = 0; i < m * n; i++) {
+        matrix->num[i] = 0;
+    }
+
+    return matrix;
+}
+
+matrix_cd_t* matrix_cd_from(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    matrix_cd_t* cd = matrix_cd_alloc(matrix->m, matrix->n);
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        if (!cd_common_den(matrix_row_ptr(matrix, i), matrix->n, 1, &cd->den)) {
+            matrix_cd_delete(cd);
+            return NULL;
+        }
+    }
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        if (!cd_load(&matrix_cd_at(cd, i, 0), matrix_row_ptr(matrix, i), matrix->n, 1, cd->den)) {
+            matrix_cd_delete(cd);
+            return NULL;
+        }
+    }
+
+    return cd;
+}
+
+matrix_t* matrix_cd_to_matrix(const matrix_cd_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    matrix_t* result = matrix_new(matrix->m, matrix->n);
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        for (size_t j = 0; j < matrix->n; j++) {
+            matrix_at(result, i, j) = cd_scalar(matrix_cd_at(matrix, i, j), matrix->den);
+        }
+    }
+
+    matrix_refresh_integer(result);
+
+    return result;
+}
+
+void matrix_cd_normalize(matrix_cd_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    matrix->den = cd_reduce(matrix->num, matrix->m * matrix->n, matrix->den);
+}
+
+// Below this many integer multiply-adds a product runs on the calling
+// thread. They are far cheaper than rational ones, hence the higher bar
+// than matrix_prod's.
+#define CD_PROD_PARALLEL_MIN (128 * 128 * 128)
+
+typedef enum matrix_cd_prod_mode {
+    // Products and sums all fit 64 bits
+    CD_PROD_64,
+
+    // They fit 128 bits
+    CD_PROD_128,
+
+    // They may not, every addition is checked
+    CD_PROD_CHECKED,
+} matrix_cd_prod_mode_t;
+
+typedef struct matrix_cd_prod_job {
+    const matrix_cd_t*    a;
+    const matrix_cd_t*    b;
+    matrix_cd_t*          c;
+    int128_t*             acc;
+    matrix_cd_prod_mode_t mode;
+    bool                  overflow;
+} matrix_cd_prod_job_t;
+
+// Row i of the product, accumulated as row i of a times the rows of b so
+// that the inner loop runs over contiguous memory
+static void matrix_cd_prod_row(void* arg, size_t i)
+{
+    matrix_cd_prod_job_t* job = arg;
+    const matrix_cd_t*    a   = job->a;
+    const matrix_cd_t*    b   = job->b;
+    size_t                p   = b->n;
+
+    if (job->mode == CD_PROD_64) {
+        int64_t* c = &matrix_cd_at(job->c, i, 0);
+
+        for (size_t k = 0; k < a->n; k++) {
+            int64_t        x   = matrix_cd_at(a, i, k);
+            const int64_t* row = &matrix_cd_at(b, k, 0);
+
+            if (x != 0) {
+                for (size_t j = 0; j < p; j++) {
+                    c[j] += x * row[j];
+                }
+            }
+        }
+
+        return;
+    }
+
+    int128_t* c = &job->acc[i * p];
+
+    for (size_t j = 0; j < p; j++) {
+        c[j] = 0;
+    }
+
+    for (size_t k = 0; k < a->n; k++) {
+        int64_t        x   = matrix_cd_at(a, i, k);
+        const int64_t* row = &matrix_cd_at(b, k, 0);
+
+        if (x == 0) {
+            continue;
+        }
+
+        if (job->mode == CD_PROD_128) {
+            for (size_t j = 0; j < p; j++) {
+                c[j] += (int128_t)x * row[j];
+            }
+        } else {
+            for (size_t j = 0; j < p; j++) {
+                if (__builtin_add_overflow(c[j], (int128_t)x * row[j], &c[j])) {
+                    __atomic_store_n(&job->overflow, true, __ATOMIC_RELAXED);
+                    return;
+                }
+            }
+        }
+    }
+}
+
+// The gcd of den and every magnitude in acc
+static uint128_t matrix_cd_content(int128_t* acc, size_t count, uint128_t den)
+{
+    uint128_t g = den;
+
+    for (size_t i = 0; i < count && g != 1; i++) {
+        uint128_t x = acc[i] < 0 ? -(uint128_t)acc[i] : (uint128_t)acc[i];
+
+        if (x != 0) {
+            g = x <= UINT64_MAX && g <= UINT64_MAX ? uint64_gcd(x, g) : uint128_gcd(x, g);
+        }
+    }
+
+    return g;
+}
+
+// The product as integer multiply-adds over the product of the two
+// denominators, normalized once at the end. The sums run in 64 bits when
+// the bit lengths of the largest entries and of the inner dimension show
+// that they can't overflow, in 128 bits otherwise. Returns NULL when the
+// normalized result doesn't fit the common-denominator form, matrix_prod
+// on the per-element form then gives the exact product.
+matrix_cd_t* matrix_cd_prod(const matrix_cd_t* a, const matrix_cd_t* b)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+
+    if (a->n != b->m) {
+        ERROR("matrix dimension mismatch A is (%zu, %zu), B is (%zu, %zu)", a->m, a->n, b->m, b->n);
+    }
+
+    size_t    m     = a->m;
+    size_t    p     = b->n;
+    uint128_t den   = (uint128_t)a->den * b->den;
+    size_t    bound = integer_num_bits(a->num, a->m * a->n, 1) + integer_num_bits(b->num, b->m * b->n, 1) + integer_length(a->n);
+
+    matrix_cd_t*         c   = matrix_cd_new(m, p);
+    matrix_cd_prod_job_t job = {
+        .a        = a,
+        .b        = b,
+        .c        = c,
+        .acc      = NULL,
+        .mode     = bound <= 63 ? CD_PROD_64 : bound <= 127 ? CD_PROD_128 : CD_PROD_CHECKED,
+        .overflow = false,
+    };
+
+    if (job.mode != CD_PROD_64) {
+        job.acc = malloc(m * p * sizeof(int128_t));
+        CHECK_NOT_NULL(job.acc);
+    }
+
+    if (m * p * a->n < CD_PROD_PARALLEL_MIN) {
+        for (size_t i = 0; i < m; i++) {
+            matrix_cd_prod_row(&job, i);
+        }
+    } else {
+        pool_run(matrix_cd_prod_row, &job, m);
+    }
+
+    if (job.mode == CD_PROD_64) {
+        if (den <= UINT64_MAX) {
+            c->den = cd_reduce(c->num, m * p, den);
+            return c;
+        }
+
+        // The denominator only fits once reduced, which goes through the
+        // 128-bit path below
+        job.acc = malloc(m * p * sizeof(int128_t));
+        CHECK_NOT_NULL(job.acc);
+
+        for (size_t i = 0; i < m * p; i++) {
+            job.acc[i] = c->num[i];
+        }
+    }
+
+    uint128_t g = job.overflow ? 1 : matrix_cd_content(job.acc, m * p, den);
+
+    bool fits = !job.overflow && den / g <= UINT64_MAX;
+
+    for (size_t i = 0; i < m * p && fits; i++) {
+        int128_t x = job.acc[i] / (int128_t)g;
+
+        if (x > INT64_MAX || x < -INT64_MAX) {
+            fits = false;
+        }
+
+        c->num[i] = x;
+    }
+
+    c->den = den / g;
+    free(job.acc);
+
+    if (!fits) {
+        matrix_cd_delete(c);
+    }
+
+    return c;
+}
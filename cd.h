@@ -0,0 +1,63 @@
+#ifndef TD_CD_H
+#define TD_CD_H
+
+#include "matrix.h"
+#include "scalar.h"
+#include "vector.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// The common-denominator form of a vector: the i-th element is num[i] / den
+// for a single positive den shared by the whole vector. Sums of two such
+// vectors and dot products are then integer multiply-adds, the one gcd left
+// being the normalization of the result.
+//
+// Numerators stay within +/-INT64_MAX and are not reduced against den,
+// vector_cd_normalize divides out their common factor. Conversions are
+// explicit: vector_cd_from returns NULL when an element is promoted or the
+// common denominator doesn't fit 64 bits.
+typedef struct vector_cd {
+    size_t n;
+
+    // The denominator shared by every element
+    uint64_t den;
+
+    // The numerators, allocated together with the vector itself
+    int64_t* num;
+} vector_cd_t;
+
+// The same for a row-major m x n matrix, one denominator for every entry
+typedef struct matrix_cd {
+    size_t   m, n;
+    uint64_t den;
+    int64_t* num;
+} matrix_cd_t;
+
+#define matrix_cd_at(matrix, i, j) ((matrix)->num[(i) * (matrix)->n + (j)])
+
+#define vector_cd_delete(vector) \
+    if ((vector) != NULL) {      \
+        free(vector);            \
+        (vector) = NULL;         \
+    }
+
+#define matrix_cd_delete(matrix) \
+    if ((matrix) != NULL) {      \
+        free(matrix);            \
+        (matrix) = NULL;         \
+    }
+
+vector_cd_t*    vector_cd_new(size_t n);
+vector_cd_t*    vector_cd_from(const vector_t* vector);
+vector_t*       vector_cd_to_vector(const vector_cd_t* vector);
+void            vector_cd_normalize(vector_cd_t* vector);
+scalar_status_t vector_cd_add(vector_cd_t* u, const vector_cd_t* v);
+scalar_status_t vector_cd_sub(vector_cd_t* u, const vector_cd_t* v);
+scalar_t*       vector_cd_dot_prod(const vector_cd_t* u, const vector_cd_t* v);
+matrix_cd_t*    matrix_cd_new(size_t m, size_t n);
+matrix_cd_t*    matrix_cd_from(const matrix_t* matrix);
+matrix_t*       matrix_cd_to_matrix(const matrix_cd_t* matrix);
+void            matrix_cd_normalize(matrix_cd_t* matrix);
+matrix_cd_t*    matrix_cd_prod(const matrix_cd_t* a, const matrix_cd_t* b);
+
+#endif /* cd.h */
@@ -0,0 +1,78 @@
+#ifndef TD_DECIMAL_H
+#define TD_DECIMAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Decimal printing of 64-bit magnitudes without sprintf: digits come out two
+// at a time from a table of the 100 pairs, so a 20-digit value takes ten
+// divisions by 100 instead of twenty by 10, and the length is known before
+// writing, straight from the bit length.
+
+static const char decimal_pairs[200] = "00010203040506070809"
+                                       "10111213141516171819"
+                                       "20212223242526272829"
+                                       "30313233343536373839"
+                                       "40414243444546474849"
+                                       "50515253545556575859"
+                                       "60616263646566676869"
+                                       "70717273747576777879"
+                                       "80818283848586878889"
+                                       "90919293949596979899";
+
+static const uint64_t decimal_powers[20] = {
+    1ULL,
+    10ULL,
+    100ULL,
+    1000ULL,
+    10000ULL,
+    100000ULL,
+    1000000ULL,
+    10000000ULL,
+    100000000ULL,
+    1000000000ULL,
+    10000000000ULL,
+    100000000000ULL,
+    1000000000000ULL,
+    10000000000000ULL,
+    100000000000000ULL,
+    1000000000000000ULL,
+    10000000000000000ULL,
+    100000000000000000ULL,
+    1000000000000000000ULL,
+    10000000000000000000ULL,
+};
+
+// The number of digits of x, 1 for 0. log10(2) is close to 1233 / 4096, so
+// the bit length gives the count up to one, settled by a single comparison.
+// Setting the low bit changes neither, and makes 0 count as 1.
+static inline size_t decimal_length(uint64_t x)
+{
+    x |= 1;
+
+    size_t bits  = 64 - __builtin_clzll(x);
+    size_t guess = (bits * 1233) >> 12;
+
+    return guess + 1 - (x < decimal_powers[guess]);
+}
+
+// Writes the last len digits of x to dst, left padded with zeros, without a
+// terminating '\0'
+static inline void decimal_write(char* dst, uint64_t x, size_t len)
+{
+    char* end = dst + len;
+
+    while (end - dst >= 2) {
+        const char* pair = &decimal_pairs[2 * (x % 100)];
+
+        x /= 100;
+        *--end = pair[1];
+        *--end = pair[0];
+    }
+
+    if (end > dst) {
+        *--end = '0' + x % 10;
+    }
+}
+
+#endif /* decimal.h */
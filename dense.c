@@ -0,0 +1,112 @@
+#include "dense.h"
+#include "pool.h"
+#include "utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define DENSE_X86
+#endif
+
+// Elements start on a cache line, which is also the AVX-512 register width
+#define DENSE_ALIGN 64
+
+// Rows of C are dealt to the pool in blocks of this many
+#define DENSE_PROD_ROWS 64
+
+// Panels of the inner dimension, sized so that the strip of B being
+// multiplied stays in the L1 cache while every row block streams over it
+#define DENSE_PROD_DEPTH 256
+
+// Transposes go through square tiles of this side
+#define DENSE_TRANSPOSE_BLOCK 16
+
+// Below this many multiply-adds a product runs on the calling thread
+#define DENSE_PARALLEL_MIN (128 * 128 * 128)
+
+// The same for the trailing update of an LU step, whose rows are the tasks
+#define DENSE_LU_PARALLEL_MIN (256 * 256)
+
+#define DENSE_INLINE static inline __attribute__((always_inline))
+
+// Symbols of the instantiation for DENSE_S, e.g. DENSE_NAME(matrix, prod)
+#define DENSE_CAT_(prefix, tag, name) prefix##_##tag##_##name
+#define DENSE_CAT(prefix, tag, name)  DENSE_CAT_(prefix, tag, name)
+#define DENSE_NAME(prefix, name)      DENSE_CAT(prefix, DENSE_S, name)
+
+// A header followed by size bytes of elements. The header gets a cache line
+// of its own, so that the elements start on the next one.
+static void* dense_alloc(size_t size)
+{
+    size_t total = (DENSE_ALIGN + size + DENSE_ALIGN - 1) / DENSE_ALIGN * DENSE_ALIGN;
+
+    void* block = aligned_alloc(DENSE_ALIGN, total);
+    CHECK_NOT_NULL(block);
+
+    return block;
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+// -1 until the first kernel runs, then the instruction set in use
+static int dense_current_isa = -1;
+
+static dense_isa_t dense_best_isa(void)
+{
+#ifdef DENSE_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f")) {
+        return DENSE_ISA_AVX512;
+    }
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return DENSE_ISA_AVX2;
+    }
+#endif
+
+    return DENSE_ISA_SCALAR;
+}
+
+// The instruction set the kernels run on, the best one the CPU supports
+// unless dense_set_isa lowered it
+dense_isa_t dense_isa(void)
+{
+    int isa = __atomic_load_n(&dense_current_isa, __ATOMIC_RELAXED);
+
+    if (isa < 0) {
+        isa = dense_best_isa();
+        __atomic_store_n(&dense_current_isa, isa, __ATOMIC_RELAXED);
+    }
+
+    return isa;
+}
+
+// Selects the instruction set of the kernels, capped to what the CPU
+// supports. Returns the one actually selected.
+dense_isa_t dense_set_isa(dense_isa_t isa)
+{
+    dense_isa_t best = dense_best_isa();
+
+    if (isa > best) {
+        isa = best;
+    }
+
+    __atomic_store_n(&dense_current_isa, isa, __ATOMIC_RELAXED);
+    return isa;
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+#define DENSE_T double
+#define DENSE_S d
+#include "dense_template.h"
+#undef DENSE_S
+#undef DENSE_T
+
+#define DENSE_T float
+#define DENSE_S f
+#include "dense_template.h"
+#undef DENSE_S
+#undef DENSE_T
@@ -0,0 +1,77 @@
+#ifndef TD_DENSE_H
+#define TD_DENSE_H
+
+#include "matrix.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+// Vectors and matrices over a machine element type, for when speed matters
+// more than exactness: the rational API computes the reference, these run
+// the same algorithms in floating point. Every element type is a separate
+// instantiation of dense_template.h, declared by DENSE_DECLARE below, and
+// its symbols carry a type tag after the module name:
+//
+//     d   double    matrix_d_t, matrix_d_prod, vector_d_dot_prod, ...
+//     f   float     matrix_f_t, matrix_f_prod, vector_f_dot_prod, ...
+//
+// The layout follows matrix_t and vector_t, so matrix_at and matrix_row_ptr
+// apply to them as well. Elements are allocated together with the header,
+// 64-byte aligned.
+
+// The instruction sets the kernels can run on, in increasing order. The
+// products, dot products and LU updates use fused multiply-adds on AVX2
+// and AVX-512.
+typedef enum dense_isa {
+    DENSE_ISA_SCALAR,
+    DENSE_ISA_AVX2,
+    DENSE_ISA_AVX512,
+} dense_isa_t;
+
+#define DENSE_DECLARE(T, S)                                                                  \
+    typedef struct vector_##S {                                                              \
+        size_t n;                                                                            \
+        T*     items;                                                                        \
+    } vector_##S##_t;                                                                        \
+                                                                                             \
+    typedef struct matrix_##S {                                                              \
+        size_t m, n, ld;                                                                     \
+        T*     data;                                                                         \
+    } matrix_##S##_t;                                                                        \
+                                                                                             \
+    vector_##S##_t* vector_##S##_new(size_t n);                                              \
+    vector_##S##_t* vector_##S##_from(const vector_t* vector);                               \
+    void            vector_##S##_scale(vector_##S##_t* vector, T k);                         \
+    void            vector_##S##_add(vector_##S##_t* u, const vector_##S##_t* v);            \
+    void            vector_##S##_sub(vector_##S##_t* u, const vector_##S##_t* v);            \
+    T               vector_##S##_dot_prod(const vector_##S##_t* u, const vector_##S##_t* v); \
+    matrix_##S##_t* matrix_##S##_new(size_t m, size_t n);                                    \
+    matrix_##S##_t* matrix_##S##_eye(size_t n);                                              \
+    matrix_##S##_t* matrix_##S##_from(const matrix_t* matrix);                               \
+    matrix_##S##_t* matrix_##S##_prod(const matrix_##S##_t* a, const matrix_##S##_t* b);     \
+    void            matrix_##S##_scale(matrix_##S##_t* matrix, T k);                         \
+    void            matrix_##S##_add(matrix_##S##_t* a, const matrix_##S##_t* b);            \
+    void            matrix_##S##_sub(matrix_##S##_t* a, const matrix_##S##_t* b);            \
+    matrix_##S##_t* matrix_##S##_transpose(const matrix_##S##_t* matrix);                    \
+    void            matrix_##S##_lu(const matrix_##S##_t* matrix, matrix_##S##_t** L, matrix_##S##_t** U, \
+                                    matrix_##S##_t** P);
+
+DENSE_DECLARE(double, d)
+DENSE_DECLARE(float, f)
+
+#define dense_delete(x)     \
+    if ((x) != NULL) {      \
+        free(x);            \
+        (x) = NULL;         \
+    }
+
+#define vector_d_delete(vector) dense_delete(vector)
+#define vector_f_delete(vector) dense_delete(vector)
+#define matrix_d_delete(matrix) dense_delete(matrix)
+#define matrix_f_delete(matrix) dense_delete(matrix)
+
+dense_isa_t dense_isa(void);
+dense_isa_t dense_set_isa(dense_isa_t isa);
+
+#endif /* dense.h */
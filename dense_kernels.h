@@ -0,0 +1,158 @@
+// The kernels of dense_template.h for one instruction set, included there
+// once per set with DENSE_ISA set to its tag, DENSE_ATTR to the attributes
+// of its functions, DENSE_WIDTH to its register width in bytes and
+// DENSE_VECS to the width of the product strips in registers. Not a
+// standalone header: it defines functions.
+
+#define DENSE_ISA_CAT_(name, isa) name##_##isa
+#define DENSE_ISA_CAT(name, isa)  DENSE_ISA_CAT_(name, isa)
+#define DENSE_KNAME(name)         DENSE_NAME(dense, DENSE_ISA_CAT(name, DENSE_ISA))
+#define DENSE_KVEC                DENSE_KNAME(vec_t)
+#define DENSE_KLANES              (DENSE_WIDTH / sizeof(DENSE_T))
+
+// A register of elements, and the same at any element boundary for the
+// loads and stores into rows
+typedef DENSE_T DENSE_KVEC __attribute__((vector_size(DENSE_WIDTH)));
+typedef DENSE_T DENSE_KNAME(vec_u_t) __attribute__((vector_size(DENSE_WIDTH), aligned(sizeof(DENSE_T))));
+
+#define dense_vec_at(p) (*(DENSE_KNAME(vec_u_t)*)(p))
+
+// y = y + a . x
+DENSE_ATTR static void DENSE_KNAME(axpy)(DENSE_T* y, const DENSE_T* x, DENSE_T a, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + DENSE_KLANES <= n; i += DENSE_KLANES) {
+        dense_vec_at(&y[i]) += a * dense_vec_at(&x[i]);
+    }
+
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+// x = k . x
+DENSE_ATTR static void DENSE_KNAME(scale)(DENSE_T* x, DENSE_T k, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + DENSE_KLANES <= n; i += DENSE_KLANES) {
+        dense_vec_at(&x[i]) *= k;
+    }
+
+    for (; i < n; i++) {
+        x[i] *= k;
+    }
+}
+
+// Four independent accumulators hide the latency of the multiply-adds
+DENSE_ATTR static DENSE_T DENSE_KNAME(dot)(const DENSE_T* x, const DENSE_T* y, size_t n)
+{
+    DENSE_KVEC s[4] = { { 0 }, { 0 }, { 0 }, { 0 } };
+    size_t     i    = 0;
+
+    for (; i + 4 * DENSE_KLANES <= n; i += 4 * DENSE_KLANES) {
+        for (size_t v = 0; v < 4; v++) {
+            s[v] += dense_vec_at(&x[i + v * DENSE_KLANES]) * dense_vec_at(&y[i + v * DENSE_KLANES]);
+        }
+    }
+
+    for (; i + DENSE_KLANES <= n; i += DENSE_KLANES) {
+        s[0] += dense_vec_at(&x[i]) * dense_vec_at(&y[i]);
+    }
+
+    s[0] += s[1] + (s[2] + s[3]);
+
+    DENSE_T sum = 0;
+    for (size_t l = 0; l < DENSE_KLANES; l++) {
+        sum += s[0][l];
+    }
+
+    for (; i < n; i++) {
+        sum += x[i] * y[i];
+    }
+
+    return sum;
+}
+
+// C(i:i+rows, j:j+strip) += A(i:i+rows, k0:k1) x B(k0:k1, j:j+strip) on
+// rows x DENSE_VECS register accumulators. rows is a constant once inlined,
+// so the loops below unroll entirely.
+DENSE_INLINE DENSE_ATTR void DENSE_KNAME(prod_micro)(DENSE_MATRIX* c, const DENSE_MATRIX* a, const DENSE_MATRIX* b,
+                                                      size_t i, size_t j, size_t k0, size_t k1, size_t rows)
+{
+    DENSE_KVEC acc[4][DENSE_VECS];
+
+    for (size_t r = 0; r < rows; r++) {
+        for (size_t v = 0; v < DENSE_VECS; v++) {
+            acc[r][v] = (DENSE_KVEC){ 0 };
+        }
+    }
+
+    for (size_t k = k0; k < k1; k++) {
+        DENSE_T*   bk = &matrix_at(b, k, j);
+        DENSE_KVEC bv[DENSE_VECS];
+
+        for (size_t v = 0; v < DENSE_VECS; v++) {
+            bv[v] = dense_vec_at(&bk[v * DENSE_KLANES]);
+        }
+
+        for (size_t r = 0; r < rows; r++) {
+            DENSE_T ark = matrix_at(a, i + r, k);
+
+            for (size_t v = 0; v < DENSE_VECS; v++) {
+                acc[r][v] += ark * bv[v];
+            }
+        }
+    }
+
+    for (size_t r = 0; r < rows; r++) {
+        DENSE_T* cr = &matrix_at(c, i + r, j);
+
+        for (size_t v = 0; v < DENSE_VECS; v++) {
+            dense_vec_at(&cr[v * DENSE_KLANES]) += acc[r][v];
+        }
+    }
+}
+
+// Rows [i0, i1) of C += A x B. The inner dimension goes in panels, and
+// within a panel every row block sweeps the same strip of B before the
+// next strip is loaded.
+DENSE_ATTR static void DENSE_KNAME(prod)(DENSE_MATRIX* c, const DENSE_MATRIX* a, const DENSE_MATRIX* b, size_t i0,
+                                         size_t i1)
+{
+    size_t strip = DENSE_VECS * DENSE_KLANES;
+
+    for (size_t k0 = 0; k0 < a->n; k0 += DENSE_PROD_DEPTH) {
+        size_t k1 = k0 + DENSE_PROD_DEPTH < a->n ? k0 + DENSE_PROD_DEPTH : a->n;
+        size_t j  = 0;
+
+        for (; j + strip <= c->n; j += strip) {
+            size_t i = i0;
+
+            for (; i + 4 <= i1; i += 4) {
+                DENSE_KNAME(prod_micro)(c, a, b, i, j, k0, k1, 4);
+            }
+
+            for (; i < i1; i++) {
+                DENSE_KNAME(prod_micro)(c, a, b, i, j, k0, k1, 1);
+            }
+        }
+
+        // The columns past the last full strip
+        for (size_t i = i0; i < i1 && j < c->n; i++) {
+            DENSE_T* ci = matrix_row_ptr(c, i);
+
+            for (size_t k = k0; k < k1; k++) {
+                DENSE_KNAME(axpy)(&ci[j], &matrix_at(b, k, j), matrix_at(a, i, k), c->n - j);
+            }
+        }
+    }
+}
+
+#undef dense_vec_at
+#undef DENSE_KLANES
+#undef DENSE_KVEC
+#undef DENSE_KNAME
+#undef DENSE_ISA_CAT
+#undef DENSE_ISA_CAT_
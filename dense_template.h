@@ -0,0 +1,389 @@
+// The element-typed half of dense.c, included there once per element type
+// with DENSE_T set to the type and DENSE_S to its tag. Not a standalone
+// header: it defines functions.
+
+#define DENSE_VECTOR  DENSE_NAME(vector, t)
+#define DENSE_MATRIX  DENSE_NAME(matrix, t)
+#define DENSE_KERNELS DENSE_NAME(dense, kernels_t)
+
+_Static_assert(sizeof(DENSE_MATRIX) <= DENSE_ALIGN, "the header must fit in front of the elements");
+
+typedef struct DENSE_NAME(dense, kernels) {
+    void (*axpy)(DENSE_T* y, const DENSE_T* x, DENSE_T a, size_t n);
+    void (*scale)(DENSE_T* x, DENSE_T k, size_t n);
+    DENSE_T (*dot)(const DENSE_T* x, const DENSE_T* y, size_t n);
+    void (*prod)(DENSE_MATRIX* c, const DENSE_MATRIX* a, const DENSE_MATRIX* b, size_t i0, size_t i1);
+} DENSE_KERNELS;
+
+// The kernels compiled for every instruction set. The AVX ones contract
+// a * b + c into fused multiply-adds whatever the -ffp-contract setting of
+// the build. Product strips are two registers wide on every set: with the
+// 4 rows of a block that makes 8 accumulators, enough to cover the latency
+// of the multiply-adds, and wider strips measured slower.
+#define DENSE_ISA    scalar
+#define DENSE_ATTR
+#define DENSE_WIDTH  16
+#define DENSE_VECS   2
+#include "dense_kernels.h"
+#undef DENSE_VECS
+#undef DENSE_WIDTH
+#undef DENSE_ATTR
+#undef DENSE_ISA
+
+#ifdef DENSE_X86
+#define DENSE_ISA    avx2
+#define DENSE_ATTR   __attribute__((target("avx2,fma"), optimize("fp-contract=fast")))
+#define DENSE_WIDTH  32
+#define DENSE_VECS   2
+#include "dense_kernels.h"
+#undef DENSE_VECS
+#undef DENSE_WIDTH
+#undef DENSE_ATTR
+#undef DENSE_ISA
+
+#define DENSE_ISA    avx512
+#define DENSE_ATTR   __attribute__((target("avx512f"), optimize("fp-contract=fast")))
+#define DENSE_WIDTH  64
+#define DENSE_VECS   2
+#include "dense_kernels.h"
+#undef DENSE_VECS
+#undef DENSE_WIDTH
+#undef DENSE_ATTR
+#undef DENSE_ISA
+
+#define DENSE_ISA_ENTRY(isa)                                                                                          \
+    {                                                                                                                 \
+        DENSE_NAME(dense, axpy_##isa), DENSE_NAME(dense, scale_##isa), DENSE_NAME(dense, dot_##isa),                  \
+            DENSE_NAME(dense, prod_##isa)                                                                             \
+    }
+#else
+#define DENSE_ISA_ENTRY(isa) DENSE_ISA_ENTRY_SCALAR
+#endif
+
+#define DENSE_ISA_ENTRY_SCALAR                                                                                        \
+    {                                                                                                                 \
+        DENSE_NAME(dense, axpy_scalar), DENSE_NAME(dense, scale_scalar), DENSE_NAME(dense, dot_scalar),               \
+            DENSE_NAME(dense, prod_scalar)                                                                            \
+    }
+
+static const DENSE_KERNELS DENSE_NAME(dense, kernels)[] = {
+    [DENSE_ISA_SCALAR] = DENSE_ISA_ENTRY_SCALAR,
+    [DENSE_ISA_AVX2]   = DENSE_ISA_ENTRY(avx2),
+    [DENSE_ISA_AVX512] = DENSE_ISA_ENTRY(avx512),
+};
+
+#undef DENSE_ISA_ENTRY_SCALAR
+#undef DENSE_ISA_ENTRY
+
+#define dense_kernels() (&DENSE_NAME(dense, kernels)[dense_isa()])
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+DENSE_VECTOR* DENSE_NAME(vector, new)(size_t n)
+{
+    DENSE_VECTOR* vector = dense_alloc(n * sizeof(DENSE_T));
+
+    vector->n     = n;
+    vector->items = (DENSE_T*)((char*)vector + DENSE_ALIGN);
+
+    memset(vector->items, 0, n * sizeof(DENSE_T));
+    return vector;
+}
+
+DENSE_VECTOR* DENSE_NAME(vector, from)(const vector_t* vector)
+{
+    CHECK_NOT_NULL(vector);
+
+    DENSE_VECTOR* result = DENSE_NAME(vector, new)(vector->n);
+
+    for (size_t i = 0; i < vector->n; i++) {
+        result->items[i] = scalar_to_double(&vector_at(vector, i));
+    }
+
+    return result;
+}
+
+void DENSE_NAME(vector, scale)(DENSE_VECTOR* vector, DENSE_T k)
+{
+    CHECK_NOT_NULL(vector);
+
+    dense_kernels()->scale(vector->items, k, vector->n);
+}
+
+static void DENSE_NAME(vector, axpy)(DENSE_VECTOR* u, const DENSE_VECTOR* v, DENSE_T a)
+{
+    CHECK_NOT_NULL(u);
+    CHECK_NOT_NULL(v);
+
+    if (u->n != v->n) {
+        ERROR("vector dimension mismatch (u=%zu, v=%zu)\n", u->n, v->n);
+    }
+
+    dense_kernels()->axpy(u->items, v->items, a, u->n);
+}
+
+void DENSE_NAME(vector, add)(DENSE_VECTOR* u, const DENSE_VECTOR* v)
+{
+    DENSE_NAME(vector, axpy)(u, v, 1);
+}
+
+void DENSE_NAME(vector, sub)(DENSE_VECTOR* u, const DENSE_VECTOR* v)
+{
+    DENSE_NAME(vector, axpy)(u, v, -1);
+}
+
+DENSE_T DENSE_NAME(vector, dot_prod)(const DENSE_VECTOR* u, const DENSE_VECTOR* v)
+{
+    CHECK_NOT_NULL(u);
+    CHECK_NOT_NULL(v);
+
+    if (u->n != v->n) {
+        ERROR("vector dimension mismatch (u=%zu, v=%zu)\n", u->n, v->n);
+    }
+
+    return dense_kernels()->dot(u->items, v->items, u->n);
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+DENSE_MATRIX* DENSE_NAME(matrix, new)(size_t m, size_t n)
+{
+    DENSE_MATRIX* matrix = dense_alloc(m * n * sizeof(DENSE_T));
+
+    matrix->m    = m;
+    matrix->n    = n;
+    matrix->ld   = n;
+    matrix->data = (DENSE_T*)((char*)matrix + DENSE_ALIGN);
+
+    memset(matrix->data, 0, m * n * sizeof(DENSE_T));
+    return matrix;
+}
+
+DENSE_MATRIX* DENSE_NAME(matrix, eye)(size_t n)
+{
+    DENSE_MATRIX* matrix = DENSE_NAME(matrix, new)(n, n);
+
+    for (size_t i = 0; i < n; i++) {
+        matrix_at(matrix, i, i) = 1;
+    }
+
+    return matrix;
+}
+
+DENSE_MATRIX* DENSE_NAME(matrix, from)(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    DENSE_MATRIX* result = DENSE_NAME(matrix, new)(matrix->m, matrix->n);
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        for (size_t j = 0; j < matrix->n; j++) {
+            matrix_at(result, i, j) = scalar_to_double(&matrix_at(matrix, i, j));
+        }
+    }
+
+    return result;
+}
+
+typedef struct DENSE_NAME(dense, prod_job) {
+    DENSE_MATRIX*       c;
+    const DENSE_MATRIX *a, *b;
+
+    const DENSE_KERNELS* kernels;
+} DENSE_NAME(dense, prod_job_t);
+
+static void DENSE_NAME(dense, prod_task)(void* arg, size_t index)
+{
+    DENSE_NAME(dense, prod_job_t)* job = arg;
+
+    size_t i0 = index * DENSE_PROD_ROWS;
+    size_t i1 = i0 + DENSE_PROD_ROWS < job->c->m ? i0 + DENSE_PROD_ROWS : job->c->m;
+
+    job->kernels->prod(job->c, job->a, job->b, i0, i1);
+}
+
+DENSE_MATRIX* DENSE_NAME(matrix, prod)(const DENSE_MATRIX* a, const DENSE_MATRIX* b)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+
+    if (a->n != b->m) {
+        ERROR("matrix dimension mismatch A is (%zu, %zu), B is (%zu, %zu)", a->m, a->n, b->m, b->n);
+    }
+
+    DENSE_MATRIX* c = DENSE_NAME(matrix, new)(a->m, b->n);
+
+    DENSE_NAME(dense, prod_job_t) job = { .c = c, .a = a, .b = b, .kernels = dense_kernels() };
+
+    if (a->m * a->n * b->n < DENSE_PARALLEL_MIN) {
+        job.kernels->prod(c, a, b, 0, c->m);
+    } else {
+        pool_run(DENSE_NAME(dense, prod_task), &job, (c->m + DENSE_PROD_ROWS - 1) / DENSE_PROD_ROWS);
+    }
+
+    return c;
+}
+
+void DENSE_NAME(matrix, scale)(DENSE_MATRIX* matrix, DENSE_T k)
+{
+    CHECK_NOT_NULL(matrix);
+
+    const DENSE_KERNELS* kernels = dense_kernels();
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        kernels->scale(matrix_row_ptr(matrix, i), k, matrix->n);
+    }
+}
+
+static void DENSE_NAME(matrix, axpy)(DENSE_MATRIX* a, const DENSE_MATRIX* b, DENSE_T k)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+
+    if (a->m != b->m || a->n != b->n) {
+        ERROR("matrix dimensions mismatch a=(%zu, %zu), b=(%zu, %zu)", a->m, a->n, b->m, b->n);
+    }
+
+    const DENSE_KERNELS* kernels = dense_kernels();
+
+    for (size_t i = 0; i < a->m; i++) {
+        kernels->axpy(matrix_row_ptr(a, i), matrix_row_ptr(b, i), k, a->n);
+    }
+}
+
+void DENSE_NAME(matrix, add)(DENSE_MATRIX* a, const DENSE_MATRIX* b)
+{
+    DENSE_NAME(matrix, axpy)(a, b, 1);
+}
+
+void DENSE_NAME(matrix, sub)(DENSE_MATRIX* a, const DENSE_MATRIX* b)
+{
+    DENSE_NAME(matrix, axpy)(a, b, -1);
+}
+
+// Square tiles keep both the rows read and the columns written in cache
+DENSE_MATRIX* DENSE_NAME(matrix, transpose)(const DENSE_MATRIX* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    DENSE_MATRIX* transpose = DENSE_NAME(matrix, new)(matrix->n, matrix->m);
+
+    for (size_t i0 = 0; i0 < matrix->m; i0 += DENSE_TRANSPOSE_BLOCK) {
+        size_t i1 = i0 + DENSE_TRANSPOSE_BLOCK < matrix->m ? i0 + DENSE_TRANSPOSE_BLOCK : matrix->m;
+
+        for (size_t j0 = 0; j0 < matrix->n; j0 += DENSE_TRANSPOSE_BLOCK) {
+            size_t j1 = j0 + DENSE_TRANSPOSE_BLOCK < matrix->n ? j0 + DENSE_TRANSPOSE_BLOCK : matrix->n;
+
+            for (size_t i = i0; i < i1; i++) {
+                for (size_t j = j0; j < j1; j++) {
+                    matrix_at(transpose, j, i) = matrix_at(matrix, i, j);
+                }
+            }
+        }
+    }
+
+    return transpose;
+}
+
+typedef struct DENSE_NAME(dense, lu_job) {
+    DENSE_MATRIX* lu;
+
+    // The pivot row
+    size_t k;
+
+    const DENSE_KERNELS* kernels;
+} DENSE_NAME(dense, lu_job_t);
+
+// Eliminates column k from row k + 1 + index
+static void DENSE_NAME(dense, lu_task)(void* arg, size_t index)
+{
+    DENSE_NAME(dense, lu_job_t)* job = arg;
+
+    DENSE_MATRIX* lu = job->lu;
+    size_t        k  = job->k;
+    DENSE_T*      ri = matrix_row_ptr(lu, k + 1 + index);
+    DENSE_T*      rk = matrix_row_ptr(lu, k);
+
+    ri[k] /= rk[k];
+    job->kernels->axpy(&ri[k + 1], &rk[k + 1], -ri[k], lu->n - k - 1);
+}
+
+// P.A = L.U by right-looking elimination with partial pivoting on the
+// largest magnitude. A zero column leaves a zero on the diagonal of U.
+void DENSE_NAME(matrix, lu)(const DENSE_MATRIX* matrix, DENSE_MATRIX** L, DENSE_MATRIX** U, DENSE_MATRIX** P)
+{
+    CHECK_NOT_NULL(matrix);
+
+    if (matrix->m != matrix->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    size_t        n    = matrix->n;
+    DENSE_MATRIX* lu   = DENSE_NAME(matrix, new)(n, n);
+    size_t*       perm = malloc(n * sizeof(size_t));
+    CHECK_NOT_NULL(perm);
+
+    for (size_t i = 0; i < n; i++) {
+        memcpy(matrix_row_ptr(lu, i), matrix_row_ptr(matrix, i), n * sizeof(DENSE_T));
+        perm[i] = i;
+    }
+
+    DENSE_NAME(dense, lu_job_t) job = { .lu = lu, .kernels = dense_kernels() };
+
+    for (size_t k = 0; k < n; k++) {
+        size_t p = k;
+
+        for (size_t i = k + 1; i < n; i++) {
+            if (fabs(matrix_at(lu, i, k)) > fabs(matrix_at(lu, p, k))) {
+                p = i;
+            }
+        }
+
+        if (matrix_at(lu, p, k) == 0) {
+            continue;
+        }
+
+        if (p != k) {
+            for (size_t j = 0; j < n; j++) {
+                DENSE_T x           = matrix_at(lu, k, j);
+                matrix_at(lu, k, j) = matrix_at(lu, p, j);
+                matrix_at(lu, p, j) = x;
+            }
+
+            size_t x = perm[k];
+            perm[k]  = perm[p];
+            perm[p]  = x;
+        }
+
+        size_t rows = n - k - 1;
+        job.k       = k;
+
+        if (rows * rows < DENSE_LU_PARALLEL_MIN) {
+            for (size_t i = 0; i < rows; i++) {
+                DENSE_NAME(dense, lu_task)(&job, i);
+            }
+        } else {
+            pool_run(DENSE_NAME(dense, lu_task), &job, rows);
+        }
+    }
+
+    *L = DENSE_NAME(matrix, eye)(n);
+    *U = DENSE_NAME(matrix, new)(n, n);
+    *P = DENSE_NAME(matrix, new)(n, n);
+
+    // Unpack P.A = L.U from the packed factors
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            matrix_at(j < i ? *L : *U, i, j) = matrix_at(lu, i, j);
+        }
+        matrix_at(*P, i, perm[i]) = 1;
+    }
+
+    free(perm);
+    dense_delete(lu);
+}
+
+#undef dense_kernels
+#undef DENSE_KERNELS
+#undef DENSE_MATRIX
+#undef DENSE_VECTOR
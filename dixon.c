@@ -0,0 +1,408 @@
+#include "dixon.h"
+#include "bignum.h"
+#include "gcd.h"
+#include "lu.h"
+#include "modp.h"
+#include "utils.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The lifting prime is taken below this, so that a product of an entry and
+// a digit sums over a row within 128 bits
+#define DIXON_PRIME_TOP ((uint64_t)1 << 31)
+
+// Primes tried before checking that A is regular at all
+#define DIXON_PRIME_TRIES 3
+
+// [B | c] = S.[A | b], S the diagonal of the least row scales that clear the
+// denominators of A and b, which leaves the solution unchanged
+typedef struct dixon {
+    size_t   n;
+    int64_t* B;
+    int64_t* c;
+
+    // The factorization of B modulo p in Montgomery form: L below the
+    // diagonal with a unit diagonal implied, U on and above it, row i of LU
+    // coming from row perm[i] of B, and the inverses of the pivots
+    modp_t    f;
+    uint64_t* LU;
+    size_t*   perm;
+    uint64_t* inv;
+} dixon_t;
+
+static bool dixon_magnitude(uint128_t v, bool negative, int64_t* x)
+{
+    if (v > INT64_MAX) {
+        return false;
+    }
+
+    *x = negative ? -(int64_t)v : (int64_t)v;
+    return true;
+}
+
+// Fills B and c, or returns false if some scaled entry doesn't fit 64 bits
+static bool dixon_integer(dixon_t* d, const matrix_t* a, const vector_t* b)
+{
+    size_t n = d->n;
+
+    for (size_t i = 0; i < n; i++) {
+        const scalar_t* row = matrix_row_ptr(a, i);
+        uint128_t       lcm = 1;
+
+        for (size_t j = 0; j <= n; j++) {
+            const scalar_t* x = j < n ? &row[j] : &vector_at(b, i);
+
+            if (scalar_is_big(x)) {
+                return false;
+            }
+
+            if (x->num != 0) {
+                lcm = lcm / uint128_gcd(lcm, x->den) * x->den;
+                if (lcm > UINT64_MAX) {
+                    return false;
+                }
+            }
+        }
+
+        for (size_t j = 0; j <= n; j++) {
+            const scalar_t* x = j < n ? &row[j] : &vector_at(b, i);
+            int64_t*        y = j < n ? &d->B[i * n + j] : &d->c[i];
+            uint128_t v = (uint128_t)(x->num < 0 ? -(uint64_t)x->num : (uint64_t)x->num) * (lcm / x->den);
+
+            if (!dixon_magnitude(v, x->num < 0, y)) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static uint64_t dixon_residue(modp_t* f, int128_t v)
+{
+    uint128_t a        = v < 0 ? -(uint128_t)v : (uint128_t)v;
+    uint64_t  limbs[2] = { (uint64_t)a, (uint64_t)(a >> 64) };
+    uint64_t  r        = modp_reduce(f, limbs, 2);
+
+    return v < 0 ? modp_sub(f, 0, r) : r;
+}
+
+// Gaussian elimination of B modulo p. Returns false if B is singular there.
+static bool dixon_factorize(dixon_t* d, uint64_t p)
+{
+    size_t    n  = d->n;
+    modp_t*   f  = &d->f;
+    uint64_t* LU = d->LU;
+
+    modp_init(f, p);
+
+    for (size_t i = 0; i < n; i++) {
+        d->perm[i] = i;
+        for (size_t j = 0; j < n; j++) {
+            LU[i * n + j] = dixon_residue(f, d->B[i * n + j]);
+        }
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        size_t r = k;
+        while (r < n && LU[r * n + k] == 0) {
+            r++;
+        }
+
+        if (r == n) {
+            return false;
+        }
+
+        if (r != k) {
+            for (size_t j = 0; j < n; j++) {
+                uint64_t tmp  = LU[k * n + j];
+                LU[k * n + j] = LU[r * n + j];
+                LU[r * n + j] = tmp;
+            }
+
+            size_t tmp = d->perm[k];
+            d->perm[k] = d->perm[r];
+            d->perm[r] = tmp;
+        }
+
+        uint64_t* rk = &LU[k * n];
+
+        d->inv[k] = modp_inverse(f, rk[k]);
+
+        for (size_t i = k + 1; i < n; i++) {
+            uint64_t* ri = &LU[i * n];
+
+            if (ri[k] == 0) {
+                continue;
+            }
+
+            uint64_t l = modp_mul(f, ri[k], d->inv[k]);
+
+            ri[k] = l;
+            for (size_t j = k + 1; j < n; j++) {
+                ri[j] = modp_sub(f, ri[j], modp_mul(f, l, rk[j]));
+            }
+        }
+    }
+
+    return true;
+}
+
+// y = B^-1 . r mod p, as plain residues. Residues of both operands are
+// below p < 2^31, so a row of products sums in 128 bits and is reduced
+// once.
+static void dixon_digits(dixon_t* d, const int128_t* r, uint64_t* y)
+{
+    size_t    n  = d->n;
+    modp_t*   f  = &d->f;
+    uint64_t* LU = d->LU;
+
+    for (size_t i = 0; i < n; i++) {
+        uint128_t s = 0;
+        for (size_t k = 0; k < i; k++) {
+            s += (uint128_t)LU[i * n + k] * y[k];
+        }
+
+        y[i] = modp_sub(f, dixon_residue(f, r[d->perm[i]]), modp_redc(f, s));
+    }
+
+    for (size_t i = n; i-- > 0;) {
+        uint128_t s = 0;
+        for (size_t k = i + 1; k < n; k++) {
+            s += (uint128_t)LU[i * n + k] * y[k];
+        }
+
+        y[i] = modp_mul(f, modp_sub(f, y[i], modp_redc(f, s)), d->inv[i]);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        y[i] = modp_from(f, y[i]);
+    }
+}
+
+// log2 of the Hadamard bound of the rows of B, with c as an extra column
+// when with_c is set: with it, the bound covers the numerators Cramer's
+// rule gives, without it, the determinant that is their denominator
+static double dixon_bound(dixon_t* d, bool with_c)
+{
+    size_t n    = d->n;
+    double bits = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        long double sum = with_c ? (long double)d->c[i] * d->c[i] : 0;
+
+        for (size_t j = 0; j < n; j++) {
+            sum += (long double)d->B[i * n + j] * d->B[i * n + j];
+        }
+
+        if (sum > 1) {
+            bits += 0.5 * log2((double)sum);
+        }
+    }
+
+    return bits;
+}
+
+// Recovers num / den from its residue v modulo m, with |num| below 2^nbits
+// and den below 2^dbits, by the extended Euclidean algorithm stopped as soon
+// as the remainder is small enough. num is the last remainder, den the
+// matching cofactor, whose sign alternates at every step.
+static void dixon_reconstruct(bignum_t* num, bignum_t* den, bool* negative, const bignum_t* v, const bignum_t* m,
+                              size_t nbits, size_t dbits)
+{
+    bignum_t r0 = BIGNUM_INIT, t0 = BIGNUM_INIT, q = BIGNUM_INIT, r = BIGNUM_INIT;
+
+    bignum_copy(&r0, m);
+    bignum_copy(num, v);
+    bignum_set_u64(&t0, 0);
+    bignum_set_u64(den, 1);
+    *negative = false;
+
+    while (bignum_bits(num) > nbits) {
+        bignum_divmod(&q, &r, &r0, num);
+
+        // t(i+1) = t(i-1) - q t(i), in magnitude a sum
+        bignum_mul(&q, &q, den);
+        bignum_add(&t0, &t0, &q);
+        bignum_swap(&t0, den);
+
+        bignum_swap(&r0, num);
+        bignum_swap(num, &r);
+        *negative = !*negative;
+    }
+
+    if (bignum_bits(den) > dbits) {
+        ERROR_MESSAGE("rational reconstruction failed");
+    }
+
+    bignum_clear(&r);
+    bignum_clear(&q);
+    bignum_clear(&t0);
+    bignum_clear(&r0);
+}
+
+// Lifts digits[i * n + j], the base-p expansion of x modulo p^k, back to
+// the rationals. Solutions share their denominator, a divisor of det(B),
+// so each new component first tries the denominator found so far and
+// needs no reconstruction when that is enough.
+static void dixon_rationals(vector_t* x, const uint64_t* digits, uint64_t p, size_t k, size_t nbits, size_t dbits)
+{
+    size_t   n = x->n;
+    bignum_t m = BIGNUM_INIT, u = BIGNUM_INIT, v = BIGNUM_INIT, h = BIGNUM_INIT;
+    bignum_t lcm = BIGNUM_INIT, num = BIGNUM_INIT, den = BIGNUM_INIT;
+    bool     negative;
+
+    bignum_set_u64(&m, 1);
+    for (size_t i = 0; i < k; i++) {
+        bignum_mul_u64(&m, &m, p);
+    }
+
+    bignum_set_u64(&lcm, 1);
+
+    for (size_t j = 0; j < n; j++) {
+        bignum_set_u64(&u, 0);
+        for (size_t i = k; i-- > 0;) {
+            bignum_mul_u64(&u, &u, p);
+            bignum_add_u64(&u, &u, digits[i * n + j]);
+        }
+
+        // v = lcm . x(j) mod m, in the symmetric range
+        bignum_mul(&v, &u, &lcm);
+        bignum_divmod(NULL, &v, &v, &m);
+        bignum_add(&h, &v, &v);
+
+        negative = bignum_cmp(&h, &m) > 0;
+        if (negative) {
+            bignum_sub(&h, &m, &v);
+        } else {
+            bignum_copy(&h, &v);
+        }
+
+        if (bignum_bits(&h) <= nbits) {
+            bignum_copy(&den, &lcm);
+            scalar_set_bignum(&x->items[j], &h, &den, negative);
+        } else {
+            dixon_reconstruct(&num, &den, &negative, &v, &m, nbits, dbits);
+            bignum_mul(&lcm, &lcm, &den);
+            bignum_copy(&den, &lcm);
+            scalar_set_bignum(&x->items[j], &num, &den, negative);
+        }
+    }
+
+    bignum_clear(&den);
+    bignum_clear(&num);
+    bignum_clear(&lcm);
+    bignum_clear(&h);
+    bignum_clear(&v);
+    bignum_clear(&u);
+    bignum_clear(&m);
+}
+
+static vector_t* dixon_solve(dixon_t* d, const matrix_t* a)
+{
+    size_t n = d->n;
+
+    // Any prime that doesn't divide det(B) will do
+    uint64_t p     = DIXON_PRIME_TOP - 1;
+    size_t   tries = 0;
+
+    while (!modp_is_prime(p) || !dixon_factorize(d, p)) {
+        if (modp_is_prime(p) && ++tries == DIXON_PRIME_TRIES && !matrix_is_inversible(a)) {
+            ERROR_MESSAGE("singular matrix");
+        }
+        p -= 2;
+    }
+
+    // |x(j)| = |det(B(j))| / |det(B)|, B(j) being B with c in column j:
+    // p^k > 2 N D makes the reconstruction unique. The bounds are rounded
+    // up by a few bits for the sums in floating point.
+    size_t nbits = (size_t)ceil(dixon_bound(d, true)) + 2;
+    size_t dbits = (size_t)ceil(dixon_bound(d, false)) + 2;
+    size_t k     = (size_t)ceil((nbits + dbits + 1) / log2((double)p));
+
+    uint64_t* digits = malloc(k * n * sizeof(uint64_t) + 1);
+    int128_t* r      = malloc(n * sizeof(int128_t) + 1);
+    CHECK_NOT_NULL(digits);
+    CHECK_NOT_NULL(r);
+
+    for (size_t i = 0; i < n; i++) {
+        r[i] = d->c[i];
+    }
+
+    // r(i+1) = (r(i) - B.y(i)) / p with y(i) = B^-1.r(i) mod p, so that
+    // B.(y(0) + y(1) p + ... + y(i) p^i) = c mod p^(i+1). Every residual
+    // stays below n max|B| + max|c| in magnitude.
+    for (size_t s = 0; s < k; s++) {
+        uint64_t* y = &digits[s * n];
+
+        dixon_digits(d, r, y);
+
+        for (size_t i = 0; i < n; i++) {
+            const int64_t* bi  = &d->B[i * n];
+            int128_t       sum = 0;
+
+            for (size_t j = 0; j < n; j++) {
+                sum += (int128_t)bi[j] * (int64_t)y[j];
+            }
+
+            r[i] = (r[i] - sum) / (int128_t)p;
+        }
+    }
+
+    vector_t* x = vector_new(n);
+    dixon_rationals(x, digits, p, k, nbits, dbits);
+    vector_refresh_integer(x);
+
+    free(r);
+    free(digits);
+
+    return x;
+}
+
+vector_t* matrix_solve_exact(const matrix_t* a, const vector_t* b)
+{
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+
+    if (a->m != a->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    size_t n = a->n;
+
+    if (b->n != n) {
+        ERROR("dimension mismatch (system is %zu x %zu, right-hand side has %zu rows)", n, n, b->n);
+    }
+
+    dixon_t d = { .n = n };
+
+    d.B    = malloc(n * n * sizeof(int64_t) + 1);
+    d.c    = malloc(n * sizeof(int64_t) + 1);
+    d.LU   = malloc(n * n * sizeof(uint64_t) + 1);
+    d.perm = malloc(n * sizeof(size_t) + 1);
+    d.inv  = malloc(n * sizeof(uint64_t) + 1);
+    CHECK_NOT_NULL(d.B);
+    CHECK_NOT_NULL(d.c);
+    CHECK_NOT_NULL(d.LU);
+    CHECK_NOT_NULL(d.perm);
+    CHECK_NOT_NULL(d.inv);
+
+    vector_t* x;
+
+    if (dixon_integer(&d, a, b)) {
+        x = dixon_solve(&d, a);
+    } else {
+        lu_t* lu = lu_new(a);
+        x        = lu_solve(lu, b);
+        lu_delete(lu);
+    }
+
+    free(d.inv);
+    free(d.perm);
+    free(d.LU);
+    free(d.c);
+    free(d.B);
+
+    return x;
+}
@@ -0,0 +1,18 @@
+#ifndef TD_DIXON_H
+#define TD_DIXON_H
+
+#include "matrix.h"
+#include "vector.h"
+
+// Exact solution of A.x = b by Dixon's p-adic lifting: A is factorized once
+// modulo a word-sized prime p, then every step solves for one more base-p
+// digit of x with that factorization and a matrix-vector product on words,
+// and x is read back from its p-adic expansion by rational reconstruction.
+// The cost grows like n^3 in the size of the output, where elimination on
+// rationals pays for the growth of every intermediate entry.
+//
+// Systems whose row-scaled entries don't fit 64 bits are solved by LU
+// factorization instead. A must be square and regular.
+vector_t* matrix_solve_exact(const matrix_t* a, const vector_t* b);
+
+#endif /* dixon.h */
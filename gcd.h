@@ -0,0 +1,76 @@
+#ifndef TD_GCD_H
+#define TD_GCD_H
+
+#include <stdint.h>
+
+static inline uint64_t uint64_gcd_euclid(uint64_t a, uint64_t b)
+{
+    uint64_t r;
+
+    while (b != 0) {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return a;
+}
+
+// Stein's algorithm: strip the common power of two once, then only
+// subtract and shift, with the shifts given by count-trailing-zeros. No
+// 64-bit division is ever issued.
+static inline uint64_t uint64_gcd_binary(uint64_t a, uint64_t b)
+{
+    if (a == 0 || b == 0) {
+        return a | b;
+    }
+
+    if (a == 1 || b == 1) {
+        return 1;
+    }
+
+    // gcd(a, 2^k) is the lowest bit set in either of them
+    if ((a & (a - 1)) == 0 || (b & (b - 1)) == 0) {
+        return (a | b) & -(a | b);
+    }
+
+    int shift = __builtin_ctzll(a | b);
+
+    a >>= __builtin_ctzll(a);
+    b >>= __builtin_ctzll(b);
+
+    // Both odd: |a - b| is even and gcd(a, b) = gcd(min(a, b), |a - b|). The
+    // min and the difference compile to conditional moves, which keeps the
+    // loop free of hard-to-predict branches.
+    while (a != b) {
+        uint64_t d = a > b ? a - b : b - a;
+
+        a = a < b ? a : b;
+        b = d >> __builtin_ctzll(d);
+    }
+
+    return a << shift;
+}
+
+static inline unsigned __int128 uint128_gcd(unsigned __int128 a, unsigned __int128 b)
+{
+    unsigned __int128 r;
+
+    while (b != 0) {
+        r = a % b;
+        a = b;
+        b = r;
+    }
+
+    return a;
+}
+
+// The binary engine is used wherever count-trailing-zeros is available,
+// defining GCD_EUCLID forces the division-based loop
+#if defined(__GNUC__) && !defined(GCD_EUCLID)
+#define uint64_gcd uint64_gcd_binary
+#else
+#define uint64_gcd uint64_gcd_euclid
+#endif
+
+#endif /* gcd.h */
@@ -0,0 +1,148 @@
+#ifndef TD_INTEGER_H
+#define TD_INTEGER_H
+
+#include "scalar.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Kernels over arrays of scalars that are all inline integers, i.e. whose
+// den is 1: the arithmetic reduces to plain int64 operations on num, with
+// no gcd and no branch in the loops, so the compiler can vectorize them.
+// They back the integer fast paths of vectors and matrices.
+
+// Whether every item is an inline integer. Promoted scalars have den 0.
+static inline bool integer_all(const scalar_t* items, size_t n)
+{
+    uint64_t other = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        other |= items[i].den ^ 1;
+    }
+
+    return other == 0;
+}
+
+static inline size_t integer_length(uint64_t x)
+{
+    return x == 0 ? 0 : 64 - __builtin_clzll(x);
+}
+
+// The integer_num_* kernels run on bare numerators, stride int64 apart: 1
+// for the arrays of the common-denominator vectors and matrices, and
+// INTEGER_STRIDE for the num fields of an array of scalars. Being inlined
+// with a constant stride, they compile to the loops a dedicated version
+// would have.
+#define INTEGER_STRIDE (sizeof(scalar_t) / sizeof(int64_t))
+
+// The bit length of the largest magnitude. Or-ing the magnitudes gives the
+// same length as taking their maximum, without a branch.
+static inline size_t integer_num_bits(const int64_t* num, size_t n, size_t stride)
+{
+    uint64_t bits = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        int64_t x = num[i * stride];
+        bits |= x < 0 ? -(uint64_t)x : (uint64_t)x;
+    }
+
+    return integer_length(bits);
+}
+
+// x = x + y, or x - y if sub is set. The sums wrap and overflow is tested
+// once at the end; if it was hit, x is restored and false returned.
+static inline bool integer_num_add(int64_t* x, const int64_t* y, size_t n, size_t stride, bool sub)
+{
+    // The restore below needs y intact
+    if (x == y) {
+        if (!sub && integer_num_bits(x, n, stride) > 62) {
+            return false;
+        }
+
+        for (size_t i = 0; i < n; i++) {
+            x[i * stride] = sub ? 0 : 2 * x[i * stride];
+        }
+
+        return true;
+    }
+
+    uint64_t bad = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t a = x[i * stride];
+        uint64_t b = sub ? -(uint64_t)y[i * stride] : (uint64_t)y[i * stride];
+        uint64_t s = a + b;
+
+        // The sign of the sum differs from both operands' on overflow, and
+        // INT64_MIN is out of range as well
+        bad |= ((a ^ s) & (b ^ s)) | ((uint64_t)(s == (uint64_t)INT64_MIN) << 63);
+        x[i * stride] = s;
+    }
+
+    if (bad >> 63 == 0) {
+        return true;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        uint64_t b    = sub ? -(uint64_t)y[i * stride] : (uint64_t)y[i * stride];
+        x[i * stride] = (uint64_t)x[i * stride] - b;
+    }
+
+    return false;
+}
+
+// The sum of x[i] . y[i], in 64 bits when the bit lengths of the largest
+// entries and of n show that it can't overflow, in 128 bits otherwise.
+// Returns false if even that overflows.
+static inline bool integer_num_dot(const int64_t* x, const int64_t* y, size_t n, size_t stride, int128_t* result)
+{
+    if (integer_num_bits(x, n, stride) + integer_num_bits(y, n, stride) + integer_length(n) <= 63) {
+        int64_t sum = 0;
+
+        for (size_t i = 0; i < n; i++) {
+            sum += x[i * stride] * y[i * stride];
+        }
+
+        *result = sum;
+        return true;
+    }
+
+    int128_t sum = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        if (__builtin_add_overflow(sum, (int128_t)x[i * stride] * y[i * stride], &sum)) {
+            return false;
+        }
+    }
+
+    *result = sum;
+    return true;
+}
+
+// The same on the numerators of arrays of scalars
+
+static inline size_t integer_bits(const scalar_t* items, size_t n)
+{
+    return integer_num_bits(&items->num, n, INTEGER_STRIDE);
+}
+
+static inline bool integer_add(scalar_t* x, const scalar_t* y, size_t n, bool sub)
+{
+    return integer_num_add(&x->num, &y->num, n, INTEGER_STRIDE, sub);
+}
+
+static inline bool integer_dot(const scalar_t* x, const scalar_t* y, size_t n, int128_t* result)
+{
+    return integer_num_dot(&x->num, &y->num, n, INTEGER_STRIDE, result);
+}
+
+// x = k . x, the caller has checked that the products fit
+static inline void integer_scale(scalar_t* x, size_t n, int64_t k)
+{
+    for (size_t i = 0; i < n; i++) {
+        x[i].num *= k;
+    }
+}
+
+#endif /* integer.h */
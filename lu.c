@@ -0,0 +1,612 @@
+#include "lu.h"
+#include "pool.h"
+#include "utils.h"
+#include <stdlib.h>
+
+// Compares |x| and |y| exactly, cross-multiplying in 128 bits
+static bool scalar_abs_greater(scalar_t* x, scalar_t* y)
+{
+    if (scalar_is_big(x) || scalar_is_big(y)) {
+        return scalar_compare_abs(x, y) > 0;
+    }
+
+    uint64_t xa = x->num < 0 ? -(uint64_t)x->num : (uint64_t)x->num;
+    uint64_t ya = y->num < 0 ? -(uint64_t)y->num : (uint64_t)y->num;
+
+    return (uint128_t)xa * y->den > (uint128_t)ya * x->den;
+}
+
+// Swaps rows i and r over the columns [j0, j1)
+static void lu_swap_rows(matrix_t* matrix, size_t i, size_t r, size_t j0, size_t j1)
+{
+    scalar_t* ri = matrix_row_ptr(matrix, i);
+    scalar_t* rr = matrix_row_ptr(matrix, r);
+
+    for (size_t j = j0; j < j1; j++) {
+        scalar_t tmp = ri[j];
+        ri[j]        = rr[j];
+        rr[j]        = tmp;
+    }
+}
+
+// Factorizes the square matrix in place into P.A = L.U, with partial
+// pivoting on the largest magnitude of each column. L and U are packed in
+// matrix, and P is stored as the permutation vector perm. Returns false if
+// the matrix is singular; the factorization is still valid, U just has a
+// zero pivot and the corresponding column of L is zero.
+//
+// The factors are built in Crout order: step k computes column k of the
+// trailing block and row k of U, each entry as its original value minus a
+// single dot product of what L and U already hold. Every entry goes through
+// one accumulator and one normalization, where eliminating row by row would
+// normalize it once per step. Pivots and results are the same.
+bool lu_factorize(matrix_t* matrix, size_t* perm, bool* odd)
+{
+    CHECK_NOT_NULL(matrix);
+    CHECK_NOT_NULL(perm);
+
+    if (matrix->m != matrix->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    size_t n       = matrix->n;
+    bool   regular = true;
+
+    scalar_t     inv = zero;
+    scalar_acc_t acc = SCALAR_ACC_INIT;
+
+    *odd = false;
+    for (size_t i = 0; i < n; i++) {
+        perm[i] = i;
+    }
+
+    for (size_t k = 0; k < n; k++) {
+        // a(i, k) -= sum l(i, p) . u(p, k) for p < k, on and below the diagonal
+        for (size_t i = k; i < n; i++) {
+            scalar_t* ri = matrix_row_ptr(matrix, i);
+
+            scalar_acc_add(&acc, &ri[k]);
+            for (size_t p = 0; p < k; p++) {
+                if (ri[p].num != 0) {
+                    scalar_acc_sub_mul(&acc, &ri[p], &matrix_at(matrix, p, k));
+                }
+            }
+
+            scalar_acc_get(&ri[k], &acc);
+            scalar_acc_clear(&acc);
+        }
+
+        size_t p = k;
+
+        for (size_t i = k + 1; i < n; i++) {
+            if (scalar_abs_greater(&matrix_at(matrix, i, k), &matrix_at(matrix, p, k))) {
+                p = i;
+            }
+        }
+
+        if (p != k) {
+            lu_swap_rows(matrix, k, p, 0, n);
+
+            size_t tmp_index = perm[k];
+            perm[k]          = perm[p];
+            perm[p]          = tmp_index;
+
+            *odd = !*odd;
+        }
+
+        // u(k, j) = a(k, j) - sum l(k, p) . u(p, j) for p < k, right of the
+        // diagonal
+        scalar_t* rk = matrix_row_ptr(matrix, k);
+
+        for (size_t j = k + 1; j < n; j++) {
+            scalar_acc_add(&acc, &rk[j]);
+            for (size_t p = 0; p < k; p++) {
+                if (rk[p].num != 0) {
+                    scalar_acc_sub_mul(&acc, &rk[p], &matrix_at(matrix, p, j));
+                }
+            }
+
+            scalar_acc_get(&rk[j], &acc);
+            scalar_acc_clear(&acc);
+        }
+
+        // A zero pivot leaves a zero column of L
+        if (rk[k].num == 0) {
+            regular = false;
+            continue;
+        }
+
+        // l(i, k) = a(i, k) / u(k, k)
+        scalar_inverse(&inv, &rk[k]);
+
+        for (size_t i = k + 1; i < n; i++) {
+            scalar_t* ri = matrix_row_ptr(matrix, i);
+
+            if (ri[k].num != 0) {
+                scalar_mul(&ri[k], &ri[k], &inv);
+            }
+        }
+    }
+
+    scalar_clear(&inv);
+
+    return regular;
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+// The width of the panels of the tiled factorization, 0 to always use the
+// Crout one
+static size_t lu_tile = 32;
+
+void lu_set_tile(size_t n)
+{
+    __atomic_store_n(&lu_tile, n, __ATOMIC_RELAXED);
+}
+
+// lu_new goes tiled from this size on, when the pool has several threads.
+// Below, the Crout factorization runs faster on a single core anyway.
+#define LU_TILED_MIN 128
+
+typedef struct lu_tiled {
+    matrix_t* a;
+    size_t*   perm;
+
+    // pivot[c] is the row swapped with row c at step c
+    size_t* pivot;
+
+    size_t n;
+    size_t nb;
+    size_t tiles;
+
+    // Written by the panels only, which run one after the other
+    bool odd;
+    bool regular;
+} lu_tiled_t;
+
+#define lu_tile_start(job, k) ((k) * (job)->nb)
+#define lu_tile_end(job, k)   ((k) + 1 < (job)->tiles ? ((k) + 1) * (job)->nb : (job)->n)
+
+// Factorizes the columns [c0, c1) of panel k, rows c0 and below, once every
+// earlier step has been applied to them. This is lu_factorize on the panel:
+// the dot products only run over the columns of the panel, the earlier ones
+// have been eliminated by the trailing updates. Rows are swapped within the
+// panel, the other columns catch up later.
+static void lu_panel_task(void* arg, size_t k)
+{
+    lu_tiled_t* job = arg;
+    matrix_t*   a   = job->a;
+    size_t      n   = job->n;
+    size_t      c0  = lu_tile_start(job, k);
+    size_t      c1  = lu_tile_end(job, k);
+
+    scalar_t     inv = zero;
+    scalar_acc_t acc = SCALAR_ACC_INIT;
+
+    for (size_t c = c0; c < c1; c++) {
+        for (size_t i = c; i < n; i++) {
+            scalar_t* ri = matrix_row_ptr(a, i);
+
+            scalar_acc_add(&acc, &ri[c]);
+            for (size_t p = c0; p < c; p++) {
+                if (ri[p].num != 0) {
+                    scalar_acc_sub_mul(&acc, &ri[p], &matrix_at(a, p, c));
+                }
+            }
+
+            scalar_acc_get(&ri[c], &acc);
+            scalar_acc_clear(&acc);
+        }
+
+        size_t p = c;
+
+        for (size_t i = c + 1; i < n; i++) {
+            if (scalar_abs_greater(&matrix_at(a, i, c), &matrix_at(a, p, c))) {
+                p = i;
+            }
+        }
+
+        job->pivot[c] = p;
+
+        if (p != c) {
+            lu_swap_rows(a, c, p, c0, c1);
+
+            size_t tmp_index = job->perm[c];
+            job->perm[c]     = job->perm[p];
+            job->perm[p]     = tmp_index;
+
+            job->odd = !job->odd;
+        }
+
+        scalar_t* rc = matrix_row_ptr(a, c);
+
+        for (size_t j = c + 1; j < c1; j++) {
+            scalar_acc_add(&acc, &rc[j]);
+            for (size_t p = c0; p < c; p++) {
+                if (rc[p].num != 0) {
+                    scalar_acc_sub_mul(&acc, &rc[p], &matrix_at(a, p, j));
+                }
+            }
+
+            scalar_acc_get(&rc[j], &acc);
+            scalar_acc_clear(&acc);
+        }
+
+        if (rc[c].num == 0) {
+            job->regular = false;
+            continue;
+        }
+
+        scalar_inverse(&inv, &rc[c]);
+
+        for (size_t i = c + 1; i < n; i++) {
+            scalar_t* ri = matrix_row_ptr(a, i);
+
+            if (ri[c].num != 0) {
+                scalar_mul(&ri[c], &ri[c], &inv);
+            }
+        }
+    }
+
+    scalar_clear(&inv);
+}
+
+// Applies the row swaps of panel k to the block column j, then solves
+// L11.U12 = A12 for the rows of the panel: U12 is the block (k, j) of U
+static void lu_row_task(void* arg, size_t index)
+{
+    lu_tiled_t* job = arg;
+    matrix_t*   a   = job->a;
+    size_t      k   = index / job->tiles;
+    size_t      c0  = lu_tile_start(job, k);
+    size_t      c1  = lu_tile_end(job, k);
+    size_t      j0  = lu_tile_start(job, index % job->tiles);
+    size_t      j1  = lu_tile_end(job, index % job->tiles);
+
+    scalar_acc_t acc = SCALAR_ACC_INIT;
+
+    for (size_t c = c0; c < c1; c++) {
+        if (job->pivot[c] != c) {
+            lu_swap_rows(a, c, job->pivot[c], j0, j1);
+        }
+    }
+
+    for (size_t r = c0 + 1; r < c1; r++) {
+        scalar_t* rr = matrix_row_ptr(a, r);
+
+        for (size_t j = j0; j < j1; j++) {
+            scalar_acc_add(&acc, &rr[j]);
+            for (size_t p = c0; p < r; p++) {
+                if (rr[p].num != 0) {
+                    scalar_acc_sub_mul(&acc, &rr[p], &matrix_at(a, p, j));
+                }
+            }
+
+            scalar_acc_get(&rr[j], &acc);
+            scalar_acc_clear(&acc);
+        }
+    }
+}
+
+// A22 -= L21.U12 on the tile (i, j), for the step of panel k
+static void lu_update_task(void* arg, size_t index)
+{
+    lu_tiled_t* job = arg;
+    matrix_t*   a   = job->a;
+    size_t      k   = index / (job->tiles * job->tiles);
+    size_t      i   = index / job->tiles % job->tiles;
+    size_t      c0  = lu_tile_start(job, k);
+    size_t      c1  = lu_tile_end(job, k);
+    size_t      j0  = lu_tile_start(job, index % job->tiles);
+    size_t      j1  = lu_tile_end(job, index % job->tiles);
+
+    scalar_acc_t acc = SCALAR_ACC_INIT;
+
+    for (size_t r = lu_tile_start(job, i); r < lu_tile_end(job, i); r++) {
+        scalar_t* rr = matrix_row_ptr(a, r);
+
+        for (size_t j = j0; j < j1; j++) {
+            scalar_acc_add(&acc, &rr[j]);
+            for (size_t p = c0; p < c1; p++) {
+                if (rr[p].num != 0) {
+                    scalar_acc_sub_mul(&acc, &rr[p], &matrix_at(a, p, j));
+                }
+            }
+
+            scalar_acc_get(&rr[j], &acc);
+            scalar_acc_clear(&acc);
+        }
+    }
+}
+
+// Same contract and same factors as lu_factorize, computed by a blocked
+// right-looking elimination whose steps are tasks of a graph run on the
+// pool. Step k factorizes panel k, then for every block column j on its
+// right swaps its rows and solves for the block (k, j) of U, and updates
+// every tile (i, j) below. A panel only waits for the updates of its own
+// columns, so it starts while the rest of the trailing matrix is still
+// being updated (lookahead); the tasks on that path go first.
+//
+// Every entry is normalized once per step instead of once in all, which
+// the threads have to make up for.
+bool lu_factorize_tiled(matrix_t* matrix, size_t* perm, bool* odd)
+{
+    CHECK_NOT_NULL(matrix);
+    CHECK_NOT_NULL(perm);
+
+    if (matrix->m != matrix->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    size_t nb = __atomic_load_n(&lu_tile, __ATOMIC_RELAXED);
+
+    if (nb == 0 || nb >= matrix->n) {
+        return lu_factorize(matrix, perm, odd);
+    }
+
+    size_t n     = matrix->n;
+    size_t tiles = (n + nb - 1) / nb;
+
+    lu_tiled_t job = {
+        .a       = matrix,
+        .perm    = perm,
+        .pivot   = malloc(n * sizeof(size_t)),
+        .n       = n,
+        .nb      = nb,
+        .tiles   = tiles,
+        .odd     = false,
+        .regular = true,
+    };
+    CHECK_NOT_NULL(job.pivot);
+
+    for (size_t i = 0; i < n; i++) {
+        perm[i] = i;
+    }
+
+    // The update tasks of the previous step and of the current one, by tile
+    size_t* last = malloc(tiles * tiles * sizeof(size_t));
+    size_t* next = malloc(tiles * tiles * sizeof(size_t));
+    CHECK_NOT_NULL(last);
+    CHECK_NOT_NULL(next);
+
+    pool_graph_t* graph = pool_graph_new();
+
+    for (size_t k = 0; k < tiles; k++) {
+        // Panels and the blocks of the next panel are the critical path
+        size_t panel = pool_graph_add(graph, lu_panel_task, &job, k, k);
+
+        for (size_t i = k; k > 0 && i < tiles; i++) {
+            pool_graph_depend(graph, panel, last[i * tiles + k]);
+        }
+
+        for (size_t j = k + 1; j < tiles; j++) {
+            size_t priority = j == k + 1 ? k : tiles + k;
+            size_t row      = pool_graph_add(graph, lu_row_task, &job, k * tiles + j, priority);
+
+            pool_graph_depend(graph, row, panel);
+
+            // The swaps touch the rows of the panel and below
+            for (size_t i = k; k > 0 && i < tiles; i++) {
+                pool_graph_depend(graph, row, last[i * tiles + j]);
+            }
+
+            for (size_t i = k + 1; i < tiles; i++) {
+                next[i * tiles + j] = pool_graph_add(graph, lu_update_task, &job, (k * tiles + i) * tiles + j, priority);
+                pool_graph_depend(graph, next[i * tiles + j], row);
+            }
+        }
+
+        size_t* tmp = last;
+        last        = next;
+        next        = tmp;
+    }
+
+    pool_graph_run(graph);
+
+    // The columns left of each panel get its swaps last, in order: until
+    // then the updates read L as it was when its panel was factorized
+    for (size_t c = 0; c < n; c++) {
+        if (job.pivot[c] != c) {
+            lu_swap_rows(matrix, c, job.pivot[c], 0, c / nb * nb);
+        }
+    }
+
+    pool_graph_delete(graph);
+    free(next);
+    free(last);
+    free(job.pivot);
+
+    *odd = job.odd;
+    return job.regular;
+}
+
+lu_t* lu_new(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    if (matrix->m != matrix->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    size_t n = matrix->n;
+
+    // The permutation shares the factorization's allocation
+    lu_t* lu = malloc(sizeof(*lu) + n * sizeof(size_t));
+    CHECK_NOT_NULL(lu);
+
+    lu->LU   = matrix_square(n);
+    lu->perm = (size_t*)(lu + 1);
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            scalar_copy(&matrix_at(lu->LU, i, j), &matrix_at(matrix, i, j));
+        }
+    }
+
+    // Both give the same factors
+    if (n >= LU_TILED_MIN && __atomic_load_n(&lu_tile, __ATOMIC_RELAXED) > 0 && pool_threads() > 1) {
+        lu->singular = !lu_factorize_tiled(lu->LU, lu->perm, &lu->odd);
+    } else {
+        lu->singular = !lu_factorize(lu->LU, lu->perm, &lu->odd);
+    }
+    matrix_refresh_integer(lu->LU);
+
+    return lu;
+}
+
+// Right-hand sides are swept this many columns at a time, so that the rows
+// of the block being substituted stay in cache while L and U stream by
+#define LU_SOLVE_BLOCK 32
+
+// Solves L.U.X = P.B for the columns [j0, j1) of B into X, by forward then
+// back substitution. inv holds the inverses of the diagonal of U. Each
+// entry of X is one dot product, accumulated across the whole row of L or
+// U before it is normalized.
+static void lu_solve_block(const lu_t* lu, const scalar_t* inv, matrix_t* x, const matrix_t* b, size_t j0, size_t j1)
+{
+    size_t       n = lu->LU->n;
+    scalar_acc_t acc[LU_SOLVE_BLOCK];
+
+    // L.Y = P.B, Y is built in X
+    for (size_t i = 0; i < n; i++) {
+        scalar_t*       xi = matrix_row_ptr(x, i);
+        const scalar_t* bi = matrix_row_ptr(b, lu->perm[i]);
+        const scalar_t* li = matrix_row_ptr(lu->LU, i);
+
+        for (size_t j = j0; j < j1; j++) {
+            acc[j - j0] = (scalar_acc_t)SCALAR_ACC_INIT;
+            scalar_acc_add(&acc[j - j0], &bi[j]);
+        }
+
+        for (size_t k = 0; k < i; k++) {
+            if (li[k].num == 0) {
+                continue;
+            }
+
+            scalar_t* xk = matrix_row_ptr(x, k);
+            for (size_t j = j0; j < j1; j++) {
+                scalar_acc_sub_mul(&acc[j - j0], &li[k], &xk[j]);
+            }
+        }
+
+        for (size_t j = j0; j < j1; j++) {
+            scalar_acc_get(&xi[j], &acc[j - j0]);
+            scalar_acc_clear(&acc[j - j0]);
+        }
+    }
+
+    // U.X = Y
+    for (size_t i = n; i-- > 0;) {
+        scalar_t*       xi = matrix_row_ptr(x, i);
+        const scalar_t* ui = matrix_row_ptr(lu->LU, i);
+
+        for (size_t j = j0; j < j1; j++) {
+            acc[j - j0] = (scalar_acc_t)SCALAR_ACC_INIT;
+            scalar_acc_add(&acc[j - j0], &xi[j]);
+        }
+
+        for (size_t k = i + 1; k < n; k++) {
+            if (ui[k].num == 0) {
+                continue;
+            }
+
+            scalar_t* xk = matrix_row_ptr(x, k);
+            for (size_t j = j0; j < j1; j++) {
+                scalar_acc_sub_mul(&acc[j - j0], &ui[k], &xk[j]);
+            }
+        }
+
+        for (size_t j = j0; j < j1; j++) {
+            scalar_acc_get(&xi[j], &acc[j - j0]);
+            scalar_acc_clear(&acc[j - j0]);
+            scalar_mul(&xi[j], &xi[j], &inv[i]);
+        }
+    }
+}
+
+static void lu_solve_into(const lu_t* lu, matrix_t* x, const matrix_t* b)
+{
+    if (lu->singular) {
+        ERROR_MESSAGE("singular matrix");
+    }
+
+    size_t n = lu->LU->n;
+
+    if (b->m != n) {
+        ERROR("dimension mismatch (system is %zu x %zu, right-hand side has %zu rows)", n, n, b->m);
+    }
+
+    scalar_t* inv = malloc(n * sizeof(scalar_t));
+    CHECK_NOT_NULL(inv);
+
+    for (size_t i = 0; i < n; i++) {
+        inv[i] = zero;
+        scalar_inverse(&inv[i], &matrix_at(lu->LU, i, i));
+    }
+
+    for (size_t j0 = 0; j0 < b->n; j0 += LU_SOLVE_BLOCK) {
+        size_t j1 = j0 + LU_SOLVE_BLOCK < b->n ? j0 + LU_SOLVE_BLOCK : b->n;
+        lu_solve_block(lu, inv, x, b, j0, j1);
+    }
+
+    scalar_clear_all(inv, n);
+    free(inv);
+}
+
+vector_t* lu_solve(const lu_t* lu, const vector_t* b)
+{
+    CHECK_NOT_NULL(lu);
+    CHECK_NOT_NULL(b);
+
+    vector_t* x = vector_new(b->n);
+
+    // Both vectors seen as single-column matrices, b may be a view
+    matrix_t xm = { .m = x->n, .n = 1, .ld = 1, .data = x->items };
+    matrix_t bm = { .m = b->n, .n = 1, .ld = b->stride, .data = b->items };
+
+    lu_solve_into(lu, &xm, &bm);
+    vector_refresh_integer(x);
+
+    return x;
+}
+
+matrix_t* lu_solve_many(const lu_t* lu, const matrix_t* b)
+{
+    CHECK_NOT_NULL(lu);
+    CHECK_NOT_NULL(b);
+
+    matrix_t* x = matrix_new(b->m, b->n);
+    lu_solve_into(lu, x, b);
+    matrix_refresh_integer(x);
+
+    return x;
+}
+
+matrix_t* lu_inverse(const lu_t* lu)
+{
+    CHECK_NOT_NULL(lu);
+
+    matrix_t* eye     = matrix_eye(lu->LU->n);
+    matrix_t* inverse = lu_solve_many(lu, eye);
+    matrix_delete(eye);
+
+    return inverse;
+}
+
+scalar_t* lu_det(const lu_t* lu)
+{
+    CHECK_NOT_NULL(lu);
+
+    scalar_t* det = scalar_from(lu->odd ? -1 : 1);
+
+    if (lu->singular) {
+        scalar_copy(det, &zero);
+        return det;
+    }
+
+    for (size_t i = 0; i < lu->LU->n; i++) {
+        scalar_mul(det, det, &matrix_at(lu->LU, i, i));
+    }
+
+    return det;
+}
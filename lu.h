@@ -0,0 +1,40 @@
+#ifndef TD_LU_H
+#define TD_LU_H
+
+#include "matrix.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct lu {
+    // L and U packed in a single n x n matrix: U on and above the diagonal,
+    // L strictly below it (its unit diagonal is implied)
+    matrix_t* LU;
+
+    // Row i of LU comes from row perm[i] of the factorized matrix
+    size_t* perm;
+
+    // Whether perm is an odd permutation
+    bool odd;
+
+    // Whether some pivot column was zero, i.e. U has a zero on its diagonal
+    bool singular;
+} lu_t;
+
+#define lu_delete(lu)            \
+    if ((lu) != NULL) {          \
+        matrix_delete((lu)->LU); \
+        free(lu);                \
+        (lu) = NULL;             \
+    }
+
+bool      lu_factorize(matrix_t* matrix, size_t* perm, bool* odd);
+bool      lu_factorize_tiled(matrix_t* matrix, size_t* perm, bool* odd);
+void      lu_set_tile(size_t n);
+lu_t*     lu_new(const matrix_t* matrix);
+vector_t* lu_solve(const lu_t* lu, const vector_t* b);
+matrix_t* lu_solve_many(const lu_t* lu, const matrix_t* b);
+matrix_t* lu_inverse(const lu_t* lu);
+scalar_t* lu_det(const lu_t* lu);
+
+#endif /* lu.h */
@@ -1,26 +1,32 @@
 #include "matrix.h"
+#include "cd.h"
+#include "gcd.h"
+#include "integer.h"
+#include "lu.h"
+#include "modp.h"
+#include "pool.h"
 #include "utils.h"
 #include "vector.h"
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 matrix_t* matrix_new(size_t m, size_t n)
 {
-    matrix_t* matrix = malloc(sizeof(*matrix));
-    CHECK_NOT_NULL(matrix);
-
-    matrix->m = m;
-    matrix->n = n;
-
-    matrix->rows = malloc(m * sizeof(scalar_t*));
-    CHECK_NOT_NULL(matrix->rows);
-
-    for (size_t i = 0; i < m; i++) {
-        matrix->rows[i] = malloc(n * sizeof(scalar_t));
-        CHECK_NOT_NULL(matrix->rows[i]);
-        for (size_t j = 0; j < n; j++) {
-            scalar_copy(&matrix->rows[i][j], &zero);
-        }
+    // The header and the elements share a single block, so creating and
+    // deleting a matrix is one allocator round-trip whatever its size
+    matrix_t* matrix = alloc_new(sizeof(*matrix) + m * n * sizeof(scalar_t));
+
+    matrix->m       = m;
+    matrix->n       = n;
+    matrix->ld      = n;
+    matrix->integer = true;
+    matrix->data    = (scalar_t*)(matrix + 1);
+
+    // Raw stores: scalar_copy would read the uninitialized destination
+    for (size_t i = 0; i < m * n; i++) {
+        matrix->data[i] = zero;
     }
 
     return matrix;
@@ -36,26 +42,27 @@ matrix_t* matrix_eye(size_t n)
     matrix_t* matrix = matrix_square(n);
 
     for (size_t i = 0; i < n; i++) {
-        scalar_copy(&matrix->rows[i][i], &one);
+        scalar_copy(&matrix_at(matrix, i, i), &one);
     }
 
     return matrix;
 }
 
-matrix_t* matrix_from_diag(vector_t* diag)
+matrix_t* matrix_from_diag(const vector_t* diag)
 {
     CHECK_NOT_NULL(diag);
 
     matrix_t* matrix = matrix_square(diag->n);
 
     for (size_t i = 0; i < diag->n; i++) {
-        scalar_copy(&matrix->rows[i][i], &diag->items[i]);
+        scalar_copy(&matrix_at(matrix, i, i), &vector_at(diag, i));
     }
 
+    matrix->integer = diag->integer;
     return matrix;
 }
 
-matrix_t* matrix_from_vector(vector_t* vector, bool line)
+matrix_t* matrix_from_vector(const vector_t* vector, bool line)
 {
     CHECK_NOT_NULL(vector);
 
@@ -64,22 +71,324 @@ matrix_t* matrix_from_vector(vector_t* vector, bool line)
 
     matrix_t* matrix = matrix_new(m, n);
 
+    matrix->integer = vector->integer;
+
     if (line) {
         for (size_t i = 0; i < vector->n; i++) {
-            scalar_copy(&matrix->rows[0][i], &vector->items[i]);
+            scalar_copy(&matrix_at(matrix, 0, i), &vector_at(vector, i));
         }
 
         return matrix;
     }
 
     for (size_t i = 0; i < vector->n; i++) {
-        scalar_copy(&matrix->rows[i][0], &vector->items[i]);
+        scalar_copy(&matrix_at(matrix, i, 0), &vector_at(vector, i));
     }
 
     return matrix;
 }
 
-matrix_t* matrix_prod(matrix_t* a, matrix_t* b)
+// Side of the square output tiles of the product kernel. A row of a tile
+// keeps 32 accumulators, 1.5 KiB, and the 32-wide strip of B it reads is
+// shared by every row of the tile.
+#define MATRIX_PROD_BLOCK 32
+
+// Accumulates A[i0:i1, :] x B[:, j0:j1] into C[i0:i1, j0:j1], reading A and
+// B in place. The i-k-j order walks B and C along their rows. Every cell of
+// the row being built has its own accumulator, so each one is normalized
+// once however long the inner dimension is, and the column strip of B is
+// reused from cache by every row of the tile.
+static void matrix_prod_tile(matrix_t* c, const matrix_t* a, const matrix_t* b, size_t i0, size_t i1, size_t j0, size_t j1)
+{
+    scalar_acc_t acc[MATRIX_PROD_BLOCK];
+
+    for (size_t i = i0; i < i1; i++) {
+        scalar_t*       ci = matrix_row_ptr(c, i);
+        const scalar_t* ai = matrix_row_ptr(a, i);
+
+        for (size_t j = j0; j < j1; j++) {
+            acc[j - j0] = (scalar_acc_t)SCALAR_ACC_INIT;
+            scalar_acc_add(&acc[j - j0], &ci[j]);
+        }
+
+        for (size_t k = 0; k < a->n; k++) {
+            const scalar_t* aik = &ai[k];
+
+            if (aik->num == 0) {
+                continue;
+            }
+
+            const scalar_t* bk = matrix_row_ptr(b, k);
+            for (size_t j = j0; j < j1; j++) {
+                scalar_acc_add_mul(&acc[j - j0], aik, &bk[j]);
+            }
+        }
+
+        for (size_t j = j0; j < j1; j++) {
+            scalar_acc_get(&ci[j], &acc[j - j0]);
+            scalar_acc_clear(&acc[j - j0]);
+        }
+    }
+}
+
+// Below this many scalar multiply-adds a product runs on the calling thread,
+// dealing tiles to the pool would cost more than it saves
+#define MATRIX_PROD_PARALLEL_MIN (64 * 64 * 64)
+
+typedef struct matrix_prod_job {
+    matrix_t*       c;
+    const matrix_t *a, *b;
+
+    // The number of tiles along the columns of C
+    size_t tiles_n;
+} matrix_prod_job_t;
+
+static void matrix_prod_task(void* arg, size_t index)
+{
+    matrix_prod_job_t* job = arg;
+
+    size_t i0 = (index / job->tiles_n) * MATRIX_PROD_BLOCK;
+    size_t j0 = (index % job->tiles_n) * MATRIX_PROD_BLOCK;
+    size_t i1 = i0 + MATRIX_PROD_BLOCK < job->c->m ? i0 + MATRIX_PROD_BLOCK : job->c->m;
+    size_t j1 = j0 + MATRIX_PROD_BLOCK < job->c->n ? j0 + MATRIX_PROD_BLOCK : job->c->n;
+
+    matrix_prod_tile(job->c, job->a, job->b, i0, i1, j0, j1);
+}
+
+// C += A x B with the classical tiled kernel. Output tiles are disjoint, so
+// they can be computed in any order and on any thread.
+static void matrix_prod_into(matrix_t* c, const matrix_t* a, const matrix_t* b)
+{
+    matrix_prod_job_t job = {
+        .c       = c,
+        .a       = a,
+        .b       = b,
+        .tiles_n = (c->n + MATRIX_PROD_BLOCK - 1) / MATRIX_PROD_BLOCK,
+    };
+
+    size_t tiles = job.tiles_n * ((c->m + MATRIX_PROD_BLOCK - 1) / MATRIX_PROD_BLOCK);
+
+    if (c->m * c->n * a->n < MATRIX_PROD_PARALLEL_MIN) {
+        for (size_t t = 0; t < tiles; t++) {
+            matrix_prod_task(&job, t);
+        }
+    } else {
+        pool_run(matrix_prod_task, &job, tiles);
+    }
+}
+
+// A (m, n) window into matrix starting at (i, j). It shares the matrix
+// storage and must not be deleted.
+static matrix_t matrix_window(const matrix_t* matrix, size_t i, size_t j, size_t m, size_t n)
+{
+    return (matrix_t){ .m = m, .n = n, .ld = matrix->ld, .integer = matrix->integer, .data = &matrix_at(matrix, i, j) };
+}
+
+static void matrix_window_zero(matrix_t* c)
+{
+    for (size_t i = 0; i < c->m; i++) {
+        for (size_t j = 0; j < c->n; j++) {
+            scalar_copy(&matrix_at(c, i, j), &zero);
+        }
+    }
+}
+
+// C = A + B, C may alias A or B
+static void matrix_window_add(matrix_t* c, const matrix_t* a, const matrix_t* b)
+{
+    for (size_t i = 0; i < c->m; i++) {
+        for (size_t j = 0; j < c->n; j++) {
+            scalar_add(&matrix_at(c, i, j), &matrix_at(a, i, j), &matrix_at(b, i, j));
+        }
+    }
+}
+
+// C = A - B, C may alias A or B
+static void matrix_window_sub(matrix_t* c, const matrix_t* a, const matrix_t* b)
+{
+    for (size_t i = 0; i < c->m; i++) {
+        for (size_t j = 0; j < c->n; j++) {
+            scalar_sub(&matrix_at(c, i, j), &matrix_at(a, i, j), &matrix_at(b, i, j));
+        }
+    }
+}
+
+// Products whose three dimensions all reach the cutoff go through the
+// Strassen-Winograd recursion, which trades one product in eight for fifteen
+// additions. With cross-cancelling scalar_mul, a rational product costs
+// about as much as a sum, and the recursion measured slower than the
+// classical kernel up to n = 1024 (bench/matrix_strassen_bench.c), so it is
+// off (0) unless a cutoff is set.
+static size_t strassen_cutoff = 0;
+
+void matrix_set_strassen_cutoff(size_t n)
+{
+    __atomic_store_n(&strassen_cutoff, n, __ATOMIC_RELAXED);
+}
+
+static void matrix_winograd(matrix_t* c, const matrix_t* a, const matrix_t* b);
+
+static void matrix_winograd_task(void* arg, size_t index)
+{
+    matrix_t** args = arg;
+    matrix_winograd(args[3 * index], args[3 * index + 1], args[3 * index + 2]);
+}
+
+// C = A x B. Odd dimensions are peeled: the recursion runs on the leading
+// even-sized block and the last row, column or inner index is fixed up with
+// classical products.
+static void matrix_winograd(matrix_t* c, const matrix_t* a, const matrix_t* b)
+{
+    size_t m = a->m;
+    size_t k = a->n;
+    size_t n = b->n;
+
+    size_t cutoff = __atomic_load_n(&strassen_cutoff, __ATOMIC_RELAXED);
+
+    if (cutoff == 0 || m < cutoff || k < cutoff || n < cutoff) {
+        matrix_window_zero(c);
+        matrix_prod_into(c, a, b);
+        return;
+    }
+
+    size_t m2 = m / 2;
+    size_t k2 = k / 2;
+    size_t n2 = n / 2;
+
+    matrix_t a11 = matrix_window(a, 0, 0, m2, k2);
+    matrix_t a12 = matrix_window(a, 0, k2, m2, k2);
+    matrix_t a21 = matrix_window(a, m2, 0, m2, k2);
+    matrix_t a22 = matrix_window(a, m2, k2, m2, k2);
+
+    matrix_t b11 = matrix_window(b, 0, 0, k2, n2);
+    matrix_t b12 = matrix_window(b, 0, n2, k2, n2);
+    matrix_t b21 = matrix_window(b, k2, 0, k2, n2);
+    matrix_t b22 = matrix_window(b, k2, n2, k2, n2);
+
+    matrix_t c11 = matrix_window(c, 0, 0, m2, n2);
+    matrix_t c12 = matrix_window(c, 0, n2, m2, n2);
+    matrix_t c21 = matrix_window(c, m2, 0, m2, n2);
+    matrix_t c22 = matrix_window(c, m2, n2, m2, n2);
+
+    matrix_t* s[4];
+    matrix_t* t[4];
+    matrix_t* p[7];
+
+    for (size_t i = 0; i < 4; i++) {
+        s[i] = matrix_new(m2, k2);
+        t[i] = matrix_new(k2, n2);
+    }
+
+    for (size_t i = 0; i < 7; i++) {
+        p[i] = matrix_new(m2, n2);
+    }
+
+    matrix_window_add(s[0], &a21, &a22); // S1 = A21 + A22
+    matrix_window_sub(s[1], s[0], &a11); // S2 = S1 - A11
+    matrix_window_sub(s[2], &a11, &a21); // S3 = A11 - A21
+    matrix_window_sub(s[3], &a12, s[1]); // S4 = A12 - S2
+
+    matrix_window_sub(t[0], &b12, &b11); // T1 = B12 - B11
+    matrix_window_sub(t[1], &b22, t[0]); // T2 = B22 - T1
+    matrix_window_sub(t[2], &b22, &b12); // T3 = B22 - B12
+    matrix_window_sub(t[3], t[1], &b21); // T4 = T2 - B21
+
+    // The seven products are independent, they are the unit of parallelism
+    matrix_t* args[] = {
+        p[0], &a11, &b11, // P1 = A11 x B11
+        p[1], &a12, &b21, // P2 = A12 x B21
+        p[2], s[3], &b22, // P3 = S4 x B22
+        p[3], &a22, t[3], // P4 = A22 x T4
+        p[4], s[0], t[0], // P5 = S1 x T1
+        p[5], s[1], t[1], // P6 = S2 x T2
+        p[6], s[2], t[2], // P7 = S3 x T3
+    };
+
+    pool_run(matrix_winograd_task, args, 7);
+
+    matrix_window_add(&c11, p[0], p[1]); // C11 = P1 + P2
+    matrix_window_add(p[5], p[0], p[5]); // U2  = P1 + P6
+    matrix_window_add(p[6], p[5], p[6]); // U3  = U2 + P7
+    matrix_window_add(p[5], p[5], p[4]); // U4  = U2 + P5
+    matrix_window_add(&c12, p[5], p[2]); // C12 = U4 + P3
+    matrix_window_sub(&c21, p[6], p[3]); // C21 = U3 - P4
+    matrix_window_add(&c22, p[6], p[4]); // C22 = U3 + P5
+
+    for (size_t i = 0; i < 7; i++) {
+        matrix_delete(p[i]);
+    }
+
+    for (size_t i = 0; i < 4; i++) {
+        matrix_delete(t[i]);
+        matrix_delete(s[i]);
+    }
+
+    if (k % 2 == 1) {
+        matrix_t ce = matrix_window(c, 0, 0, 2 * m2, 2 * n2);
+        matrix_t ak = matrix_window(a, 0, k - 1, 2 * m2, 1);
+        matrix_t bk = matrix_window(b, k - 1, 0, 1, 2 * n2);
+        matrix_prod_into(&ce, &ak, &bk);
+    }
+
+    if (n % 2 == 1) {
+        matrix_t cn = matrix_window(c, 0, n - 1, 2 * m2, 1);
+        matrix_t am = matrix_window(a, 0, 0, 2 * m2, k);
+        matrix_t bn = matrix_window(b, 0, n - 1, k, 1);
+        matrix_window_zero(&cn);
+        matrix_prod_into(&cn, &am, &bn);
+    }
+
+    if (m % 2 == 1) {
+        matrix_t cm = matrix_window(c, m - 1, 0, 1, n);
+        matrix_t am = matrix_window(a, m - 1, 0, 1, k);
+        matrix_window_zero(&cm);
+        matrix_prod_into(&cm, &am, b);
+    }
+}
+
+void matrix_refresh_integer(matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    matrix->integer = true;
+
+    for (size_t i = 0; i < matrix->m && matrix->integer; i++) {
+        matrix->integer = integer_all(matrix_row_ptr(matrix, i), matrix->n);
+    }
+}
+
+// The bit length of the largest magnitude in an integer matrix
+static size_t matrix_integer_bits(const matrix_t* matrix)
+{
+    size_t bits = 0;
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        size_t row = integer_bits(matrix_row_ptr(matrix, i), matrix->n);
+        bits       = row > bits ? row : bits;
+    }
+
+    return bits;
+}
+
+// The product of two integer matrices is the denominator-1 case of the
+// common-denominator form, whose kernel runs on int64 or int128 sums. NULL
+// when an entry of the product doesn't fit 64 bits.
+static matrix_t* matrix_prod_integer(const matrix_t* a, const matrix_t* b)
+{
+    matrix_cd_t* x = matrix_cd_from(a);
+    matrix_cd_t* y = matrix_cd_from(b);
+    matrix_cd_t* z = matrix_cd_prod(x, y);
+
+    matrix_t* mat = z != NULL ? matrix_cd_to_matrix(z) : NULL;
+
+    matrix_cd_delete(z);
+    matrix_cd_delete(y);
+    matrix_cd_delete(x);
+
+    return mat;
+}
+
+matrix_t* matrix_prod(const matrix_t* a, const matrix_t* b)
 {
     CHECK_NOT_NULL(a);
     CHECK_NOT_NULL(b);
@@ -91,38 +400,46 @@ matrix_t* matrix_prod(matrix_t* a, matrix_t* b)
         ERROR("matrix dimension mismatch A is (%zu, %zu), B is (%zu, %zu)", a->m, a->n, b->m, b->n);
     }
 
-    matrix_t* mat = matrix_new(m, n);
+    if (a->integer && b->integer) {
+        matrix_t* mat = matrix_prod_integer(a, b);
 
-    scalar_t* val;
-    vector_t *col, *row;
-    for (size_t i = 0; i < m; i++) {
-        for (size_t j = 0; j < n; j++) {
-            row = matrix_row(a, i);
-            col = matrix_col(b, j);
-            val = vector_dot_prod(row, col);
-            scalar_copy(&mat->rows[i][j], val);
-            scalar_delete(val);
-            vector_delete(row);
-            vector_delete(col);
+        if (mat != NULL) {
+            return mat;
         }
     }
 
+    matrix_t* mat = matrix_new(m, n);
+    matrix_winograd(mat, a, b);
+    matrix_refresh_integer(mat);
+
     return mat;
 }
 
-void matrix_scale(matrix_t* matrix, scalar_t* scalar)
+void matrix_scale(matrix_t* matrix, const scalar_t* scalar)
 {
     CHECK_NOT_NULL(matrix);
     CHECK_NOT_NULL(scalar);
 
+    if (matrix->integer && scalar->den == 1 && matrix_integer_bits(matrix) + integer_bits(scalar, 1) <= 63) {
+        for (size_t i = 0; i < matrix->m; i++) {
+            integer_scale(matrix_row_ptr(matrix, i), matrix->n, scalar->num);
+        }
+
+        return;
+    }
+
     for (size_t i = 0; i < matrix->m; i++) {
         for (size_t j = 0; j < matrix->n; j++) {
-            scalar_mul(&matrix->rows[i][j], &matrix->rows[i][j], scalar);
+            scalar_mul(&matrix_at(matrix, i, j), &matrix_at(matrix, i, j), scalar);
         }
     }
+
+    matrix_refresh_integer(matrix);
 }
 
-void matrix_add(matrix_t* a, matrix_t* b)
+// A = A + B or A = A - B. Integer rows are added on int64 until one of them
+// overflows, the rest goes through the rational kernels.
+static void matrix_add_sub(matrix_t* a, const matrix_t* b, bool sub)
 {
     CHECK_NOT_NULL(a);
     CHECK_NOT_NULL(b);
@@ -131,30 +448,42 @@ void matrix_add(matrix_t* a, matrix_t* b)
         ERROR("matrix dimensions mismatch a=(%zu, %zu), b=(%zu, %zu)", a->m, a->n, b->m, b->n);
     }
 
-    for (size_t i = 0; i < a->n; i++) {
-        for (size_t j = 0; j < b->m; j++) {
-            scalar_add(&a->rows[i][j], &a->rows[i][j], &b->rows[i][j]);
-        }
-    }
-}
+    size_t i = 0;
 
-void matrix_sub(matrix_t* a, matrix_t* b)
-{
-    CHECK_NOT_NULL(a);
-    CHECK_NOT_NULL(b);
+    if (a->integer && b->integer) {
+        while (i < a->m && integer_add(matrix_row_ptr(a, i), matrix_row_ptr(b, i), a->n, sub)) {
+            i++;
+        }
 
-    if (a->m != b->m || a->n != b->n) {
-        ERROR("matrix dimensions mismatch a=(%zu, %zu), b=(%zu, %zu)", a->m, a->n, b->m, b->n);
+        if (i == a->m) {
+            return;
+        }
     }
 
-    for (size_t i = 0; i < a->n; i++) {
-        for (size_t j = 0; j < b->m; j++) {
-            scalar_sub(&a->rows[i][j], &a->rows[i][j], &b->rows[i][j]);
+    for (; i < a->m; i++) {
+        for (size_t j = 0; j < a->n; j++) {
+            if (sub) {
+                scalar_sub(&matrix_at(a, i, j), &matrix_at(a, i, j), &matrix_at(b, i, j));
+            } else {
+                scalar_add(&matrix_at(a, i, j), &matrix_at(a, i, j), &matrix_at(b, i, j));
+            }
         }
     }
+
+    matrix_refresh_integer(a);
+}
+
+void matrix_add(matrix_t* a, const matrix_t* b)
+{
+    matrix_add_sub(a, b, false);
+}
+
+void matrix_sub(matrix_t* a, const matrix_t* b)
+{
+    matrix_add_sub(a, b, true);
 }
 
-vector_t* matrix_row(matrix_t* matrix, size_t i)
+vector_t* matrix_row(const matrix_t* matrix, size_t i)
 {
     CHECK_NOT_NULL(matrix);
 
@@ -162,10 +491,10 @@ vector_t* matrix_row(matrix_t* matrix, size_t i)
         ERROR("row number out of bounds (i=%zu)", i);
     }
 
-    return vector_from(matrix->rows[i], matrix->n);
+    return vector_from(matrix_row_ptr(matrix, i), matrix->n);
 }
 
-vector_t* matrix_col(matrix_t* matrix, size_t j)
+vector_t* matrix_col(const matrix_t* matrix, size_t j)
 {
     CHECK_NOT_NULL(matrix);
 
@@ -175,25 +504,82 @@ vector_t* matrix_col(matrix_t* matrix, size_t j)
 
     vector_t* col = vector_new(matrix->m);
     for (size_t i = 0; i < matrix->m; i++) {
-        scalar_copy(&col->items[i], &matrix->rows[i][j]);
+        scalar_copy(&col->items[i], &matrix_at(matrix, i, j));
     }
 
+    vector_refresh_integer(col);
     return col;
 }
 
-vector_t* matrix_diag(matrix_t* matrix)
+// Views of a row, a column or a block of matrix, sharing its storage: no
+// entry is copied, and writes through a view land in matrix. They must not
+// be deleted, and after writing through one the integer flag of matrix has
+// to be refreshed. Views are accepted wherever a vector or a matrix is read.
+vector_t matrix_row_view(matrix_t* matrix, size_t i)
+{
+    CHECK_NOT_NULL(matrix);
+
+    if (i >= matrix->m) {
+        ERROR("row number out of bounds (i=%zu)", i);
+    }
+
+    vector_t view = { .n = matrix->n, .stride = 1, .items = matrix_row_ptr(matrix, i) };
+
+    // The flag of an integer matrix holds for its parts, others are checked
+    view.integer = matrix->integer || integer_all(view.items, view.n);
+    return view;
+}
+
+vector_t matrix_col_view(matrix_t* matrix, size_t j)
+{
+    CHECK_NOT_NULL(matrix);
+
+    if (j >= matrix->n) {
+        ERROR("column number out of bounds (j=%zu)", j);
+    }
+
+    vector_t view = { .n = matrix->m, .stride = matrix->ld, .items = &matrix->data[j] };
+
+    if (matrix->integer) {
+        view.integer = true;
+    } else {
+        vector_refresh_integer(&view);
+    }
+
+    return view;
+}
+
+matrix_t matrix_view(matrix_t* matrix, size_t i, size_t j, size_t m, size_t n)
+{
+    CHECK_NOT_NULL(matrix);
+
+    if (i + m > matrix->m || j + n > matrix->n) {
+        ERROR("view out of bounds ((%zu, %zu) + (%zu, %zu) in (%zu, %zu))", i, j, m, n, matrix->m, matrix->n);
+    }
+
+    matrix_t view = matrix_window(matrix, i, j, m, n);
+
+    if (!matrix->integer) {
+        matrix_refresh_integer(&view);
+    }
+
+    return view;
+}
+
+vector_t* matrix_diag(const matrix_t* matrix)
 {
     CHECK_NOT_NULL(matrix);
 
     vector_t* diag = vector_new(matrix->m);
     for (size_t i = 0; i < matrix->m; i++) {
-        scalar_copy(&diag->items[i], &matrix->rows[i][i]);
+        scalar_copy(&diag->items[i], &matrix_at(matrix, i, i));
     }
 
+    vector_refresh_integer(diag);
     return diag;
 }
 
-scalar_t* matrix_get(matrix_t* matrix, size_t i, size_t j)
+static const scalar_t* matrix_entry(const matrix_t* matrix, size_t i, size_t j)
 {
     CHECK_NOT_NULL(matrix);
 
@@ -205,29 +591,246 @@ scalar_t* matrix_get(matrix_t* matrix, size_t i, size_t j)
         ERROR("column number out of bounds (j=%zu)", j);
     }
 
-    return scalar_duplicate(&matrix->rows[i][j]);
+    return &matrix_at(matrix, i, j);
 }
 
-void matrix_set(matrix_t* matrix, size_t i, size_t j, scalar_t* scalar)
+// The entry itself, to read or update in place without a copy. A write that
+// leaves a non-integer there clears the integer flag only through
+// matrix_refresh_integer.
+scalar_t* matrix_ptr(matrix_t* matrix, size_t i, size_t j)
+{
+    matrix_entry(matrix, i, j);
+    return &matrix_at(matrix, i, j);
+}
+
+// A copy of the entry, to be cleared by the caller if it is promoted
+scalar_t matrix_val(const matrix_t* matrix, size_t i, size_t j)
+{
+    scalar_t value = zero;
+
+    scalar_copy(&value, matrix_entry(matrix, i, j));
+    return value;
+}
+
+scalar_t* matrix_get(const matrix_t* matrix, size_t i, size_t j)
+{
+    return scalar_duplicate(matrix_entry(matrix, i, j));
+}
+
+void matrix_set(matrix_t* matrix, size_t i, size_t j, const scalar_t* scalar)
 {
-    CHECK_NOT_NULL(matrix);
     CHECK_NOT_NULL(scalar);
 
-    if (i >= matrix->m) {
-        ERROR("row number out of bounds (i=%zu)", i);
+    scalar_t* entry = matrix_ptr(matrix, i, j);
+
+    if (scalar->den != 1) {
+        matrix->integer = false;
     }
 
-    if (j >= matrix->n) {
-        ERROR("column number out of bounds (j=%zu)", j);
+    scalar_copy(entry, scalar);
+}
+
+// Scales every row of matrix by the lcm of its denominators, which turns it
+// into an integer matrix with the rows laid out in a single block. The
+// scale of each row is stored in scales. Returns NULL when an entry is
+// promoted or a row has no 64-bit common denominator.
+static int128_t** matrix_integer_rows(const matrix_t* matrix, uint64_t* scales)
+{
+    size_t n = matrix->n;
+
+    // The pointer table is padded to an even length, 128-bit integers need
+    // 16-byte alignment
+    size_t head = (matrix->m + 1) & ~(size_t)1;
+
+    int128_t** rows = malloc(head * sizeof(int128_t*) + matrix->m * n * sizeof(int128_t));
+    CHECK_NOT_NULL(rows);
+
+    int128_t* data = (int128_t*)(rows + head);
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        scalar_t* row = matrix_row_ptr(matrix, i);
+        uint128_t lcm = 1;
+
+        for (size_t j = 0; j < n; j++) {
+            if (scalar_is_big(&row[j])) {
+                free(rows);
+                return NULL;
+            }
+
+            if (row[j].num != 0) {
+                lcm = lcm / uint128_gcd(lcm, row[j].den) * row[j].den;
+                if (lcm > UINT64_MAX) {
+                    free(rows);
+                    return NULL;
+                }
+            }
+        }
+
+        rows[i]   = &data[i * n];
+        scales[i] = lcm;
+
+        for (size_t j = 0; j < n; j++) {
+            rows[i][j] = (int128_t)row[j].num * (int128_t)(lcm / row[j].den);
+        }
+    }
+
+    return rows;
+}
+
+typedef enum matrix_bareiss_status {
+    BAREISS_REGULAR,
+    BAREISS_SINGULAR,
+
+    // An intermediate minor doesn't fit in 128 bits
+    BAREISS_OVERFLOW,
+} matrix_bareiss_status_t;
+
+// Fraction-free (Bareiss) elimination of the n x n integer matrix in rows.
+// Every step divides by the previous pivot, and that division is always
+// exact, so entries stay integers bounded by minors of the input and no
+// gcd is ever needed. Stops as soon as a pivot column is zero on and below
+// the diagonal, otherwise stores the determinant in det.
+static matrix_bareiss_status_t matrix_bareiss(int128_t** rows, size_t n, int128_t* det)
+{
+    int128_t prev = 1;
+    bool     odd  = false;
+
+    for (size_t k = 0; k < n; k++) {
+        if (rows[k][k] == 0) {
+            size_t r = k + 1;
+            while (r < n && rows[r][k] == 0) {
+                r++;
+            }
+
+            if (r == n) {
+                return BAREISS_SINGULAR;
+            }
+
+            int128_t* tmp = rows[k];
+            rows[k]       = rows[r];
+            rows[r]       = tmp;
+            odd           = !odd;
+        }
+
+        int128_t  pivot = rows[k][k];
+        int128_t* rk    = rows[k];
+
+        for (size_t i = k + 1; i < n; i++) {
+            int128_t* ri = rows[i];
+            int128_t  x, y;
+
+            for (size_t j = k + 1; j < n; j++) {
+                if (__builtin_mul_overflow(ri[j], pivot, &x)
+                    || __builtin_mul_overflow(ri[k], rk[j], &y)
+                    || __builtin_sub_overflow(x, y, &x)) {
+                    return BAREISS_OVERFLOW;
+                }
+                ri[j] = x / prev;
+            }
+        }
+
+        prev = pivot;
+    }
+
+    *det = n == 0 ? 1 : rows[n - 1][n - 1];
+    if (odd) {
+        *det = -*det;
+    }
+
+    return BAREISS_REGULAR;
+}
+
+scalar_t matrix_det_val(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    if (matrix->m != matrix->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    uint64_t* scales = malloc(matrix->m * sizeof(uint64_t));
+    CHECK_NOT_NULL(scales);
+
+    int128_t** rows   = matrix_integer_rows(matrix, scales);
+    int128_t   det    = 0;
+    scalar_t   result = zero;
+
+    matrix_bareiss_status_t status = rows != NULL ? matrix_bareiss(rows, matrix->n, &det) : BAREISS_OVERFLOW;
+
+    if (status == BAREISS_REGULAR) {
+        // det(A) = det / prod(scales), reduced one scale at a time
+        bool      negative = det < 0;
+        uint128_t a        = negative ? -(uint128_t)det : (uint128_t)det;
+        bignum_t  x = BIGNUM_INIT, y = BIGNUM_INIT;
+
+        bignum_set_u64(&y, 1);
+
+        for (size_t i = 0; i < matrix->m; i++) {
+            uint128_t g = uint128_gcd(a, scales[i]);
+
+            a /= g;
+            bignum_mul_u64(&y, &y, scales[i] / g);
+        }
+
+        bignum_set_u128(&x, a);
+        scalar_set_bignum(&result, &x, &y, negative);
+
+        bignum_clear(&x);
+        bignum_clear(&y);
+    } else if (status == BAREISS_OVERFLOW) {
+        matrix_modp_det(matrix, &result);
+    }
+
+    free(rows);
+    free(scales);
+
+    return result;
+}
+
+scalar_t* matrix_det(const matrix_t* matrix)
+{
+    scalar_t  value  = matrix_det_val(matrix);
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = value;
+    return result;
+}
+
+bool matrix_is_inversible(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    if (matrix->m != matrix->n) {
+        return false;
     }
 
-    scalar_copy(&matrix->rows[i][j], scalar);
+    uint64_t* scales = malloc(matrix->m * sizeof(uint64_t));
+    CHECK_NOT_NULL(scales);
+
+    // Row scales are non-zero, they don't change whether det(A) is zero
+    int128_t** rows = matrix_integer_rows(matrix, scales);
+    int128_t   det;
+
+    matrix_bareiss_status_t status = rows != NULL ? matrix_bareiss(rows, matrix->n, &det) : BAREISS_OVERFLOW;
+
+    free(rows);
+    free(scales);
+
+    if (status == BAREISS_OVERFLOW) {
+        return matrix_modp_rank(matrix) == matrix->n;
+    }
+
+    return status == BAREISS_REGULAR;
 }
 
-scalar_t* matrix_det(matrix_t* mat);
-bool      matrix_is_inversible(matrix_t* mat);
+size_t matrix_rank(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    return matrix_modp_rank(matrix);
+}
 
-matrix_t* matrix_pivotise(matrix_t* matrix)
+matrix_t* matrix_pivotise(const matrix_t* matrix)
 {
     CHECK_NOT_NULL(matrix);
 
@@ -238,27 +841,40 @@ matrix_t* matrix_pivotise(matrix_t* matrix)
     matrix_t* P = matrix_eye(matrix->m);
 
     for (size_t i = 0; i < P->m; i++) {
-        scalar_t* max = &matrix->rows[i][i];
-        size_t    row = i;
+        const scalar_t* max = &matrix_at(matrix, i, i);
+        size_t          row = i;
         for (size_t j = i; j < P->n; j++)
-            if (scalar_greater_than(&matrix->rows[j][i], max)) {
-                max = &matrix->rows[j][i];
+            if (scalar_greater_than(&matrix_at(matrix, j, i), max)) {
+                max = &matrix_at(matrix, j, i);
                 row = j;
             }
 
         if (i != row) {
-            scalar_t* tmp = P->rows[i];
-            P->rows[i]    = P->rows[row];
-            P->rows[row]  = tmp;
+            scalar_t* ri = matrix_row_ptr(P, i);
+            scalar_t* rr = matrix_row_ptr(P, row);
+            for (size_t k = 0; k < P->n; k++) {
+                scalar_t tmp = ri[k];
+                ri[k]        = rr[k];
+                rr[k]        = tmp;
+            }
         }
     }
 
     return P;
 }
 
-matrix_t* matrix_inverse(matrix_t* mat);
+matrix_t* matrix_inverse(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    lu_t*     lu      = lu_new(matrix);
+    matrix_t* inverse = lu_inverse(lu);
+    lu_delete(lu);
+
+    return inverse;
+}
 
-matrix_t* matrix_transpose(matrix_t* matrix)
+matrix_t* matrix_transpose(const matrix_t* matrix)
 {
     CHECK_NOT_NULL(matrix);
 
@@ -266,14 +882,15 @@ matrix_t* matrix_transpose(matrix_t* matrix)
 
     for (size_t i = 0; i < matrix->m; i++) {
         for (size_t j = 0; j < matrix->n; j++) {
-            scalar_copy(&transpose->rows[j][i], &matrix->rows[i][j]);
+            scalar_copy(&matrix_at(transpose, j, i), &matrix_at(matrix, i, j));
         }
     }
 
+    transpose->integer = matrix->integer;
     return transpose;
 }
 
-void matrix_lu(matrix_t* matrix, matrix_t** L, matrix_t** U, matrix_t** P)
+void matrix_lu(const matrix_t* matrix, matrix_t** L, matrix_t** U, matrix_t** P)
 {
     CHECK_NOT_NULL(matrix);
 
@@ -281,117 +898,528 @@ void matrix_lu(matrix_t* matrix, matrix_t** L, matrix_t** U, matrix_t** P)
         ERROR_MESSAGE("not a square matrix");
     }
 
-    size_t n = matrix->m;
+    size_t n  = matrix->m;
+    lu_t*  lu = lu_new(matrix);
 
     *L = matrix_eye(n);
     *U = matrix_square(n);
-    *P = matrix_pivotise(matrix);
+    *P = matrix_square(n);
 
-    matrix_t* A = matrix_prod(*P, matrix);
+    // Unpack P.A = L.U from the packed factors
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < n; j++) {
+            scalar_copy(j < i ? &matrix_at(*L, i, j) : &matrix_at(*U, i, j), &matrix_at(lu->LU, i, j));
+        }
+        scalar_copy(&matrix_at(*P, i, lu->perm[i]), &one);
+    }
 
-    scalar_t* tmp  = scalar_from(0);
-    scalar_t* tmp2 = scalar_from(0);
-    for (size_t j = 0; j < n; j++) {
-        for (size_t i = 0; i < j + 1; i++) {
-            scalar_t* sum = scalar_from(0);
-            for (size_t k = 0; k < i; k++) {
-                scalar_mul(tmp, &(*U)->rows[k][j], &(*L)->rows[i][k]);
-                scalar_add(sum, sum, tmp);
+    matrix_refresh_integer(*L);
+    matrix_refresh_integer(*U);
+    lu_delete(lu);
+}
+
+// Columns are factorized this many at a time before the trailing lower
+// triangle is updated
+#define MATRIX_LDL_BLOCK 32
+
+typedef struct matrix_ldl_job {
+    matrix_t* a;
+
+    // W(i, k) = L(k1 + i, k0 + k) . D(k0 + k)
+    matrix_t* w;
+
+    // The block of columns just factorized
+    size_t k0, k1;
+} matrix_ldl_job_t;
+
+// Updates row k1 + index of the trailing lower triangle with the block of
+// columns [k0, k1): A(i, j) -= sum L(i, k) . D(k) . L(j, k)
+static void matrix_ldl_update(void* arg, size_t index)
+{
+    matrix_ldl_job_t* job = arg;
+
+    size_t    i  = job->k1 + index;
+    scalar_t* ai = matrix_row_ptr(job->a, i);
+    scalar_t* wi = matrix_row_ptr(job->w, index);
+    scalar_t  tmp = zero;
+
+    for (size_t j = job->k1; j <= i; j++) {
+        scalar_t* aj = matrix_row_ptr(job->a, j);
+
+        for (size_t k = job->k0; k < job->k1; k++) {
+            if (aj[k].num == 0) {
+                continue;
             }
-            scalar_sub(tmp, &A->rows[i][j], sum);
-            scalar_copy(&(*U)->rows[i][j], tmp);
-            scalar_delete(sum);
+
+            scalar_mul(&tmp, &wi[k - job->k0], &aj[k]);
+            scalar_sub(&ai[j], &ai[j], &tmp);
         }
+    }
+
+    scalar_clear(&tmp);
+}
+
+// Exact LDL^T factorization of a symmetric positive-definite matrix, the
+// rational stand-in for Cholesky: L is unit lower triangular and D diagonal
+// and positive, so no square root is needed. Only the lower triangle of the
+// input is read. The result packs L strictly below the diagonal and D on it.
+//
+// Columns are processed by blocks: the block is factorized against its own
+// previous columns, then its contribution is subtracted from the trailing
+// lower triangle, one row per pool task.
+matrix_t* matrix_chol(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
 
-        for (size_t i = j; i < n; i++) {
-            scalar_t* sum = scalar_from(0);
-            for (size_t k = 0; k < j; k++) {
-                scalar_mul(tmp, &(*U)->rows[k][j], &(*L)->rows[i][k]);
-                scalar_add(sum, sum, tmp);
+    if (matrix->m != matrix->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    size_t    n = matrix->n;
+    matrix_t* a = matrix_square(n);
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j <= i; j++) {
+            scalar_copy(&matrix_at(a, i, j), &matrix_at(matrix, i, j));
+        }
+    }
+
+    scalar_t* v = malloc(MATRIX_LDL_BLOCK * sizeof(scalar_t));
+    CHECK_NOT_NULL(v);
+
+    for (size_t k = 0; k < MATRIX_LDL_BLOCK; k++) {
+        v[k] = zero;
+    }
+
+    scalar_t inv = zero, tmp = zero;
+
+    for (size_t k0 = 0; k0 < n; k0 += MATRIX_LDL_BLOCK) {
+        size_t k1 = k0 + MATRIX_LDL_BLOCK < n ? k0 + MATRIX_LDL_BLOCK : n;
+
+        for (size_t j = k0; j < k1; j++) {
+            scalar_t* aj = matrix_row_ptr(a, j);
+
+            // v(k) = L(j, k) . D(k), then D(j) = A(j, j) - sum L(j, k) . v(k)
+            for (size_t k = k0; k < j; k++) {
+                scalar_mul(&v[k - k0], &aj[k], &matrix_at(a, k, k));
+                scalar_mul(&tmp, &aj[k], &v[k - k0]);
+                scalar_sub(&aj[j], &aj[j], &tmp);
+            }
+
+            if (aj[j].num == 0 || scalar_is_negative(&aj[j])) {
+                ERROR("not a positive-definite matrix (pivot %zu)", j);
+            }
+
+            scalar_inverse(&inv, &aj[j]);
+
+            // L(i, j) = (A(i, j) - sum L(i, k) . v(k)) / D(j)
+            for (size_t i = j + 1; i < n; i++) {
+                scalar_t* ai = matrix_row_ptr(a, i);
+
+                for (size_t k = k0; k < j; k++) {
+                    scalar_mul(&tmp, &ai[k], &v[k - k0]);
+                    scalar_sub(&ai[j], &ai[j], &tmp);
+                }
+
+                scalar_mul(&ai[j], &ai[j], &inv);
             }
-            scalar_sub(tmp, &A->rows[i][j], sum);
-            scalar_copy(tmp2, tmp);
-            scalar_div(tmp, tmp2, &(*U)->rows[j][j]);
-            scalar_copy(&(*L)->rows[i][j], tmp);
         }
+
+        if (k1 == n) {
+            break;
+        }
+
+        matrix_ldl_job_t job = { .a = a, .w = matrix_new(n - k1, k1 - k0), .k0 = k0, .k1 = k1 };
+
+        for (size_t i = k1; i < n; i++) {
+            for (size_t k = k0; k < k1; k++) {
+                scalar_mul(&matrix_at(job.w, i - k1, k - k0), &matrix_at(a, i, k), &matrix_at(a, k, k));
+            }
+        }
+
+        pool_run(matrix_ldl_update, &job, n - k1);
+        matrix_delete(job.w);
     }
-    scalar_delete(tmp2);
-    scalar_delete(tmp);
-}
 
-matrix_t* matrix_chol(matrix_t* matrix);
+    scalar_clear_all(v, MATRIX_LDL_BLOCK);
+    scalar_clear(&inv);
+    scalar_clear(&tmp);
+    free(v);
 
-char* matrix_string(matrix_t* matrix)
+    matrix_refresh_integer(a);
+    return a;
+}
+
+void matrix_ldl(const matrix_t* matrix, matrix_t** L, vector_t** D)
 {
     CHECK_NOT_NULL(matrix);
 
-    if (matrix->m == 1) {
-        vector_t* vector = vector_from(matrix->rows[0], matrix->n);
-        return vector_string(vector);
+    matrix_t* ldl = matrix_chol(matrix);
+    size_t    n   = ldl->n;
+
+    *L = matrix_eye(n);
+    *D = vector_new(n);
+
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < i; j++) {
+            scalar_copy(&matrix_at(*L, i, j), &matrix_at(ldl, i, j));
+        }
+        scalar_copy(&(*D)->items[i], &matrix_at(ldl, i, i));
     }
 
-    size_t* col_width = calloc(matrix->n, sizeof(size_t));
-    CHECK_NOT_NULL(col_width);
+    matrix_refresh_integer(*L);
+    vector_refresh_integer(*D);
+    matrix_delete(ldl);
+}
 
-    // Compute each column's size
-    for (size_t j = 0; j < matrix->n; j++) {
-        col_width[j] = 1;
-        for (size_t i = 0; i < matrix->m; i++) {
-            size_t width = scalar_string_length(&matrix->rows[i][j]) - 1;
-            if (width > col_width[j]) {
-                col_width[j] = width;
-            }
+// The text is built in a fixed buffer: either the destination itself when it
+// is known to be large enough, or a chunk handed to a sink each time it
+// fills up. Entries are written in place by scalar_write, so no allocation
+// happens per entry.
+#define MATRIX_TEXT_CHUNK 4096
+
+typedef struct matrix_text {
+    char*         buf;
+    size_t        cap;
+    size_t        len;
+    matrix_sink_t sink;
+    void*         ctx;
+    bool          ok;
+    char          chunk[MATRIX_TEXT_CHUNK];
+} matrix_text_t;
+
+static void matrix_text_flush(matrix_text_t* text)
+{
+    if (text->sink == NULL) {
+        ERROR_MESSAGE("matrix text buffer too small");
+    }
+
+    if (text->ok && text->len > 0) {
+        text->ok = text->sink(text->ctx, text->buf, text->len);
+    }
+
+    text->len = 0;
+}
+
+static void matrix_text_put(matrix_text_t* text, const char* str, size_t len)
+{
+    while (len > 0) {
+        if (text->len == text->cap) {
+            matrix_text_flush(text);
         }
+
+        size_t n = len < text->cap - text->len ? len : text->cap - text->len;
+
+        memcpy(text->buf + text->len, str, n);
+        text->len += n;
+        str += n;
+        len -= n;
     }
+}
+
+static void matrix_text_pad(matrix_text_t* text, size_t len)
+{
+    while (len > 0) {
+        if (text->len == text->cap) {
+            matrix_text_flush(text);
+        }
 
-    // Compute the total string's length
-    size_t str_length = 0;
+        size_t n = len < text->cap - text->len ? len : text->cap - text->len;
 
-    for (size_t j = 0; j < matrix->n; j++) {
-        str_length += 3;             // left and right separator + line feed
-        str_length += matrix->n - 1; // n-1 spaces to separate columns
-        str_length += col_width[j];  // column's width
+        memset(text->buf + text->len, ' ', n);
+        text->len += n;
+        len -= n;
     }
+}
 
-    char* str = malloc(str_length);
-    CHECK_NOT_NULL(str);
+// len is the length of the entry, scalar_write also needs room for its '\0'
+static void matrix_text_scalar(matrix_text_t* text, const scalar_t* x, size_t len)
+{
+    if (len >= text->cap - text->len) {
+        if (len >= text->cap) {
+            char* str = scalar_string(x);
 
-    char* loc     = str;
-    char* val_fmt = "%%%zus ";
-    char  tmp[64] = { 0 };
+            matrix_text_put(text, str, len);
+            free(str);
+            return;
+        }
+
+        matrix_text_flush(text);
+    }
+
+    text->len += scalar_write(text->buf + text->len, x);
+}
+
+static size_t matrix_entry_length(const matrix_t* matrix, size_t i, size_t j)
+{
+    return scalar_string_length(&matrix_at(matrix, i, j)) - 1;
+}
+
+// The width of column j: that of its longest entry, and at least 1
+static size_t matrix_col_width(const matrix_t* matrix, size_t j)
+{
+    size_t width = 1;
 
     for (size_t i = 0; i < matrix->m; i++) {
-        // line prefix
-        if (i == 0) {
-            loc += sprintf(loc, "⎡");
-        } else if (i == matrix->m - 1) {
-            loc += sprintf(loc, "⎣");
-        } else {
-            loc += sprintf(loc, "⎢");
+        size_t len = matrix_entry_length(matrix, i, j);
+
+        if (len > width) {
+            width = len;
         }
+    }
 
-        for (size_t j = 0; j < matrix->n; j++) {
-            // build column-appropriate fmt string
-            sprintf(tmp, val_fmt, col_width[j]);
+    return width;
+}
+
+// Returns the exact length of the text, '\0' included, and keeps the width
+// of each column in widths unless it is NULL. The columns are measured one
+// at a time, so the length alone needs no memory.
+static size_t matrix_text_layout(const matrix_t* matrix, size_t* widths)
+{
+    size_t m   = matrix->m;
+    size_t n   = matrix->n;
+    size_t sep = n > 0 ? n - 1 : 0;
+
+    if (m == 0) {
+        return 1;
+    }
+
+    // a single row is printed like a vector, "[x y z]"
+    if (m == 1) {
+        size_t len = 3 + sep;
+
+        for (size_t j = 0; j < n; j++) {
+            len += matrix_entry_length(matrix, 0, j);
+        }
+
+        return len;
+    }
 
-            char* scalar = scalar_string(&matrix->rows[i][j]);
-            loc += sprintf(loc, tmp, scalar);
+    size_t width = 0;
 
-            if (j == matrix->n - 1) {
-                loc--;
+    for (size_t j = 0; j < n; j++) {
+        size_t w = matrix_col_width(matrix, j);
+
+        if (widths != NULL) {
+            widths[j] = w;
+        }
+        width += w;
+    }
+
+    // each row has two 3-byte brackets, the columns and their separators,
+    // and all of them but the last a line feed
+    return m * (6 + width + sep) + (m - 1) + 1;
+}
+
+// Without widths, the width of a column is measured again for each of its
+// entries: no memory, but m times the work
+static void matrix_text_emit(const matrix_t* matrix, const size_t* widths, matrix_text_t* text)
+{
+    size_t m = matrix->m;
+    size_t n = matrix->n;
+
+    if (m == 1) {
+        matrix_text_put(text, "[", 1);
+
+        for (size_t j = 0; j < n; j++) {
+            if (j > 0) {
+                matrix_text_put(text, " ", 1);
             }
+            matrix_text_scalar(text, &matrix_at(matrix, 0, j), matrix_entry_length(matrix, 0, j));
+        }
+
+        matrix_text_put(text, "]", 1);
+        return;
+    }
+
+    for (size_t i = 0; i < m; i++) {
+        const char* left  = i == 0 ? "⎡" : i == m - 1 ? "⎣" : "⎢";
+        const char* right = i == 0 ? "⎤\n" : i == m - 1 ? "⎦" : "⎥\n";
+
+        matrix_text_put(text, left, strlen(left));
+
+        // entries right-aligned on the width of their column
+        for (size_t j = 0; j < n; j++) {
+            size_t len   = matrix_entry_length(matrix, i, j);
+            size_t width = widths != NULL ? widths[j] : matrix_col_width(matrix, j);
+
+            if (j > 0) {
+                matrix_text_put(text, " ", 1);
+            }
+            matrix_text_pad(text, width - len);
+            matrix_text_scalar(text, &matrix_at(matrix, i, j), len);
+        }
+
+        matrix_text_put(text, right, strlen(right));
+    }
+}
+
+static size_t* matrix_text_widths(const matrix_t* matrix)
+{
+    size_t* widths = malloc((matrix->n + 1) * sizeof(size_t));
+    CHECK_NOT_NULL(widths);
+
+    return widths;
+}
+
+// Writes the text to dst, which must hold matrix_string_length(matrix) bytes
+static void matrix_text_write(const matrix_t* matrix, const size_t* widths, char* dst, size_t len)
+{
+    matrix_text_t text = { .buf = dst, .cap = len, .ok = true };
+
+    matrix_text_emit(matrix, widths, &text);
+    dst[text.len] = '\0';
+}
+
+// The exact size of the text of matrix, '\0' included
+size_t matrix_string_length(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    return matrix_text_layout(matrix, NULL);
+}
+
+// Streams the text with the widths as laid out, or measured on the fly
+static bool matrix_text_stream(const matrix_t* matrix, const size_t* widths, matrix_sink_t sink, void* ctx)
+{
+    matrix_text_t text = { .cap = MATRIX_TEXT_CHUNK, .sink = sink, .ctx = ctx, .ok = true };
+
+    text.buf = text.chunk;
+
+    matrix_text_emit(matrix, widths, &text);
+    matrix_text_flush(&text);
+
+    return text.ok;
+}
+
+// Hands the text of matrix, without a '\0', to sink in chunks of at most
+// MATRIX_TEXT_CHUNK bytes. Stops as soon as sink returns false, and returns
+// whether all of it was accepted.
+//
+// widths is scratch space for matrix->n column widths. It may be NULL, the
+// widths are then measured again for every entry: nothing is allocated
+// either way for inline entries, but the scratch saves a factor of m.
+bool matrix_stream(const matrix_t* matrix, size_t* widths, matrix_sink_t sink, void* ctx)
+{
+    CHECK_NOT_NULL(matrix);
+    CHECK_NOT_NULL(sink);
+
+    if (widths != NULL) {
+        matrix_text_layout(matrix, widths);
+    }
+
+    return matrix_text_stream(matrix, widths, sink, ctx);
+}
+
+typedef struct matrix_text_dst {
+    char*  dst;
+    size_t left;
+} matrix_text_dst_t;
+
+static bool matrix_text_copy(void* ctx, const char* chunk, size_t len)
+{
+    matrix_text_dst_t* out = ctx;
+    size_t             n   = len < out->left ? len : out->left;
+
+    memcpy(out->dst, chunk, n);
+    out->dst += n;
+    out->left -= n;
+
+    return out->left > 0;
+}
+
+// Writes the text of matrix to dst like snprintf: at most size bytes, the
+// last one a '\0'. Returns the size the whole text needs, '\0' included, so
+// the text was truncated when that is larger than size. widths is the same
+// optional scratch as for matrix_stream, and nothing is allocated.
+size_t matrix_format(const matrix_t* matrix, char* dst, size_t size, size_t* widths)
+{
+    CHECK_NOT_NULL(matrix);
+
+    size_t len = matrix_text_layout(matrix, widths);
+
+    if (len <= size) {
+        CHECK_NOT_NULL(dst);
+        matrix_text_write(matrix, widths, dst, len);
+    } else if (size > 0) {
+        CHECK_NOT_NULL(dst);
+
+        matrix_text_dst_t out = { .dst = dst, .left = size - 1 };
+
+        if (size > 1) {
+            matrix_text_stream(matrix, widths, matrix_text_copy, &out);
         }
+        *out.dst = '\0';
+    }
+
+    return len;
+}
 
-        // line suffix
-        if (i == 0) {
-            loc += sprintf(loc, "⎤\n");
-        } else if (i == matrix->m - 1) {
-            loc += sprintf(loc, "⎦");
-        } else {
-            loc += sprintf(loc, "⎥\n");
+static bool matrix_text_file(void* ctx, const char* chunk, size_t len)
+{
+    return fwrite(chunk, 1, len, ctx) == len;
+}
+
+static bool matrix_text_fd(void* ctx, const char* chunk, size_t len)
+{
+    int fd = *(int*)ctx;
+
+    while (len > 0) {
+        ssize_t n = write(fd, chunk, len);
+
+        if (n < 0 && errno == EINTR) {
+            continue;
         }
+        if (n <= 0) {
+            return false;
+        }
+
+        chunk += n;
+        len -= n;
     }
 
-    free(col_width);
+    return true;
+}
+
+// matrix_stream with the column widths on the heap
+static bool matrix_text_output(const matrix_t* matrix, matrix_sink_t sink, void* ctx)
+{
+    CHECK_NOT_NULL(matrix);
+
+    size_t* widths = matrix_text_widths(matrix);
+    bool    ok     = matrix_stream(matrix, widths, sink, ctx);
+
+    free(widths);
+    return ok;
+}
+
+// Writes the text of matrix to file, and returns whether it all went through
+bool matrix_fprint(const matrix_t* matrix, FILE* file)
+{
+    CHECK_NOT_NULL(file);
+
+    return matrix_text_output(matrix, matrix_text_file, file);
+}
+
+// Writes the text of matrix to the file descriptor fd, without buffering
+// beyond the chunks, and returns whether it all went through
+bool matrix_write_fd(const matrix_t* matrix, int fd)
+{
+    return matrix_text_output(matrix, matrix_text_fd, &fd);
+}
+
+// The text of matrix in a single block of exactly the right size
+char* matrix_string(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    size_t* widths = matrix_text_widths(matrix);
+    size_t  len    = matrix_text_layout(matrix, widths);
+    char*   str    = malloc(len);
+    CHECK_NOT_NULL(str);
+
+    matrix_text_write(matrix, widths, str, len);
+
+    free(widths);
     return str;
 }
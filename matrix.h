@@ -1,51 +1,86 @@
 #ifndef TD_MATRIX_H
 #define TD_MATRIX_H
 
+#include "alloc.h"
 #include "scalar.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 typedef struct vector vector_t;
 
+// Receives the text of a matrix chunk by chunk, returns false to stop
+typedef bool (*matrix_sink_t)(void* ctx, const char* chunk, size_t len);
+
 typedef struct matrix {
-    size_t     m, n;
-    scalar_t** rows;
+    // Aligned like a scalar, so the entries allocated right after the
+    // header are as well
+    _Alignas(scalar_t) size_t m, n;
+
+    // The leading dimension, i.e. the distance (in scalars) between the
+    // first elements of two consecutive rows
+    size_t ld;
+
+    // Set when every entry is an inline integer, the arithmetic below then
+    // runs on int64 kernels. The functions of the library keep it exact;
+    // code writing entries through matrix_at has to call
+    // matrix_refresh_integer.
+    bool integer;
+
+    // Row-major element buffer, allocated together with the matrix itself
+    scalar_t* data;
 } matrix_t;
 
-#define matrix_delete(matrix)                    \
-    if ((matrix) != NULL) {                      \
-        for (size_t i = 0; i < matrix->m; i++) { \
-            free(matrix->rows[i]);               \
-        }                                        \
-        free((matrix)->rows);                    \
-        free(matrix);                            \
-        (matrix) = NULL;                         \
+#define matrix_at(matrix, i, j) ((matrix)->data[(i) * (matrix)->ld + (j)])
+
+#define matrix_row_ptr(matrix, i) (&(matrix)->data[(i) * (matrix)->ld])
+
+#define matrix_delete(matrix)                                           \
+    if ((matrix) != NULL) {                                             \
+        scalar_clear_all((matrix)->data, (matrix)->m * (matrix)->n); \
+        alloc_free(matrix);                                             \
+        (matrix) = NULL;                                                \
     }
 
 matrix_t* matrix_new(size_t m, size_t n);
 matrix_t* matrix_square(size_t n);
 matrix_t* matrix_eye(size_t n);
-matrix_t* matrix_from_diag(vector_t* diag);
-matrix_t* matrix_from_vector(vector_t* vector, bool line);
-matrix_t* matrix_prod(matrix_t* a, matrix_t* b);
-void      matrix_scale(matrix_t* matrix, scalar_t* scalar);
-void      matrix_add(matrix_t* a, matrix_t* b);
-void      matrix_sub(matrix_t* a, matrix_t* b);
+matrix_t* matrix_from_diag(const vector_t* diag);
+matrix_t* matrix_from_vector(const vector_t* vector, bool line);
+void      matrix_refresh_integer(matrix_t* matrix);
+matrix_t* matrix_prod(const matrix_t* a, const matrix_t* b);
+void      matrix_set_strassen_cutoff(size_t n);
+void      matrix_scale(matrix_t* matrix, const scalar_t* scalar);
+void      matrix_add(matrix_t* a, const matrix_t* b);
+void      matrix_sub(matrix_t* a, const matrix_t* b);
 void      matrix_mul(matrix_t* a, matrix_t* b);
-vector_t* matrix_row(matrix_t* matrix, size_t i);
-vector_t* matrix_col(matrix_t* matrix, size_t j);
-vector_t* matrix_diag(matrix_t* matrix);
-scalar_t* matrix_get(matrix_t* matrix, size_t i, size_t j);
-void      matrix_set(matrix_t* matrix, size_t i, size_t j, scalar_t* x);
-scalar_t* matrix_det(matrix_t* matrix);
-bool      matrix_is_inversible(matrix_t* matrix);
-matrix_t* matrix_pivotise(matrix_t* matrix);
-matrix_t* matrix_inverse(matrix_t* matrix);
-matrix_t* matrix_transpose(matrix_t* matrix);
-void      matrix_lu(matrix_t* matrix, matrix_t** L, matrix_t** U, matrix_t** P);
-matrix_t* matrix_chol(matrix_t* matrix);
-char*     matrix_string(matrix_t* matrix);
+vector_t* matrix_row(const matrix_t* matrix, size_t i);
+vector_t* matrix_col(const matrix_t* matrix, size_t j);
+vector_t  matrix_row_view(matrix_t* matrix, size_t i);
+vector_t  matrix_col_view(matrix_t* matrix, size_t j);
+matrix_t  matrix_view(matrix_t* matrix, size_t i, size_t j, size_t m, size_t n);
+vector_t* matrix_diag(const matrix_t* matrix);
+scalar_t* matrix_ptr(matrix_t* matrix, size_t i, size_t j);
+scalar_t  matrix_val(const matrix_t* matrix, size_t i, size_t j);
+scalar_t* matrix_get(const matrix_t* matrix, size_t i, size_t j);
+void      matrix_set(matrix_t* matrix, size_t i, size_t j, const scalar_t* x);
+scalar_t  matrix_det_val(const matrix_t* matrix);
+scalar_t* matrix_det(const matrix_t* matrix);
+bool      matrix_is_inversible(const matrix_t* matrix);
+size_t    matrix_rank(const matrix_t* matrix);
+matrix_t* matrix_pivotise(const matrix_t* matrix);
+matrix_t* matrix_inverse(const matrix_t* matrix);
+matrix_t* matrix_transpose(const matrix_t* matrix);
+void      matrix_lu(const matrix_t* matrix, matrix_t** L, matrix_t** U, matrix_t** P);
+matrix_t* matrix_chol(const matrix_t* matrix);
+void      matrix_ldl(const matrix_t* matrix, matrix_t** L, vector_t** D);
+size_t    matrix_string_length(const matrix_t* matrix);
+bool      matrix_stream(const matrix_t* matrix, size_t* widths, matrix_sink_t sink, void* ctx);
+size_t    matrix_format(const matrix_t* matrix, char* dst, size_t size, size_t* widths);
+bool      matrix_fprint(const matrix_t* matrix, FILE* file);
+bool      matrix_write_fd(const matrix_t* matrix, int fd);
+char*     matrix_string(const matrix_t* matrix);
 
 #endif /* matrix.h */
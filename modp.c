@@ -0,0 +1,539 @@
+#include "modp.h"
+#include "bignum.h"
+#include "gcd.h"
+#include "pool.h"
+#include "utils.h"
+#include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Primes are taken downwards from here, each one brings 63 bits
+#define MODP_PRIME_TOP ((uint64_t)1 << 63)
+
+// Below this many multiply-adds over all primes an elimination runs on the
+// calling thread
+#define MODP_PARALLEL_MIN (64 * 64 * 64)
+
+void modp_init(modp_t* f, uint64_t p)
+{
+    CHECK_NOT_NULL(f);
+
+    if (p % 2 == 0 || p >= MODP_PRIME_TOP) {
+        ERROR("modulus must be odd and below 2^63 (p=%" PRIu64 ")", p);
+    }
+
+    // Newton's iteration doubles the number of correct low bits of 1/p,
+    // starting from the 3 that p itself gets right
+    uint64_t inv = p;
+    for (int i = 0; i < 5; i++) {
+        inv *= 2 - p * inv;
+    }
+
+    uint64_t r = -p % p;
+
+    f->p    = p;
+    f->pinv = -inv;
+    f->r2   = (uint128_t)r * r % p;
+}
+
+uint64_t modp_pow(const modp_t* f, uint64_t x, uint64_t e)
+{
+    uint64_t r = modp_to(f, 1);
+
+    for (; e > 0; e >>= 1) {
+        if (e & 1) {
+            r = modp_mul(f, r, x);
+        }
+        x = modp_mul(f, x, x);
+    }
+
+    return r;
+}
+
+// By Fermat's little theorem, x must be non-zero
+uint64_t modp_inverse(const modp_t* f, uint64_t x)
+{
+    return modp_pow(f, x, f->p - 2);
+}
+
+// The Montgomery form of the natural number held in limbs, least
+// significant first, by Horner's rule on base 2^64: no division at all
+uint64_t modp_reduce(const modp_t* f, const uint64_t* limbs, size_t size)
+{
+    uint64_t r = 0;
+
+    for (size_t i = size; i-- > 0;) {
+        r = modp_add(f, modp_mul(f, r, f->r2), modp_to(f, limbs[i]));
+    }
+
+    return r;
+}
+
+// Deterministic Miller-Rabin: these bases have no strong pseudoprime in
+// common below 2^64
+bool modp_is_prime(uint64_t n)
+{
+    static const uint64_t small[] = { 2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37 };
+    static const uint64_t bases[] = { 2, 325, 9375, 28178, 450775, 9780504, 1795265022 };
+
+    for (size_t i = 0; i < sizeof(small) / sizeof(small[0]); i++) {
+        if (n % small[i] == 0) {
+            return n == small[i];
+        }
+    }
+
+    if (n < 37 * 37) {
+        return n > 1;
+    }
+
+    if (n >= MODP_PRIME_TOP) {
+        ERROR("only numbers below 2^63 are supported (n=%" PRIu64 ")", n);
+    }
+
+    modp_t f;
+    modp_init(&f, n);
+
+    uint64_t one   = modp_to(&f, 1);
+    uint64_t minus = modp_to(&f, n - 1);
+    int      s     = __builtin_ctzll(n - 1);
+    uint64_t d     = (n - 1) >> s;
+
+    for (size_t i = 0; i < sizeof(bases) / sizeof(bases[0]); i++) {
+        uint64_t a = bases[i] % n;
+
+        if (a == 0) {
+            continue;
+        }
+
+        uint64_t x = modp_pow(&f, modp_to(&f, a), d);
+
+        if (x == one || x == minus) {
+            continue;
+        }
+
+        // a^(d.2^k) has to reach -1 before the last square. Reaching 1
+        // first means a square root of 1 other than +/-1, so n is composite.
+        for (int k = 1; k < s && x != minus; k++) {
+            x = modp_mul(&f, x, x);
+        }
+
+        if (x != minus) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static pthread_mutex_t modp_primes_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t*       modp_primes;
+static size_t          modp_primes_count, modp_primes_capacity;
+
+// The i-th prime below 2^63, in decreasing order. The table is shared and
+// grows on demand.
+uint64_t modp_prime(size_t i)
+{
+    pthread_mutex_lock(&modp_primes_lock);
+
+    while (modp_primes_count <= i) {
+        if (modp_primes_count == modp_primes_capacity) {
+            modp_primes_capacity = modp_primes_capacity == 0 ? 64 : 2 * modp_primes_capacity;
+            modp_primes          = realloc(modp_primes, modp_primes_capacity * sizeof(uint64_t));
+            CHECK_NOT_NULL(modp_primes);
+        }
+
+        uint64_t p = modp_primes_count == 0 ? MODP_PRIME_TOP - 1 : modp_primes[modp_primes_count - 1] - 2;
+        while (!modp_is_prime(p)) {
+            p -= 2;
+        }
+
+        modp_primes[modp_primes_count++] = p;
+    }
+
+    uint64_t p = modp_primes[i];
+
+    pthread_mutex_unlock(&modp_primes_lock);
+    return p;
+}
+
+// The integer x in (-M/2, M/2] with x = residues[i] mod primes[i], M the
+// product of the primes, by Garner's mixed-radix algorithm: the digits
+// v(i) of x = v(0) + v(1) p(0) + v(2) p(0) p(1) + ... only take word
+// arithmetic, and the big number is assembled once at the end.
+void modp_crt(bignum_t* x, bool* negative, const uint64_t* primes, const uint64_t* residues, size_t count)
+{
+    CHECK_NOT_NULL(x);
+    CHECK_NOT_NULL(negative);
+
+    uint64_t* v = malloc(count * sizeof(uint64_t));
+    CHECK_NOT_NULL(v);
+
+    for (size_t i = 0; i < count; i++) {
+        modp_t f;
+        modp_init(&f, primes[i]);
+
+        // u = v(0) + v(1) p(0) + ... + v(i-1) p(0)...p(i-2), c = p(0)...p(i-1)
+        uint64_t u = 0, c = modp_to(&f, 1);
+
+        for (size_t j = i; j-- > 0;) {
+            u = modp_add(&f, modp_mul(&f, u, modp_to(&f, primes[j])), modp_to(&f, v[j]));
+        }
+
+        for (size_t j = 0; j < i; j++) {
+            c = modp_mul(&f, c, modp_to(&f, primes[j]));
+        }
+
+        uint64_t r = modp_sub(&f, modp_to(&f, residues[i]), u);
+        v[i]       = modp_from(&f, modp_mul(&f, r, modp_inverse(&f, c)));
+    }
+
+    bignum_t m = BIGNUM_INIT, h = BIGNUM_INIT;
+
+    bignum_set_u64(x, 0);
+    bignum_set_u64(&m, 1);
+
+    for (size_t i = count; i-- > 0;) {
+        bignum_mul_u64(x, x, primes[i]);
+        bignum_add_u64(x, x, v[i]);
+        bignum_mul_u64(&m, &m, primes[i]);
+    }
+
+    // Past M/2 the value is the negative x - M
+    bignum_add(&h, x, x);
+    *negative = bignum_cmp(&h, &m) > 0;
+
+    if (*negative) {
+        bignum_sub(x, &m, x);
+    }
+
+    bignum_clear(&h);
+    bignum_clear(&m);
+    free(v);
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+// B = S.A, S the diagonal of the least row scales that clear the
+// denominators of A. Entries are stored as signs and magnitudes whose limbs
+// share one pool, so reducing them modulo a prime is a linear scan.
+typedef struct modp_integer {
+    size_t m, n;
+
+    // Entry e has its limbs in limbs[start[e]:start[e + 1]]
+    size_t*   start;
+    uint64_t* limbs;
+    bool*     negative;
+    size_t    size, capacity;
+
+    // The product of the row scales
+    bignum_t scale;
+
+    // log2 of the product of the row norms, each at least 1: it bounds
+    // every minor of B
+    double bits;
+} modp_integer_t;
+
+static void modp_integer_push(modp_integer_t* b, const uint64_t* limbs, size_t size)
+{
+    if (b->size + size > b->capacity) {
+        b->capacity = 2 * (b->size + size);
+        b->limbs    = realloc(b->limbs, b->capacity * sizeof(uint64_t));
+        CHECK_NOT_NULL(b->limbs);
+    }
+
+    memcpy(&b->limbs[b->size], limbs, size * sizeof(uint64_t));
+    b->size += size;
+}
+
+// An upper bound of log2 x for x > 0, from its top limb
+static double modp_log2(const uint64_t* limbs, size_t size)
+{
+    return log2((double)limbs[size - 1] + 1) + 64.0 * (size - 1);
+}
+
+static void modp_integer_row(modp_integer_t* b, scalar_t* row, size_t i)
+{
+    size_t    n   = b->n;
+    uint128_t lcm = 1;
+    bool      big = false;
+
+    for (size_t j = 0; j < n && !big; j++) {
+        if (scalar_is_big(&row[j])) {
+            big = true;
+        } else if (row[j].num != 0) {
+            lcm = lcm / uint128_gcd(lcm, row[j].den) * row[j].den;
+            big = lcm > UINT64_MAX;
+        }
+    }
+
+    bignum_t s = BIGNUM_INIT, x = BIGNUM_INIT, y = BIGNUM_INIT, g = BIGNUM_INIT;
+
+    if (big) {
+        // The same lcm on big numbers
+        bignum_set_u64(&s, 1);
+
+        for (size_t j = 0; j < n; j++) {
+            if (row[j].num != 0) {
+                scalar_get_bignum(&row[j], &x, &y);
+                bignum_gcd(&g, &s, &y);
+                bignum_divmod(&s, NULL, &s, &g);
+                bignum_mul(&s, &s, &y);
+            }
+        }
+    } else {
+        bignum_set_u64(&s, lcm);
+    }
+
+    double top = 0, sum = 0;
+
+    for (size_t j = 0; j < n; j++) {
+        size_t e = i * n + j;
+
+        b->start[e]    = b->size;
+        b->negative[e] = scalar_is_negative(&row[j]);
+
+        if (row[j].num == 0) {
+            continue;
+        }
+
+        if (!big) {
+            uint128_t v        = (uint128_t)(row[j].num < 0 ? -(uint64_t)row[j].num : (uint64_t)row[j].num)
+                        * (lcm / row[j].den);
+            uint64_t  limbs[2] = { (uint64_t)v, (uint64_t)(v >> 64) };
+
+            modp_integer_push(b, limbs, limbs[1] != 0 ? 2 : 1);
+        } else {
+            // |a| . (s / b)
+            scalar_get_bignum(&row[j], &x, &y);
+            bignum_divmod(&g, NULL, &s, &y);
+            bignum_mul(&x, &x, &g);
+            modp_integer_push(b, x.limbs, x.size);
+        }
+
+        // sum of (B(i, j) / 2^top)^2, rescaled whenever top grows
+        double l = modp_log2(&b->limbs[b->start[e]], b->size - b->start[e]);
+
+        if (l > top) {
+            sum = sum * exp2(2 * (top - l)) + 1;
+            top = l;
+        } else {
+            sum += exp2(2 * (l - top));
+        }
+    }
+
+    if (sum > 0) {
+        double norm = top + 0.5 * log2(sum);
+        b->bits += norm > 0 ? norm : 0;
+    }
+
+    bignum_mul(&b->scale, &b->scale, &s);
+
+    bignum_clear(&g);
+    bignum_clear(&y);
+    bignum_clear(&x);
+    bignum_clear(&s);
+}
+
+static void modp_integer_init(modp_integer_t* b, const matrix_t* matrix)
+{
+    b->m        = matrix->m;
+    b->n        = matrix->n;
+    b->start    = malloc((b->m * b->n + 1) * sizeof(size_t));
+    b->negative = malloc(b->m * b->n * sizeof(bool) + 1);
+    b->limbs    = NULL;
+    b->size     = 0;
+    b->capacity = 0;
+    b->scale    = BIGNUM_INIT;
+    b->bits     = 0;
+
+    CHECK_NOT_NULL(b->start);
+    CHECK_NOT_NULL(b->negative);
+
+    bignum_set_u64(&b->scale, 1);
+
+    for (size_t i = 0; i < b->m; i++) {
+        modp_integer_row(b, matrix_row_ptr(matrix, i), i);
+    }
+
+    b->start[b->m * b->n] = b->size;
+}
+
+static void modp_integer_clear(modp_integer_t* b)
+{
+    bignum_clear(&b->scale);
+    free(b->limbs);
+    free(b->negative);
+    free(b->start);
+}
+
+typedef struct modp_job {
+    modp_integer_t* b;
+    uint64_t*       primes;
+
+    // det(B) and rank(B) modulo every prime
+    uint64_t* dets;
+    size_t*   ranks;
+} modp_job_t;
+
+// Gaussian elimination of B modulo one prime, down to row echelon form
+static void modp_task(void* arg, size_t index)
+{
+    modp_job_t*     job = arg;
+    modp_integer_t* b   = job->b;
+    size_t          m = b->m, n = b->n;
+
+    modp_t f;
+    modp_init(&f, job->primes[index]);
+
+    uint64_t*  data = malloc(m * n * sizeof(uint64_t) + 1);
+    uint64_t** rows = malloc(m * sizeof(uint64_t*) + 1);
+    CHECK_NOT_NULL(data);
+    CHECK_NOT_NULL(rows);
+
+    for (size_t e = 0; e < m * n; e++) {
+        uint64_t r = modp_reduce(&f, &b->limbs[b->start[e]], b->start[e + 1] - b->start[e]);
+        data[e]    = b->negative[e] ? modp_sub(&f, 0, r) : r;
+    }
+
+    for (size_t i = 0; i < m; i++) {
+        rows[i] = &data[i * n];
+    }
+
+    uint64_t det  = modp_to(&f, 1);
+    size_t   rank = 0;
+
+    for (size_t k = 0; k < n && rank < m; k++) {
+        size_t p = rank;
+        while (p < m && rows[p][k] == 0) {
+            p++;
+        }
+
+        if (p == m) {
+            det = 0;
+            continue;
+        }
+
+        if (p != rank) {
+            uint64_t* tmp = rows[p];
+            rows[p]       = rows[rank];
+            rows[rank]    = tmp;
+            det           = modp_sub(&f, 0, det);
+        }
+
+        uint64_t* rk  = rows[rank];
+        uint64_t  inv = modp_inverse(&f, rk[k]);
+
+        det = modp_mul(&f, det, rk[k]);
+
+        for (size_t i = rank + 1; i < m; i++) {
+            uint64_t* ri = rows[i];
+
+            if (ri[k] == 0) {
+                continue;
+            }
+
+            uint64_t l = modp_mul(&f, ri[k], inv);
+
+            for (size_t j = k + 1; j < n; j++) {
+                ri[j] = modp_sub(&f, ri[j], modp_mul(&f, l, rk[j]));
+            }
+        }
+
+        rank++;
+    }
+
+    job->dets[index]  = modp_from(&f, det);
+    job->ranks[index] = rank;
+
+    free(rows);
+    free(data);
+}
+
+// Eliminates B modulo enough primes for their product to exceed twice the
+// Hadamard bound, which determines det(B) by its residues and makes the
+// largest rank seen the exact one. Returns the number of primes used.
+static size_t modp_run(modp_job_t* job, modp_integer_t* b)
+{
+    // A margin of two bits covers the sign and the rounding of the bound
+    size_t count = (size_t)ceil((b->bits + 2) / 63) + 1;
+
+    job->b      = b;
+    job->primes = malloc(count * sizeof(uint64_t));
+    job->dets   = malloc(count * sizeof(uint64_t));
+    job->ranks  = malloc(count * sizeof(size_t));
+    CHECK_NOT_NULL(job->primes);
+    CHECK_NOT_NULL(job->dets);
+    CHECK_NOT_NULL(job->ranks);
+
+    for (size_t i = 0; i < count; i++) {
+        job->primes[i] = modp_prime(i);
+    }
+
+    if (b->m * b->n * (b->m < b->n ? b->m : b->n) * count < MODP_PARALLEL_MIN) {
+        for (size_t i = 0; i < count; i++) {
+            modp_task(job, i);
+        }
+    } else {
+        pool_run(modp_task, job, count);
+    }
+
+    return count;
+}
+
+static void modp_job_clear(modp_job_t* job)
+{
+    free(job->ranks);
+    free(job->dets);
+    free(job->primes);
+}
+
+void matrix_modp_det(const matrix_t* matrix, scalar_t* det)
+{
+    CHECK_NOT_NULL(matrix);
+    CHECK_NOT_NULL(det);
+
+    if (matrix->m != matrix->n) {
+        ERROR_MESSAGE("not a square matrix");
+    }
+
+    modp_integer_t b;
+    modp_job_t     job;
+
+    modp_integer_init(&b, matrix);
+    size_t count = modp_run(&job, &b);
+
+    // det(A) = det(B) / prod(scales)
+    bignum_t x = BIGNUM_INIT;
+    bool     negative;
+
+    modp_crt(&x, &negative, job.primes, job.dets, count);
+    scalar_set_bignum(det, &x, &b.scale, negative);
+
+    bignum_clear(&x);
+    modp_job_clear(&job);
+    modp_integer_clear(&b);
+}
+
+size_t matrix_modp_rank(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    modp_integer_t b;
+    modp_job_t     job;
+
+    modp_integer_init(&b, matrix);
+    size_t count = modp_run(&job, &b);
+
+    // A rank can only drop modulo a prime dividing every minor of that size
+    size_t rank = 0;
+    for (size_t i = 0; i < count; i++) {
+        rank = job.ranks[i] > rank ? job.ranks[i] : rank;
+    }
+
+    modp_job_clear(&job);
+    modp_integer_clear(&b);
+
+    return rank;
+}
@@ -0,0 +1,74 @@
+#ifndef TD_MODP_H
+#define TD_MODP_H
+
+#include "matrix.h"
+#include "scalar.h"
+#include "utils.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Arithmetic modulo an odd prime p < 2^63, in Montgomery form: x is held as
+// x . 2^64 mod p, so that reducing a product takes two multiplications and
+// a shift instead of a division. Residues are always fully reduced.
+typedef struct modp {
+    uint64_t p;
+
+    // -1/p mod 2^64
+    uint64_t pinv;
+
+    // 2^128 mod p, the Montgomery form of 2^64
+    uint64_t r2;
+} modp_t;
+
+// t . 2^-64 mod p, for t < p . 2^64
+static inline uint64_t modp_redc(const modp_t* f, uint128_t t)
+{
+    uint64_t  m = (uint64_t)t * f->pinv;
+    uint64_t  r = (t + (uint128_t)m * f->p) >> 64;
+
+    return r >= f->p ? r - f->p : r;
+}
+
+static inline uint64_t modp_mul(const modp_t* f, uint64_t a, uint64_t b)
+{
+    return modp_redc(f, (uint128_t)a * b);
+}
+
+static inline uint64_t modp_add(const modp_t* f, uint64_t a, uint64_t b)
+{
+    uint64_t s = a + b;
+    return s >= f->p ? s - f->p : s;
+}
+
+static inline uint64_t modp_sub(const modp_t* f, uint64_t a, uint64_t b)
+{
+    return a >= b ? a - b : a + f->p - b;
+}
+
+// The Montgomery form of any 64-bit x, reduced or not
+static inline uint64_t modp_to(const modp_t* f, uint64_t x)
+{
+    return modp_redc(f, (uint128_t)x * f->r2);
+}
+
+static inline uint64_t modp_from(const modp_t* f, uint64_t x)
+{
+    return modp_redc(f, x);
+}
+
+void     modp_init(modp_t* f, uint64_t p);
+uint64_t modp_pow(const modp_t* f, uint64_t x, uint64_t e);
+uint64_t modp_inverse(const modp_t* f, uint64_t x);
+uint64_t modp_reduce(const modp_t* f, const uint64_t* limbs, size_t size);
+bool     modp_is_prime(uint64_t n);
+uint64_t modp_prime(size_t i);
+void     modp_crt(bignum_t* x, bool* negative, const uint64_t* primes, const uint64_t* residues, size_t count);
+
+// Exact determinant and rank by elimination modulo as many primes as the
+// Hadamard bound of the input requires, one prime per pool task, and
+// Chinese remaindering. Any entries are accepted, promoted ones included.
+void   matrix_modp_det(const matrix_t* matrix, scalar_t* det);
+size_t matrix_modp_rank(const matrix_t* matrix);
+
+#endif /* modp.h */
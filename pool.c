@@ -0,0 +1,538 @@
+#include "pool.h"
+#include "utils.h"
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define POOL_MAX_THREADS 256
+
+typedef struct pool_queue {
+    pthread_mutex_t lock;
+
+    // The indices still waiting in this queue, [lo, hi)
+    size_t lo, hi;
+} pool_queue_t;
+
+static struct {
+    // Serializes batches and reconfiguration
+    pthread_mutex_t run;
+
+    // Protects everything below
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+    pthread_cond_t  done;
+
+    // Configured thread count (0 until first use), and spawned workers
+    size_t     threads;
+    size_t     started;
+    pthread_t* workers;
+
+    // One queue per thread, slot 0 belongs to the thread calling pool_run
+    pool_queue_t* queues;
+
+    // Current batch
+    uint64_t     generation;
+    bool         stop;
+    pool_task_fn fn;
+    void*        arg;
+    size_t       remaining;
+} pool = {
+    .run  = PTHREAD_MUTEX_INITIALIZER,
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .done = PTHREAD_COND_INITIALIZER,
+};
+
+static _Thread_local bool in_pool = false;
+
+static size_t pool_default_threads(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n < 1 ? 1 : (size_t)n;
+}
+
+static bool pool_pop(size_t id, size_t* index)
+{
+    pool_queue_t* q = &pool.queues[id];
+    bool          found;
+
+    pthread_mutex_lock(&q->lock);
+    found = q->lo < q->hi;
+    if (found) {
+        *index = q->lo++;
+    }
+    pthread_mutex_unlock(&q->lock);
+
+    return found;
+}
+
+static bool pool_steal(size_t id, size_t* index)
+{
+    for (size_t k = 1; k < pool.threads; k++) {
+        pool_queue_t* victim = &pool.queues[(id + k) % pool.threads];
+        size_t        lo, hi;
+
+        // Take the upper half of the victim's range, it keeps working on
+        // the lower end undisturbed
+        pthread_mutex_lock(&victim->lock);
+        hi = victim->hi;
+        lo = victim->hi - (victim->hi - victim->lo) / 2;
+        if (lo == hi && victim->lo < victim->hi) {
+            lo--;
+        }
+        victim->hi = lo;
+        pthread_mutex_unlock(&victim->lock);
+
+        if (lo < hi) {
+            pool_queue_t* own = &pool.queues[id];
+
+            pthread_mutex_lock(&own->lock);
+            own->lo = lo + 1;
+            own->hi = hi;
+            pthread_mutex_unlock(&own->lock);
+
+            *index = lo;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void pool_work(size_t id)
+{
+    size_t done = 0;
+    size_t index;
+
+    while (pool_pop(id, &index) || pool_steal(id, &index)) {
+        pool.fn(pool.arg, index);
+        done++;
+    }
+
+    if (done > 0) {
+        pthread_mutex_lock(&pool.lock);
+        pool.remaining -= done;
+        if (pool.remaining == 0) {
+            pthread_cond_broadcast(&pool.done);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+}
+
+static void* pool_worker(void* data)
+{
+    size_t   id   = (size_t)data;
+    uint64_t seen = 0;
+
+    in_pool = true;
+
+    pthread_mutex_lock(&pool.lock);
+    for (;;) {
+        while (!pool.stop && pool.generation == seen) {
+            pthread_cond_wait(&pool.wake, &pool.lock);
+        }
+
+        if (pool.stop) {
+            break;
+        }
+
+        seen = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        pool_work(id);
+
+        pthread_mutex_lock(&pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    return NULL;
+}
+
+// Must be called with pool.run held
+static void pool_start(void)
+{
+    if (pool.threads == 0) {
+        pool.threads = pool_default_threads();
+    }
+
+    if (pool.started > 0 || pool.threads < 2) {
+        return;
+    }
+
+    pool.queues = calloc(pool.threads, sizeof(*pool.queues));
+    CHECK_NOT_NULL(pool.queues);
+
+    pool.workers = calloc(pool.threads, sizeof(*pool.workers));
+    CHECK_NOT_NULL(pool.workers);
+
+    for (size_t i = 0; i < pool.threads; i++) {
+        pthread_mutex_init(&pool.queues[i].lock, NULL);
+    }
+
+    pool.stop = false;
+    for (size_t i = 1; i < pool.threads; i++) {
+        if (pthread_create(&pool.workers[i], NULL, pool_worker, (void*)i) != 0) {
+            ERROR("could not spawn worker thread %zu", i);
+        }
+        pool.started++;
+    }
+}
+
+// Must be called with pool.run held
+static void pool_stop(void)
+{
+    if (pool.started == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    for (size_t i = 1; i <= pool.started; i++) {
+        pthread_join(pool.workers[i], NULL);
+    }
+
+    for (size_t i = 0; i < pool.threads; i++) {
+        pthread_mutex_destroy(&pool.queues[i].lock);
+    }
+
+    free(pool.workers);
+    free(pool.queues);
+    pool.workers = NULL;
+    pool.queues  = NULL;
+    pool.started = 0;
+}
+
+void pool_set_threads(size_t n)
+{
+    if (n > POOL_MAX_THREADS) {
+        WARNING("thread count capped to %d (asked %zu)", POOL_MAX_THREADS, n);
+        n = POOL_MAX_THREADS;
+    }
+
+    pthread_mutex_lock(&pool.run);
+    pool_stop();
+    pool.threads = n == 0 ? pool_default_threads() : n;
+    pthread_mutex_unlock(&pool.run);
+}
+
+size_t pool_threads(void)
+{
+    pthread_mutex_lock(&pool.run);
+    if (pool.threads == 0) {
+        pool.threads = pool_default_threads();
+    }
+    size_t n = pool.threads;
+    pthread_mutex_unlock(&pool.run);
+
+    return n;
+}
+
+void pool_run(pool_task_fn fn, void* arg, size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    if (in_pool || count == 1 || pthread_mutex_trylock(&pool.run) != 0) {
+        goto serial;
+    }
+
+    pool_start();
+
+    if (pool.started == 0) {
+        pthread_mutex_unlock(&pool.run);
+        goto serial;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.fn        = fn;
+    pool.arg       = arg;
+    pool.remaining = count;
+
+    // Deal contiguous ranges, the first count % threads queues get one more
+    size_t lo = 0;
+    for (size_t i = 0; i < pool.threads; i++) {
+        size_t len = count / pool.threads + (i < count % pool.threads);
+
+        pthread_mutex_lock(&pool.queues[i].lock);
+        pool.queues[i].lo = lo;
+        pool.queues[i].hi = lo + len;
+        pthread_mutex_unlock(&pool.queues[i].lock);
+
+        lo += len;
+    }
+
+    pool.generation++;
+    pthread_cond_broadcast(&pool.wake);
+    pthread_mutex_unlock(&pool.lock);
+
+    in_pool = true;
+    pool_work(0);
+    in_pool = false;
+
+    pthread_mutex_lock(&pool.lock);
+    while (pool.remaining > 0) {
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+
+    pthread_mutex_unlock(&pool.run);
+    return;
+
+serial:
+    for (size_t i = 0; i < count; i++) {
+        fn(arg, i);
+    }
+}
+
+void pool_shutdown(void)
+{
+    pthread_mutex_lock(&pool.run);
+    pool_stop();
+    pthread_mutex_unlock(&pool.run);
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+pool_graph_t* pool_graph_new(void)
+{
+    pool_graph_t* graph = calloc(1, sizeof(*graph));
+    CHECK_NOT_NULL(graph);
+
+    return graph;
+}
+
+// Adds a task calling fn(arg, index), returns its id
+size_t pool_graph_add(pool_graph_t* graph, pool_task_fn fn, void* arg, size_t index, size_t priority)
+{
+    CHECK_NOT_NULL(graph);
+
+    if (graph->count == graph->capacity) {
+        graph->capacity = graph->capacity == 0 ? 64 : 2 * graph->capacity;
+        graph->tasks    = realloc(graph->tasks, graph->capacity * sizeof(*graph->tasks));
+        CHECK_NOT_NULL(graph->tasks);
+    }
+
+    graph->tasks[graph->count] = (pool_graph_task_t){ .fn = fn, .arg = arg, .index = index, .priority = priority };
+    return graph->count++;
+}
+
+// task only starts once on is done
+void pool_graph_depend(pool_graph_t* graph, size_t task, size_t on)
+{
+    CHECK_NOT_NULL(graph);
+
+    if (task >= graph->count || on >= graph->count) {
+        ERROR("no such task (task=%zu, on=%zu, count=%zu)", task, on, graph->count);
+    }
+
+    if (graph->edge_count == graph->edge_capacity) {
+        graph->edge_capacity = graph->edge_capacity == 0 ? 64 : 2 * graph->edge_capacity;
+        graph->edges         = realloc(graph->edges, graph->edge_capacity * sizeof(*graph->edges));
+        CHECK_NOT_NULL(graph->edges);
+    }
+
+    graph->edges[graph->edge_count][0] = task;
+    graph->edges[graph->edge_count][1] = on;
+    graph->edge_count++;
+}
+
+// The state of a graph being run, shared by the threads running it
+typedef struct pool_graph_run {
+    pool_graph_t* graph;
+
+    pthread_mutex_t lock;
+    pthread_cond_t  wake;
+
+    // The dependents of task t are next[first[t]] to next[first[t + 1]]
+    size_t* first;
+    size_t* next;
+
+    // The dependencies of each task not done yet
+    size_t* pending;
+
+    // The ready tasks, a binary heap on (priority, id)
+    size_t* ready;
+    size_t  ready_count;
+
+    // Tasks taken and not done yet, and tasks done
+    size_t running;
+    size_t done;
+} pool_graph_run_t;
+
+static bool pool_graph_before(pool_graph_t* graph, size_t x, size_t y)
+{
+    size_t px = graph->tasks[x].priority;
+    size_t py = graph->tasks[y].priority;
+
+    return px < py || (px == py && x < y);
+}
+
+static void pool_graph_push(pool_graph_run_t* run, size_t task)
+{
+    size_t i = run->ready_count++;
+
+    while (i > 0 && pool_graph_before(run->graph, task, run->ready[(i - 1) / 2])) {
+        run->ready[i] = run->ready[(i - 1) / 2];
+        i             = (i - 1) / 2;
+    }
+
+    run->ready[i] = task;
+}
+
+static size_t pool_graph_pop(pool_graph_run_t* run)
+{
+    size_t top  = run->ready[0];
+    size_t last = run->ready[--run->ready_count];
+    size_t i    = 0;
+
+    for (;;) {
+        size_t c = 2 * i + 1;
+
+        if (c >= run->ready_count) {
+            break;
+        }
+
+        if (c + 1 < run->ready_count && pool_graph_before(run->graph, run->ready[c + 1], run->ready[c])) {
+            c++;
+        }
+
+        if (!pool_graph_before(run->graph, run->ready[c], last)) {
+            break;
+        }
+
+        run->ready[i] = run->ready[c];
+        i             = c;
+    }
+
+    run->ready[i] = last;
+    return top;
+}
+
+// Every thread of the batch takes ready tasks until the whole graph is done,
+// waiting while the tasks it depends on are still running elsewhere
+static void pool_graph_worker(void* arg, size_t index)
+{
+    pool_graph_run_t* run   = arg;
+    size_t            count = run->graph->count;
+
+    (void)index;
+
+    pthread_mutex_lock(&run->lock);
+
+    for (;;) {
+        while (run->ready_count == 0 && run->done < count) {
+            // Nothing ready and nothing left to make anything ready
+            if (run->running == 0) {
+                ERROR_MESSAGE("task graph has a cycle");
+            }
+
+            pthread_cond_wait(&run->wake, &run->lock);
+        }
+
+        if (run->done == count) {
+            break;
+        }
+
+        size_t             id   = pool_graph_pop(run);
+        pool_graph_task_t* task = &run->graph->tasks[id];
+
+        run->running++;
+        pthread_mutex_unlock(&run->lock);
+        task->fn(task->arg, task->index);
+        pthread_mutex_lock(&run->lock);
+
+        size_t woken = 0;
+
+        for (size_t e = run->first[id]; e < run->first[id + 1]; e++) {
+            if (--run->pending[run->next[e]] == 0) {
+                pool_graph_push(run, run->next[e]);
+                woken++;
+            }
+        }
+
+        run->running--;
+
+        if (++run->done == count || woken > 1) {
+            pthread_cond_broadcast(&run->wake);
+        } else if (woken == 1) {
+            pthread_cond_signal(&run->wake);
+        }
+    }
+
+    pthread_mutex_unlock(&run->lock);
+}
+
+// Runs every task of the graph, on the pool when it has several threads,
+// and returns once they are all done. The graph must be acyclic, it can be
+// run again afterwards.
+void pool_graph_run(pool_graph_t* graph)
+{
+    CHECK_NOT_NULL(graph);
+
+    size_t n = graph->count;
+
+    if (n == 0) {
+        return;
+    }
+
+    pool_graph_run_t run = { .graph = graph };
+
+    run.first   = calloc(n + 1, sizeof(size_t));
+    run.next    = malloc(graph->edge_count * sizeof(size_t) + 1);
+    run.pending = calloc(n, sizeof(size_t));
+    run.ready   = malloc(n * sizeof(size_t));
+    CHECK_NOT_NULL(run.first);
+    CHECK_NOT_NULL(run.next);
+    CHECK_NOT_NULL(run.pending);
+    CHECK_NOT_NULL(run.ready);
+
+    // Dependents grouped by the task they wait on
+    for (size_t e = 0; e < graph->edge_count; e++) {
+        run.first[graph->edges[e][1] + 1]++;
+        run.pending[graph->edges[e][0]]++;
+    }
+
+    for (size_t t = 0; t < n; t++) {
+        run.first[t + 1] += run.first[t];
+    }
+
+    size_t* fill = malloc(n * sizeof(size_t));
+    CHECK_NOT_NULL(fill);
+
+    for (size_t t = 0; t < n; t++) {
+        fill[t] = run.first[t];
+    }
+
+    for (size_t e = 0; e < graph->edge_count; e++) {
+        run.next[fill[graph->edges[e][1]]++] = graph->edges[e][0];
+    }
+
+    free(fill);
+
+    for (size_t t = 0; t < n; t++) {
+        if (run.pending[t] == 0) {
+            pool_graph_push(&run, t);
+        }
+    }
+
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_cond_init(&run.wake, NULL);
+
+    // One worker per thread. When the batch runs serially the first one
+    // does everything, the others find the graph done.
+    pool_run(pool_graph_worker, &run, pool_threads());
+
+    pthread_cond_destroy(&run.wake);
+    pthread_mutex_destroy(&run.lock);
+
+    free(run.ready);
+    free(run.pending);
+    free(run.next);
+    free(run.first);
+}
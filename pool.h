@@ -0,0 +1,67 @@
+#ifndef TD_POOL_H
+#define TD_POOL_H
+
+#include <stddef.h>
+#include <stdlib.h>
+
+// A task body, called once for every index of a pool_run batch
+typedef void (*pool_task_fn)(void* arg, size_t index);
+
+// Sets the number of threads used by the pool, the calling thread included.
+// 0 selects the number of online processors, 1 makes every batch serial.
+// Running workers are joined and respawned lazily on the next batch.
+void pool_set_threads(size_t n);
+
+// The number of threads a batch is currently split across
+size_t pool_threads(void);
+
+// Calls fn(arg, i) for every i in [0, count) and returns once all of them
+// are done. Indices are dealt in contiguous ranges to every thread, and idle
+// threads steal half of the remaining range of a busy one, which evens out
+// tasks of very unequal cost. Batches issued from inside a task, or while
+// another thread owns the pool, run serially on the calling thread.
+void pool_run(pool_task_fn fn, void* arg, size_t count);
+
+// Joins the worker threads. The pool restarts on the next batch.
+void pool_shutdown(void);
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+typedef struct pool_graph_task {
+    pool_task_fn fn;
+    void*        arg;
+    size_t       index;
+
+    // Among the tasks ready to run, the lowest priority goes first
+    size_t priority;
+} pool_graph_task_t;
+
+// A graph of tasks, each of which runs once the tasks it depends on are
+// done. The pool threads take ready tasks as they come, so that independent
+// branches of the graph overlap, and priorities let the critical path go
+// first.
+typedef struct pool_graph {
+    pool_graph_task_t* tasks;
+    size_t             count;
+    size_t             capacity;
+
+    // Dependencies as (task, on) pairs
+    size_t (*edges)[2];
+    size_t edge_count;
+    size_t edge_capacity;
+} pool_graph_t;
+
+#define pool_graph_delete(graph)  \
+    if ((graph) != NULL) {        \
+        free((graph)->tasks);     \
+        free((graph)->edges);     \
+        free(graph);              \
+        (graph) = NULL;           \
+    }
+
+pool_graph_t* pool_graph_new(void);
+size_t        pool_graph_add(pool_graph_t* graph, pool_task_fn fn, void* arg, size_t index, size_t priority);
+void          pool_graph_depend(pool_graph_t* graph, size_t task, size_t on);
+void          pool_graph_run(pool_graph_t* graph);
+
+#endif /* pool.h */
@@ -1,94 +1,310 @@
 #include "scalar.h"
+#include "alloc.h"
+#include "bignum.h"
+#include "decimal.h"
+#include "gcd.h"
 #include "utils.h"
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 
-scalar_t zero = (scalar_t){ .negative = false, .a = 0, .b = 1 };
+// The heap side of a promoted scalar, magnitudes in lowest terms
+typedef struct scalar_big {
+    bool     negative;
+    bignum_t a;
+    bignum_t b;
+} scalar_big_t;
 
-scalar_t one = (scalar_t){ .negative = false, .a = 1, .b = 1 };
+#define scalar_big(scalar) ((scalar_big_t*)(uintptr_t)(scalar)->num)
 
-#define scalar_cpy(dst, src)           \
-    {                                  \
-        dst->negative = src->negative; \
-        dst->a        = src->a;        \
-        dst->b        = src->b;        \
+#define scalar_big_is_integer(big) (bignum_fits_u64(&(big)->b) && bignum_to_u64(&(big)->b) == 1)
+
+// The magnitude of an inline numerator. Inline numerators never reach
+// INT64_MIN, so negating them is always safe.
+#define scalar_mag(scalar) ((scalar)->num < 0 ? -(uint64_t)(scalar)->num : (uint64_t)(scalar)->num)
+
+_Static_assert(sizeof(scalar_t) == 16, "scalar_t must pack into 16 bytes");
+
+const scalar_t zero = (scalar_t){ .num = 0, .den = 1 };
+
+const scalar_t one = (scalar_t){ .num = 1, .den = 1 };
+
+static scalar_status_t scalar_store(scalar_t* result, bignum_t* a, bignum_t* b, bool negative);
+
+// Stores a / b in result when it fits inline, the fraction must be in
+// lowest terms already. Only called on inline operands, so a promoted result
+// never aliases them and can be released first.
+static inline scalar_status_t scalar_set(scalar_t* result, uint128_t a, uint128_t b, bool negative)
+{
+    if (a > INT64_MAX || b > UINT64_MAX) {
+        return SCALAR_OVERFLOW;
+    }
+
+    if (scalar_is_big(result)) {
+        scalar_clear(result);
+    }
+
+    result->num = negative ? -(int64_t)a : (int64_t)a;
+    result->den = a == 0 ? 1 : (uint64_t)b;
+
+    return SCALAR_OK;
+}
+
+// Same as scalar_set, promoting the result when it doesn't fit
+static scalar_status_t scalar_set_wide(scalar_t* result, uint128_t a, uint128_t b, bool negative)
+{
+    if (scalar_set(result, a, b, negative) == SCALAR_OK) {
+        return SCALAR_OK;
     }
 
-static uint64_t uint64_gcd(uint64_t a, uint64_t b)
+    bignum_t x = BIGNUM_INIT, y = BIGNUM_INIT;
+
+    bignum_set_u128(&x, a);
+    bignum_set_u128(&y, b);
+
+    return scalar_store(result, &x, &y, negative);
+}
+
+// The value a / b, negated if negative set, in lowest terms. A result that
+// doesn't fit the inline form is promoted and must be cleared by the caller.
+scalar_t scalar_make(uint64_t a, uint64_t b, bool negative)
 {
-    uint64_t r;
+    if (b == 0) {
+        ERROR_MESSAGE("division by 0");
+    }
+
+    scalar_t scalar = zero;
 
-    while (b != 0) {
-        r = a % b;
-        a = b;
-        b = r;
+    // Kernels rely on operands being in lowest terms
+    if (a != 0) {
+        uint64_t g = uint64_gcd(a, b);
+        scalar_set_wide(&scalar, a / g, b / g, negative);
     }
 
-    return a;
+    return scalar;
+}
+
+scalar_t scalar_of(int64_t n)
+{
+    return scalar_make(n >= 0 ? (uint64_t)n : -(uint64_t)n, 1, n < 0);
 }
 
-static uint64_t uint64_lcm(uint64_t a, uint64_t b)
+scalar_t* scalar_new(uint64_t a, uint64_t b, bool negative)
+{
+    scalar_t  value  = scalar_make(a, b, negative);
+    scalar_t* scalar = alloc_new(sizeof(*scalar));
+
+    *scalar = value;
+    return scalar;
+}
+
+scalar_t* scalar_from(int64_t n)
 {
-    return (a * b) / uint64_gcd(a, b);
+    return scalar_new(n >= 0 ? (uint64_t)n : -(uint64_t)n, 1, n < 0);
 }
 
-static void scalar_norm(scalar_t* scalar)
+void scalar_clear(scalar_t* scalar)
 {
     CHECK_NOT_NULL(scalar);
 
-    if (scalar->a == 0 || scalar->b == 1) {
-        return;
+    if (scalar_is_big(scalar)) {
+        scalar_big_t* big = scalar_big(scalar);
+        bignum_clear(&big->a);
+        bignum_clear(&big->b);
+        free(big);
     }
 
-    if (scalar->a == scalar->b) {
-        scalar->a = 1;
-        scalar->b = 1;
-        return;
+    *scalar = zero;
+}
+
+void scalar_clear_all(scalar_t* items, size_t n)
+{
+    for (size_t i = 0; i < n; i++) {
+        if (scalar_is_big(&items[i])) {
+            scalar_clear(&items[i]);
+        }
+    }
+}
+
+bool scalar_is_negative(const scalar_t* scalar)
+{
+    CHECK_NOT_NULL(scalar);
+    return scalar_is_big(scalar) ? scalar_big(scalar)->negative : scalar->num < 0;
+}
+
+void scalar_get_bignum(const scalar_t* scalar, bignum_t* a, bignum_t* b)
+{
+    CHECK_NOT_NULL(scalar);
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
+
+    if (scalar_is_big(scalar)) {
+        bignum_copy(a, &scalar_big(scalar)->a);
+        bignum_copy(b, &scalar_big(scalar)->b);
+    } else {
+        bignum_set_u64(a, scalar_mag(scalar));
+        bignum_set_u64(b, scalar->den);
     }
+}
 
-    uint64_t gcd = uint64_gcd(scalar->a, scalar->b);
+// Stores a / b in result, taking ownership of a and b which must be in
+// lowest terms. The value is demoted to the inline form whenever it fits.
+// Operands are always read before this is called, so result may alias them.
+static scalar_status_t scalar_store(scalar_t* result, bignum_t* a, bignum_t* b, bool negative)
+{
+    scalar_clear(result);
 
-    if (gcd == 1) {
-        return;
+    if (bignum_is_zero(a) || (bignum_bits(a) < 64 && bignum_fits_u64(b))) {
+        scalar_set(result, bignum_to_u64(a), bignum_to_u64(b), negative);
+
+        bignum_clear(a);
+        bignum_clear(b);
+        return SCALAR_OK;
     }
 
-    scalar->a /= gcd;
-    scalar->b /= gcd;
+    scalar_big_t* big = malloc(sizeof(*big));
+    CHECK_NOT_NULL(big);
+
+    big->negative = negative;
+    big->a        = *a;
+    big->b        = *b;
+
+    result->num = (int64_t)(uintptr_t)big;
+    result->den = 0;
+
+    return SCALAR_OVERFLOW;
 }
 
-scalar_t* scalar_new(uint64_t a, uint64_t b, bool negative)
+scalar_status_t scalar_set_bignum(scalar_t* result, bignum_t* a, bignum_t* b, bool negative)
 {
-    scalar_t* scalar = malloc(sizeof(*scalar));
-    CHECK_NOT_NULL(scalar);
+    CHECK_NOT_NULL(result);
+    CHECK_NOT_NULL(a);
+    CHECK_NOT_NULL(b);
 
-    scalar->negative = negative;
+    if (bignum_is_zero(b)) {
+        ERROR_MESSAGE("division by 0");
+    }
 
-    scalar->a = a;
-    scalar->b = b;
+    bignum_t x = BIGNUM_INIT, y = BIGNUM_INIT, g = BIGNUM_INIT;
 
-    return scalar;
+    bignum_gcd(&g, a, b);
+    bignum_divmod(&x, NULL, a, &g);
+    bignum_divmod(&y, NULL, b, &g);
+    bignum_clear(&g);
+
+    return scalar_store(result, &x, &y, negative);
 }
 
-scalar_t* scalar_from(int64_t n)
+scalar_status_t scalar_set_int128(scalar_t* result, __int128 n)
 {
-    return scalar_new(n >= 0 ? n : -n, 1, n < 0);
+    CHECK_NOT_NULL(result);
+
+    bool negative = n < 0;
+
+    return scalar_set_wide(result, negative ? -(uint128_t)n : (uint128_t)n, 1, negative);
 }
 
-void scalar_copy(scalar_t* dst, scalar_t* src)
+void scalar_copy(scalar_t* dst, const scalar_t* src)
 {
     CHECK_NOT_NULL(dst);
     CHECK_NOT_NULL(src);
-    scalar_cpy(dst, src);
+
+    if (dst == src) {
+        return;
+    }
+
+    if (!scalar_is_big(src)) {
+        if (scalar_is_big(dst)) {
+            scalar_clear(dst);
+        }
+        *dst = *src;
+        return;
+    }
+
+    bignum_t a = BIGNUM_INIT, b = BIGNUM_INIT;
+    scalar_get_bignum(src, &a, &b);
+    scalar_store(dst, &a, &b, scalar_big(src)->negative);
 }
 
-scalar_t* scalar_duplicate(scalar_t* scalar)
+scalar_t* scalar_duplicate(const scalar_t* scalar)
 {
-    scalar_t* duplicate = malloc(sizeof(*duplicate));
+    scalar_t* duplicate = alloc_new(sizeof(*duplicate));
+
+    *duplicate = zero;
     scalar_copy(duplicate, scalar);
     return duplicate;
 }
 
-scalar_cmp_t scalar_compare(scalar_t* x, scalar_t* y)
+// The two top limbs of a nonzero x as a double: x ~ top . 2^shift
+static double scalar_big_top(const bignum_t* x, int* shift)
+{
+    double top = (double)x->limbs[x->size - 1];
+
+    if (x->size > 1) {
+        top += (double)x->limbs[x->size - 2] * 0x1p-64;
+    }
+
+    *shift = 64 * (int)(x->size - 1);
+    return top;
+}
+
+// The nearest double, up to a couple of roundings. Promoted values go
+// through the leading limbs of their terms, so they can't overflow before
+// the final scaling.
+double scalar_to_double(const scalar_t* scalar)
+{
+    CHECK_NOT_NULL(scalar);
+
+    if (!scalar_is_big(scalar)) {
+        return (double)scalar->num / (double)scalar->den;
+    }
+
+    scalar_big_t* big = scalar_big(scalar);
+
+    int    sa, sb;
+    double q = scalar_big_top(&big->a, &sa) / scalar_big_top(&big->b, &sb);
+
+    q = ldexp(q, sa - sb);
+    return big->negative ? -q : q;
+}
+
+// Compares |x| and |y| when either of them is promoted
+static int scalar_compare_big(const scalar_t* x, const scalar_t* y)
+{
+    bignum_t xa = BIGNUM_INIT, xb = BIGNUM_INIT, ya = BIGNUM_INIT, yb = BIGNUM_INIT;
+
+    scalar_get_bignum(x, &xa, &xb);
+    scalar_get_bignum(y, &ya, &yb);
+
+    bignum_mul(&xa, &xa, &yb);
+    bignum_mul(&ya, &ya, &xb);
+
+    int cmp = bignum_cmp(&xa, &ya);
+
+    bignum_clear(&xa);
+    bignum_clear(&xb);
+    bignum_clear(&ya);
+    bignum_clear(&yb);
+
+    return cmp;
+}
+
+int scalar_compare_abs(const scalar_t* x, const scalar_t* y)
+{
+    CHECK_NOT_NULL(x);
+    CHECK_NOT_NULL(y);
+
+    if (scalar_is_big(x) || scalar_is_big(y)) {
+        return scalar_compare_big(x, y);
+    }
+
+    uint128_t xx = (uint128_t)scalar_mag(x) * y->den;
+    uint128_t yy = (uint128_t)scalar_mag(y) * x->den;
+
+    return (xx > yy) - (xx < yy);
+}
+
+scalar_cmp_t scalar_compare(const scalar_t* x, const scalar_t* y)
 {
     if (x == y) {
         return EQ;
@@ -98,334 +314,763 @@ scalar_cmp_t scalar_compare(scalar_t* x, scalar_t* y)
         return NE;
     }
 
-    if (x->a == 0 && y->a == 0) {
-        return EQ;
-    }
+    // Inline values compare by signed cross multiplication: |num| < 2^63
+    // and den < 2^64, so both products fit in 128 bits
+    if (!scalar_is_big(x) && !scalar_is_big(y)) {
+        int128_t xx = (int128_t)x->num * y->den;
+        int128_t yy = (int128_t)y->num * x->den;
 
-    if (x->negative && !y->negative) {
-        return LT;
+        return xx == yy ? EQ : xx > yy ? GT : LT;
     }
 
-    if (!x->negative && y->negative) {
-        return GT;
-    }
+    bool negative = scalar_is_negative(x);
 
-    if (x->b == y->b) {
-        return x->a > y->a
-            ? GT
-            : x->a == y->a
-                ? EQ
-                : LT;
+    if (negative != scalar_is_negative(y)) {
+        return negative ? LT : GT;
     }
 
-    uint64_t lcm = uint64_lcm(x->b, y->b);
-
-    uint64_t mx = lcm / x->b;
-    uint64_t xx = mx * x->a;
+    // Same sign: compare magnitudes, and flip the outcome for negative
+    // numbers
+    int cmp = scalar_compare_big(x, y);
 
-    uint64_t my = lcm / y->b;
-    uint64_t yy = my * y->a;
+    if (cmp == 0) {
+        return EQ;
+    }
 
-    return xx > yy
-        ? GT
-        : xx == yy
-            ? EQ
-            : LT;
+    return (cmp > 0) != negative ? GT : LT;
 }
 
-bool scalar_equals(scalar_t* x, scalar_t* y)
+bool scalar_equals(const scalar_t* x, const scalar_t* y)
 {
     return scalar_compare(x, y) == EQ;
 }
 
-bool scalar_greater_equal(scalar_t* x, scalar_t* y)
+bool scalar_greater_equal(const scalar_t* x, const scalar_t* y)
 {
     scalar_cmp_t cmp = scalar_compare(x, y);
     return cmp == GT || cmp == EQ;
 }
 
-bool scalar_greater_than(scalar_t* x, scalar_t* y)
+bool scalar_greater_than(const scalar_t* x, const scalar_t* y)
 {
     return scalar_compare(x, y) == GT;
 }
 
-bool scalar_less_equal(scalar_t* x, scalar_t* y)
+bool scalar_less_equal(const scalar_t* x, const scalar_t* y)
 {
     scalar_cmp_t cmp = scalar_compare(x, y);
     return cmp == LT || cmp == EQ;
 }
 
-bool scalar_less_than(scalar_t* x, scalar_t* y)
+bool scalar_less_than(const scalar_t* x, const scalar_t* y)
 {
     return scalar_compare(x, y) == LT;
 }
 
-void scalar_opposite(scalar_t* result, scalar_t* scalar)
+void scalar_opposite(scalar_t* result, const scalar_t* scalar)
 {
     CHECK_NOT_NULL(result);
     CHECK_NOT_NULL(scalar);
-    scalar_cpy(result, scalar);
-    result->negative = !result->negative;
+
+    scalar_copy(result, scalar);
+
+    if (scalar_is_big(result)) {
+        scalar_big(result)->negative = !scalar_big(result)->negative;
+    } else {
+        result->num = -result->num;
+    }
 }
 
-void scalar_abs(scalar_t* result, scalar_t* scalar)
+void scalar_abs(scalar_t* result, const scalar_t* scalar)
 {
     CHECK_NOT_NULL(result);
     CHECK_NOT_NULL(scalar);
-    scalar_cpy(result, scalar);
-    result->negative = false;
+
+    scalar_copy(result, scalar);
+
+    if (scalar_is_big(result)) {
+        scalar_big(result)->negative = false;
+    } else if (result->num < 0) {
+        result->num = -result->num;
+    }
 }
 
-void scalar_inverse(scalar_t* result, scalar_t* scalar)
+void scalar_inverse(scalar_t* result, const scalar_t* scalar)
 {
     CHECK_NOT_NULL(result);
     CHECK_NOT_NULL(scalar);
 
-    if (scalar->a == 0) {
+    if (scalar->num == 0) {
         ERROR_MESSAGE(" division by 0");
     }
 
-    result->negative = scalar->negative;
+    if (scalar_is_big(scalar)) {
+        bignum_t a = BIGNUM_INIT, b = BIGNUM_INIT;
+        scalar_get_bignum(scalar, &b, &a);
+        scalar_store(result, &a, &b, scalar_big(scalar)->negative);
+        return;
+    }
+
+    // A denominator above INT64_MAX promotes when it becomes the numerator
+    scalar_set_wide(result, scalar->den, scalar_mag(scalar), scalar->num < 0);
+}
+
+// a1/b1 + a2/b2 on promoted operands, y taken with its sign flipped when
+// opposite is set
+__attribute__((cold)) static scalar_status_t scalar_add_big(scalar_t* result, const scalar_t* x, const scalar_t* y, bool opposite)
+{
+    bignum_t xa = BIGNUM_INIT, xb = BIGNUM_INIT, ya = BIGNUM_INIT, yb = BIGNUM_INIT, g = BIGNUM_INIT;
+
+    bool x_negative = scalar_is_negative(x);
+    bool y_negative = scalar_is_negative(y) != opposite;
+    bool negative;
 
-    result->a = scalar->b;
-    result->b = scalar->a;
+    scalar_get_bignum(x, &xa, &xb);
+    scalar_get_bignum(y, &ya, &yb);
 
-    scalar_norm(result);
+    bignum_mul(&xa, &xa, &yb);
+    bignum_mul(&ya, &ya, &xb);
+    bignum_mul(&xb, &xb, &yb);
+
+    if (x_negative == y_negative) {
+        bignum_add(&xa, &xa, &ya);
+        negative = x_negative;
+    } else if (bignum_cmp(&xa, &ya) >= 0) {
+        bignum_sub(&xa, &xa, &ya);
+        negative = x_negative;
+    } else {
+        bignum_sub(&xa, &ya, &xa);
+        negative = y_negative;
+    }
+
+    if (!bignum_is_zero(&xa)) {
+        bignum_gcd(&g, &xa, &xb);
+        bignum_divmod(&xa, NULL, &xa, &g);
+        bignum_divmod(&xb, NULL, &xb, &g);
+    }
+
+    bignum_clear(&ya);
+    bignum_clear(&yb);
+    bignum_clear(&g);
+
+    return scalar_store(result, &xa, &xb, negative);
 }
 
-void scalar_scale(scalar_t* result, scalar_t* scalar, uint64_t n, bool negative)
+// x . y on promoted operands, or x / y when inverse is set
+__attribute__((cold)) static scalar_status_t scalar_mul_big(scalar_t* result, const scalar_t* x, const scalar_t* y, bool inverse)
 {
-    CHECK_NOT_NULL(result);
-    CHECK_NOT_NULL(scalar);
+    bignum_t xa = BIGNUM_INIT, xb = BIGNUM_INIT, ya = BIGNUM_INIT, yb = BIGNUM_INIT, g = BIGNUM_INIT;
 
-    scalar_cpy(result, scalar);
+    bool negative = scalar_is_negative(x) != scalar_is_negative(y);
 
-    if ((result->negative && negative) || (!result->negative && !negative)) {
-        result->negative = false;
+    scalar_get_bignum(x, &xa, &xb);
+
+    if (inverse) {
+        scalar_get_bignum(y, &yb, &ya);
     } else {
-        result->negative = true;
+        scalar_get_bignum(y, &ya, &yb);
     }
 
-    result->a *= n;
-    scalar_norm(result);
+    // Same cross-cancellation as the inline path
+    bignum_gcd(&g, &xa, &yb);
+    bignum_divmod(&xa, NULL, &xa, &g);
+    bignum_divmod(&yb, NULL, &yb, &g);
+
+    bignum_gcd(&g, &ya, &xb);
+    bignum_divmod(&ya, NULL, &ya, &g);
+    bignum_divmod(&xb, NULL, &xb, &g);
+
+    bignum_mul(&xa, &xa, &ya);
+    bignum_mul(&xb, &xb, &yb);
+
+    bignum_clear(&ya);
+    bignum_clear(&yb);
+    bignum_clear(&g);
+
+    return scalar_store(result, &xa, &xb, negative);
 }
 
-void scalar_add(scalar_t* result, scalar_t* x, scalar_t* y)
+scalar_status_t scalar_scale(scalar_t* result, const scalar_t* scalar, uint64_t n, bool negative)
 {
     CHECK_NOT_NULL(result);
-    CHECK_NOT_NULL(x);
-    CHECK_NOT_NULL(y);
+    CHECK_NOT_NULL(scalar);
 
-    uint64_t xx = x->a;
-    uint64_t yy = y->a;
+    if (n == 0) {
+        scalar_clear(result);
+        return SCALAR_OK;
+    }
 
-    if (xx == 0 && yy == 0) {
-        result->a = 0;
-        return;
+    if (!scalar_is_big(scalar)) {
+        // Cancel n against the denominator before multiplying
+        uint64_t g = uint64_gcd(n, scalar->den);
+
+        if (scalar_set(result, (uint128_t)scalar_mag(scalar) * (n / g), scalar->den / g, (scalar->num < 0) != negative)
+            == SCALAR_OK) {
+            return SCALAR_OK;
+        }
     }
 
-    // Copy LHS initial sign
-    result->negative = x->negative;
+    // n itself may not fit an inline numerator
+    scalar_t        factor = scalar_make(n, 1, negative);
+    scalar_status_t status = scalar_mul_big(result, scalar, &factor, false);
 
-    if (x->b == y->b) {
-    same_denominator:
-        if (xx > yy) {
-            if (y->negative) {
-                result->a = xx - yy;
-                goto norm;
-            }
+    scalar_clear(&factor);
+    return status;
+}
+
+// Inline x + y, or x - y when opposite is set. Returns SCALAR_OVERFLOW
+// without touching result if the sum has to be promoted.
+__attribute__((always_inline)) static inline scalar_status_t scalar_add_small(scalar_t* result, const scalar_t* x, const scalar_t* y, bool opposite)
+{
+    // Integers add in place, INT64_MIN is left to the promotion path
+    if (x->den == 1 && y->den == 1) {
+        int64_t n;
 
-            result->a = xx + yy;
-            goto norm;
+        if ((opposite ? __builtin_sub_overflow(x->num, y->num, &n) : __builtin_add_overflow(x->num, y->num, &n))
+            || n == INT64_MIN) {
+            return SCALAR_OVERFLOW;
         }
 
-        if (xx < yy) {
-            if (y->negative) {
-                result->negative = true;
-                result->a        = yy - xx;
-                goto norm;
-            }
-
-            if (x->negative) {
-                result->negative = false;
-                result->a        = yy - xx;
-                goto norm;
-            }
-
-            result->a = xx + yy;
-            goto norm;
+        if (scalar_is_big(result)) {
+            scalar_clear(result);
         }
 
-        // xx == yy
-        result->a = xx * 2;
-        goto norm;
+        result->num = n;
+        result->den = 1;
+        return SCALAR_OK;
     }
 
-    uint64_t lcm = uint64_lcm(x->b, y->b);
+    // With g = gcd(b1, b2), a1/b1 + a2/b2 = (a1.(b2/g) + a2.(b1/g)) / lcm, and
+    // since both operands are in lowest terms, the only common factor the
+    // numerator can share with the lcm divides g. Everything is computed on
+    // 128 bits, so only the reduced result has to fit in 64.
+    uint64_t g  = x->den == y->den ? x->den : uint64_gcd(x->den, y->den);
+    uint64_t bx = x->den / g;
+    uint64_t by = y->den / g;
 
-    uint64_t mx = lcm / x->b;
-    uint64_t my = lcm / y->b;
+    int128_t xx = (int128_t)x->num * by;
+    int128_t yy = (int128_t)y->num * bx;
+    int128_t s;
 
-    xx = mx * x->a;
-    yy = my * y->a;
+    if (opposite ? __builtin_sub_overflow(xx, yy, &s) : __builtin_add_overflow(xx, yy, &s)) {
+        return SCALAR_OVERFLOW;
+    }
+
+    if (s == 0) {
+        return scalar_set(result, 0, 1, false);
+    }
 
-    result->b = lcm;
-    goto same_denominator;
+    bool      negative = s < 0;
+    uint128_t a        = negative ? -(uint128_t)s : (uint128_t)s;
 
-norm:
-    scalar_norm(result);
+    if (g == 1) {
+        return scalar_set(result, a, (uint128_t)bx * y->den, negative);
+    }
+
+    uint64_t r = uint64_gcd(a <= UINT64_MAX ? (uint64_t)a : (uint64_t)(a % g), g);
+
+    return scalar_set(result, a / r, (uint128_t)bx * by * (g / r), negative);
 }
 
-void scalar_sub(scalar_t* result, scalar_t* x, scalar_t* y)
+scalar_status_t scalar_add(scalar_t* result, const scalar_t* x, const scalar_t* y)
 {
     CHECK_NOT_NULL(result);
     CHECK_NOT_NULL(x);
     CHECK_NOT_NULL(y);
-    scalar_opposite(y, y);
-    scalar_add(result, x, y);
-    scalar_opposite(y, y);
+
+    if (!scalar_is_big(x) && !scalar_is_big(y) && scalar_add_small(result, x, y, false) == SCALAR_OK) {
+        return SCALAR_OK;
+    }
+
+    return scalar_add_big(result, x, y, false);
 }
 
-void scalar_mul(scalar_t* result, scalar_t* x, scalar_t* y)
+scalar_status_t scalar_sub(scalar_t* result, const scalar_t* x, const scalar_t* y)
 {
     CHECK_NOT_NULL(result);
     CHECK_NOT_NULL(x);
     CHECK_NOT_NULL(y);
 
-    scalar_cpy(result, x);
+    if (!scalar_is_big(x) && !scalar_is_big(y) && scalar_add_small(result, x, y, true) == SCALAR_OK) {
+        return SCALAR_OK;
+    }
 
-    result->a *= y->a;
-    result->b *= y->b;
+    return scalar_add_big(result, x, y, true);
+}
 
+// Inline x . y, or x / y when inverse is set. Returns SCALAR_OVERFLOW
+// without touching result if the product has to be promoted.
+__attribute__((always_inline)) static inline scalar_status_t scalar_mul_small(scalar_t* result, const scalar_t* x, const scalar_t* y, bool inverse)
+{
     // sign of the result is sign(x) XOR sign(y)
-    result->negative = x->negative ^ y->negative;
+    bool     negative = (x->num < 0) != (y->num < 0);
+    uint64_t xa       = scalar_mag(x);
+    uint64_t ya       = inverse ? y->den : scalar_mag(y);
+    uint64_t yb       = inverse ? scalar_mag(y) : y->den;
+
+    if (x->den == 1 && yb == 1) {
+        return scalar_set(result, (uint128_t)xa * ya, 1, negative);
+    }
+
+    // Cross-cancellation: reducing a1 against b2 and a2 against b1 leaves a
+    // product in lowest terms, built from smaller factors. Both gcds have a
+    // denominator as an operand, so they are at least 1; a zero factor just
+    // gives a zero numerator, which scalar_set stores as 0/1.
+    uint64_t g1 = uint64_gcd(xa, yb);
+    uint64_t g2 = uint64_gcd(ya, x->den);
+
+    uint128_t a = (uint128_t)(xa / g1) * (ya / g2);
+    uint128_t b = (uint128_t)(x->den / g2) * (yb / g1);
 
-    scalar_norm(result);
+    return scalar_set(result, a, b, negative);
 }
 
-void scalar_div(scalar_t* result, scalar_t* x, scalar_t* y)
+scalar_status_t scalar_mul(scalar_t* result, const scalar_t* x, const scalar_t* y)
 {
     CHECK_NOT_NULL(result);
     CHECK_NOT_NULL(x);
     CHECK_NOT_NULL(y);
 
-    if (y->a == 0) {
+    if (!scalar_is_big(x) && !scalar_is_big(y)) {
+        if (scalar_mul_small(result, x, y, false) == SCALAR_OK) {
+            return SCALAR_OK;
+        }
+    } else if (x->num == 0 || y->num == 0) {
+        scalar_clear(result);
+        return SCALAR_OK;
+    }
+
+    return scalar_mul_big(result, x, y, false);
+}
+
+scalar_status_t scalar_div(scalar_t* result, const scalar_t* x, const scalar_t* y)
+{
+    CHECK_NOT_NULL(result);
+    CHECK_NOT_NULL(x);
+    CHECK_NOT_NULL(y);
+
+    if (y->num == 0) {
         ERROR_MESSAGE("division by 0");
     }
 
-    scalar_inverse(y, y);
-    scalar_mul(result, x, y);
-    scalar_inverse(y, y);
+    if (!scalar_is_big(x) && !scalar_is_big(y)) {
+        if (scalar_mul_small(result, x, y, true) == SCALAR_OK) {
+            return SCALAR_OK;
+        }
+    } else if (x->num == 0) {
+        scalar_clear(result);
+        return SCALAR_OK;
+    }
+
+    return scalar_mul_big(result, x, y, true);
 }
 
-scalar_t* scalar_opposite_get(scalar_t* scalar)
+// The *_val variants return the result by value, without any allocation
+// unless it has to be promoted, in which case the caller clears it as any
+// other temporary. The *_get ones put it in a block of the current allocator.
+scalar_t scalar_opposite_val(const scalar_t* scalar)
 {
-    CHECK_NOT_NULL(scalar);
-    return scalar_new(scalar->a, scalar->b, !scalar->negative);
+    scalar_t result = zero;
+
+    scalar_opposite(&result, scalar);
+    return result;
 }
 
-scalar_t* scalar_abs_get(scalar_t* scalar)
+scalar_t scalar_abs_val(const scalar_t* scalar)
 {
-    CHECK_NOT_NULL(scalar);
-    return scalar_new(scalar->a, scalar->b, false);
+    scalar_t result = zero;
+
+    scalar_abs(&result, scalar);
+    return result;
 }
 
-scalar_t* scalar_inverse_get(scalar_t* scalar)
+scalar_t scalar_inverse_val(const scalar_t* scalar)
 {
-    CHECK_NOT_NULL(scalar);
-    scalar_t* s = scalar_from(0);
-    scalar_inverse(s, scalar);
-    return s;
+    scalar_t result = zero;
+
+    scalar_inverse(&result, scalar);
+    return result;
 }
 
-scalar_t* scalar_scale_get(scalar_t* scalar, uint64_t n, bool negative)
+scalar_t scalar_scale_val(const scalar_t* scalar, uint64_t n, bool negative)
 {
-    CHECK_NOT_NULL(scalar);
-    scalar_t* s = scalar_from(0);
-    scalar_scale(s, scalar, n, negative);
-    return s;
+    scalar_t result = zero;
+
+    scalar_scale(&result, scalar, n, negative);
+    return result;
 }
 
-scalar_t* scalar_add_get(scalar_t* x, scalar_t* y)
+scalar_t scalar_add_val(const scalar_t* x, const scalar_t* y)
 {
-    CHECK_NOT_NULL(x);
-    CHECK_NOT_NULL(y);
-    scalar_t* scalar = scalar_from(0);
-    scalar_add(scalar, x, y);
-    return scalar;
+    scalar_t result = zero;
+
+    scalar_add(&result, x, y);
+    return result;
+}
+
+scalar_t scalar_sub_val(const scalar_t* x, const scalar_t* y)
+{
+    scalar_t result = zero;
+
+    scalar_sub(&result, x, y);
+    return result;
+}
+
+scalar_t scalar_mul_val(const scalar_t* x, const scalar_t* y)
+{
+    scalar_t result = zero;
+
+    scalar_mul(&result, x, y);
+    return result;
+}
+
+scalar_t scalar_div_val(const scalar_t* x, const scalar_t* y)
+{
+    scalar_t result = zero;
+
+    scalar_div(&result, x, y);
+    return result;
+}
+
+scalar_t* scalar_opposite_get(const scalar_t* scalar)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_opposite_val(scalar);
+    return result;
+}
+
+scalar_t* scalar_abs_get(const scalar_t* scalar)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_abs_val(scalar);
+    return result;
+}
+
+scalar_t* scalar_inverse_get(const scalar_t* scalar)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_inverse_val(scalar);
+    return result;
+}
+
+scalar_t* scalar_scale_get(const scalar_t* scalar, uint64_t n, bool negative)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_scale_val(scalar, n, negative);
+    return result;
+}
+
+scalar_t* scalar_add_get(const scalar_t* x, const scalar_t* y)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_add_val(x, y);
+    return result;
+}
+
+scalar_t* scalar_sub_get(const scalar_t* x, const scalar_t* y)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_sub_val(x, y);
+    return result;
+}
+
+scalar_t* scalar_mul_get(const scalar_t* x, const scalar_t* y)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_mul_val(x, y);
+    return result;
+}
+
+scalar_t* scalar_div_get(const scalar_t* x, const scalar_t* y)
+{
+    scalar_t* result = alloc_new(sizeof(*result));
+
+    *result = scalar_div_val(x, y);
+    return result;
+}
+
+// Adds a / b to the pending fraction of acc, returns false without touching
+// it when the result would overflow. The new denominator is the lcm of both,
+// and the numerator isn't reduced against it.
+__attribute__((always_inline)) static inline bool scalar_acc_defer(scalar_acc_t* acc, int128_t a, uint128_t b)
+{
+    int128_t s, t;
+
+    if (b == acc->den) {
+        if (__builtin_add_overflow(acc->num, a, &s)) {
+            return false;
+        }
+
+        acc->num = s;
+        return true;
+    }
+
+    if (b > UINT64_MAX) {
+        return false;
+    }
+
+    uint64_t d = acc->den;
+    uint64_t q = b;
+
+    // Integers and other terms whose denominator divides the current one
+    if (d % q == 0) {
+        if (__builtin_mul_overflow(a, (int128_t)(d / q), &t) || __builtin_add_overflow(acc->num, t, &s)) {
+            return false;
+        }
+
+        acc->num = s;
+        return true;
+    }
+
+    uint64_t  g   = uint64_gcd(d, q);
+    uint128_t lcm = (uint128_t)(d / g) * q;
+
+    if (lcm > UINT64_MAX || __builtin_mul_overflow(acc->num, (int128_t)(q / g), &s)
+        || __builtin_mul_overflow(a, (int128_t)(d / g), &t) || __builtin_add_overflow(s, t, &s)) {
+        return false;
+    }
+
+    acc->num = s;
+    acc->den = lcm;
+    return true;
 }
 
-scalar_t* scalar_sub_get(scalar_t* x, scalar_t* y)
+// The pending fraction of acc in lowest terms
+static scalar_status_t scalar_acc_pending(scalar_t* result, const scalar_acc_t* acc)
 {
+    bool      negative = acc->num < 0;
+    uint128_t a        = negative ? -(uint128_t)acc->num : (uint128_t)acc->num;
+
+    if (a == 0) {
+        return scalar_set(result, 0, 1, false);
+    }
+
+    uint64_t g = uint64_gcd(a <= UINT64_MAX ? (uint64_t)a : (uint64_t)(a % acc->den), acc->den);
+
+    return scalar_set_wide(result, a / g, acc->den / g, negative);
+}
+
+// Moves the pending fraction into sum, which is the only reduction a chain
+// goes through before scalar_acc_get
+__attribute__((cold)) static void scalar_acc_fold(scalar_acc_t* acc)
+{
+    if (acc->num != 0) {
+        scalar_t tmp = zero;
+
+        scalar_acc_pending(&tmp, acc);
+        scalar_add(&acc->sum, &acc->sum, &tmp);
+        scalar_clear(&tmp);
+    }
+
+    acc->num = 0;
+    acc->den = 1;
+}
+
+// sum += x . y (or x alone when y is NULL), negated if opposite is set, with
+// the eager kernels
+__attribute__((cold)) static void scalar_acc_spill(scalar_acc_t* acc, const scalar_t* x, const scalar_t* y, bool opposite)
+{
+    scalar_t tmp = zero;
+
+    if (y != NULL) {
+        scalar_mul(&tmp, x, y);
+    } else {
+        scalar_copy(&tmp, x);
+    }
+
+    if (opposite) {
+        scalar_sub(&acc->sum, &acc->sum, &tmp);
+    } else {
+        scalar_add(&acc->sum, &acc->sum, &tmp);
+    }
+
+    scalar_clear(&tmp);
+}
+
+// acc += a / b, the term coming from x (and y), which the eager path falls
+// back on when the term can't be deferred even on an empty fraction
+__attribute__((always_inline)) static inline void scalar_acc_term(scalar_acc_t* acc, int128_t a, uint128_t b, const scalar_t* x, const scalar_t* y, bool opposite)
+{
+    if (scalar_acc_defer(acc, a, b)) {
+        return;
+    }
+
+    if (b <= UINT64_MAX) {
+        scalar_acc_fold(acc);
+
+        if (scalar_acc_defer(acc, a, b)) {
+            return;
+        }
+    }
+
+    scalar_acc_spill(acc, x, y, opposite);
+}
+
+void scalar_acc_add(scalar_acc_t* acc, const scalar_t* x)
+{
+    CHECK_NOT_NULL(acc);
     CHECK_NOT_NULL(x);
-    CHECK_NOT_NULL(y);
-    scalar_t* scalar = scalar_from(0);
-    scalar_sub(scalar, x, y);
-    return scalar;
+
+    if (scalar_is_big(x)) {
+        scalar_acc_spill(acc, x, NULL, false);
+        return;
+    }
+
+    scalar_acc_term(acc, x->num, x->den, x, NULL, false);
 }
 
-scalar_t* scalar_mul_get(scalar_t* x, scalar_t* y)
+// The product of two inline scalars is at most 126 bits over 128, which is
+// deferred as is: none of the cross-cancellation of scalar_mul is needed
+__attribute__((always_inline)) static inline void scalar_acc_fma(scalar_acc_t* acc, const scalar_t* x, const scalar_t* y, bool opposite)
 {
+    if (scalar_is_big(x) || scalar_is_big(y)) {
+        scalar_acc_spill(acc, x, y, opposite);
+        return;
+    }
+
+    int128_t  a = (int128_t)x->num * y->num;
+    uint128_t b = (uint128_t)x->den * y->den;
+
+    scalar_acc_term(acc, opposite ? -a : a, b, x, y, opposite);
+}
+
+void scalar_acc_add_mul(scalar_acc_t* acc, const scalar_t* x, const scalar_t* y)
+{
+    CHECK_NOT_NULL(acc);
     CHECK_NOT_NULL(x);
     CHECK_NOT_NULL(y);
-    scalar_t* scalar = scalar_from(0);
-    scalar_mul(scalar, x, y);
-    return scalar;
+
+    scalar_acc_fma(acc, x, y, false);
 }
 
-scalar_t* scalar_div_get(scalar_t* x, scalar_t* y)
+void scalar_acc_sub_mul(scalar_acc_t* acc, const scalar_t* x, const scalar_t* y)
 {
+    CHECK_NOT_NULL(acc);
     CHECK_NOT_NULL(x);
     CHECK_NOT_NULL(y);
-    scalar_t* s = scalar_from(0);
-    scalar_div(s, x, y);
-    return s;
+
+    scalar_acc_fma(acc, x, y, true);
 }
 
-static size_t num_len(uint64_t x)
+// result = the value of acc, which is left as is
+scalar_status_t scalar_acc_get(scalar_t* result, const scalar_acc_t* acc)
 {
-    size_t len = 0;
+    CHECK_NOT_NULL(result);
+    CHECK_NOT_NULL(acc);
 
-    do {
-        len++;
-        x /= 10; // x /= 10
-    } while (x > 9);
+    if (acc->sum.num == 0) {
+        return scalar_acc_pending(result, acc);
+    }
+
+    scalar_t tmp = zero;
+
+    scalar_acc_pending(&tmp, acc);
+    scalar_status_t status = scalar_add(result, &acc->sum, &tmp);
+    scalar_clear(&tmp);
 
-    return len;
+    return status;
 }
 
-char* scalar_string(scalar_t* scalar)
+// Releases the sum of acc and resets it to zero
+void scalar_acc_clear(scalar_acc_t* acc)
 {
+    CHECK_NOT_NULL(acc);
+
+    scalar_clear(&acc->sum);
+
+    acc->num = 0;
+    acc->den = 1;
+}
+
+// Writes scalar to dst followed by a '\0', and returns the number of
+// characters written, not counting the '\0'. dst must hold
+// scalar_string_length(scalar) bytes. Inline values go through no
+// allocation.
+size_t scalar_write(char* dst, const scalar_t* scalar)
+{
+    CHECK_NOT_NULL(dst);
     CHECK_NOT_NULL(scalar);
 
-    char* str = malloc(scalar_string_length(scalar));
-    CHECK_NOT_NULL(str);
+    char* end = dst;
+
+    if (scalar_is_big(scalar)) {
+        scalar_big_t* big = scalar_big(scalar);
+
+        if (big->negative) {
+            *end++ = '-';
+        }
+
+        end += bignum_write(end, &big->a);
+
+        if (!scalar_big_is_integer(big)) {
+            *end++ = '/';
+            end += bignum_write(end, &big->b);
+        }
 
-    if (scalar->a == 0) {
-        sprintf(str, "0");
-        return str;
+        return end - dst;
     }
 
-    if (scalar->b == 1) {
-        sprintf(str, scalar->negative ? "-%zu" : "%zu", scalar->a);
-        return str;
+    uint64_t mag = scalar_mag(scalar);
+    size_t   len = decimal_length(mag);
+
+    if (scalar->num < 0) {
+        *end++ = '-';
     }
 
-    sprintf(str, scalar->negative ? "-%zu/%zu" : "%zu/%zu", scalar->a, scalar->b);
+    decimal_write(end, mag, len);
+    end += len;
+
+    if (scalar->den != 1) {
+        len    = decimal_length(scalar->den);
+        *end++ = '/';
+        decimal_write(end, scalar->den, len);
+        end += len;
+    }
+
+    *end = '\0';
+    return end - dst;
+}
+
+char* scalar_string(const scalar_t* scalar)
+{
+    CHECK_NOT_NULL(scalar);
+
+    char* str = malloc(scalar_string_length(scalar));
+    CHECK_NOT_NULL(str);
+
+    scalar_write(str, scalar);
     return str;
 }
 
-size_t scalar_string_length(scalar_t* scalar)
+size_t scalar_string_length(const scalar_t* scalar)
 {
     CHECK_NOT_NULL(scalar);
 
-    size_t len = num_len(scalar->a);
+    if (scalar_is_big(scalar)) {
+        scalar_big_t* big = scalar_big(scalar);
+        size_t        len = bignum_string_length(&big->a) + big->negative;
+
+        if (!scalar_big_is_integer(big)) {
+            len += bignum_string_length(&big->b) + 1; // '/' + divisor
+        }
+
+        return 1 + len;
+    }
+
+    size_t len = decimal_length(scalar_mag(scalar));
 
-    if (scalar->b > 1) {
-        len += num_len(scalar->b) + 1; // '/' + divisor
+    if (scalar->den != 1) {
+        len += decimal_length(scalar->den) + 1; // '/' + divisor
     }
 
-    if (scalar->negative) {
+    if (scalar->num < 0) {
         len++;
     }
 
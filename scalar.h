@@ -1,6 +1,8 @@
 #ifndef TD_SCALAR_H
 #define TD_SCALAR_H
 
+#include "alloc.h"
+#include "bignum.h"
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -14,52 +16,126 @@ typedef enum scalar_cmp {
     LT,
 } scalar_cmp_t;
 
-typedef struct scalar {
-    // Whether the number is negative
-    bool negative;
+typedef enum scalar_status {
+    SCALAR_OK,
+
+    // The exact result doesn't fit the inline form, the destination was
+    // promoted to a heap rational
+    SCALAR_OVERFLOW,
+} scalar_status_t;
 
-    // The numerator
-    uint64_t a;
+// A rational packed in 16 bytes, a full cache line holds four of them. The
+// numerator carries the sign and stays within +/-INT64_MAX, the denominator
+// is positive, the fraction is in lowest terms and zero is always 0/1.
+typedef struct scalar {
+    // The signed numerator
+    _Alignas(16) int64_t num;
 
     // The denominator
-    uint64_t b;
+    uint64_t den;
 } scalar_t;
 
-extern scalar_t zero, one;
+// A value that outgrows the inline form is promoted: den is then 0 and num
+// points to an arbitrary precision rational, in lowest terms as well, which
+// also holds the sign. Values demote back as soon as they fit again, so zero
+// is never promoted and num == 0 still tests for it. A promoted scalar owns
+// heap memory, released by scalar_clear or the delete macros.
+#define scalar_is_big(scalar) ((scalar)->den == 0)
+
+// Thread safety. Every operand a function of the vector, matrix, lu, cd,
+// soa, dense or dixon modules, or of this one, only reads is passed as
+// const, and const operands are only ever read: not even temporarily
+// negated or inverted, and the heap side of promoted values is never
+// touched. Any number of threads may thus use the same scalars, vectors,
+// matrices or factorizations as inputs at once, a product sharing its right
+// operand across workers for instance. The views are the one exception:
+// they take non-const storage since they can be written through. What a
+// call writes (its result, or the first operand of the in-place vector and
+// matrix operations) must not be read or written by another thread
+// meanwhile. Results may alias inputs within a single call.
+//
+// The global state is limited to settings (matrix_set_strassen_cutoff,
+// soa_set_isa, dense_set_isa, pool_set_threads), which can be changed at any
+// time and apply to the calls started afterwards, the table of primes behind
+// the modular kernels, which is locked, and the current allocator, which is
+// per thread.
+extern const scalar_t zero, one;
+
+// An accumulator for chains of products such as dot products: terms are
+// added to an unreduced fraction over the lcm of their denominators, with
+// a 128-bit numerator and no gcd on it, and the chain is normalized once by
+// scalar_acc_get. The pending fraction is only reduced and folded into sum
+// when the next term would overflow it. Terms whose denominator doesn't fit
+// 64 bits, and promoted operands, go to sum directly.
+typedef struct scalar_acc {
+    // The deferred terms, num / den
+    __int128 num;
+    uint64_t den;
+
+    // The normalized part of the sum
+    scalar_t sum;
+} scalar_acc_t;
+
+#define SCALAR_ACC_INIT { .num = 0, .den = 1, .sum = { .num = 0, .den = 1 } }
 
-#define scalar_delete(scalar) \
-    if (scalar != NULL) {     \
-        free(scalar);         \
-        (scalar) = NULL;      \
+#define scalar_delete(scalar)     \
+    if (scalar != NULL) {         \
+        scalar_clear(scalar);     \
+        alloc_free(scalar);       \
+        (scalar) = NULL;          \
     }
 
-scalar_t*    scalar_new(uint64_t a, uint64_t b, bool negative);
-scalar_t*    scalar_from(int64_t n);
-void         scalar_copy(scalar_t* dst, scalar_t* src);
-scalar_t*    scalar_duplicate(scalar_t* scalar);
-scalar_cmp_t scalar_compare(scalar_t* x, scalar_t* y);
-bool         scalar_equals(scalar_t* x, scalar_t* y);
-bool         scalar_greater_equal(scalar_t* x, scalar_t* y);
-bool         scalar_greater_than(scalar_t* x, scalar_t* y);
-bool         scalar_less_equal(scalar_t* x, scalar_t* y);
-bool         scalar_less_than(scalar_t* x, scalar_t* y);
-void         scalar_opposite(scalar_t* result, scalar_t* scalar);
-void         scalar_abs(scalar_t* result, scalar_t* scalar);
-void         scalar_inverse(scalar_t* result, scalar_t* scalar);
-void         scalar_scale(scalar_t* result, scalar_t* scalar, uint64_t n, bool negative);
-void         scalar_add(scalar_t* result, scalar_t* x, scalar_t* y);
-void         scalar_sub(scalar_t* result, scalar_t* x, scalar_t* y);
-void         scalar_mul(scalar_t* result, scalar_t* x, scalar_t* y);
-void         scalar_div(scalar_t* result, scalar_t* x, scalar_t* y);
-scalar_t*    scalar_inverse_get(scalar_t* scalar);
-scalar_t*    scalar_abs_get(scalar_t* scalar);
-scalar_t*    scalar_opposite_get(scalar_t* scalar);
-scalar_t*    scalar_scale_get(scalar_t* scalar, uint64_t n, bool negative);
-scalar_t*    scalar_add_get(scalar_t* x, scalar_t* y);
-scalar_t*    scalar_sub_get(scalar_t* x, scalar_t* y);
-scalar_t*    scalar_mul_get(scalar_t* x, scalar_t* y);
-scalar_t*    scalar_div_get(scalar_t* x, scalar_t* y);
-char*        scalar_string(scalar_t* scalar);
-size_t       scalar_string_length(scalar_t* scalar);
+scalar_t        scalar_make(uint64_t a, uint64_t b, bool negative);
+scalar_t        scalar_of(int64_t n);
+scalar_t*       scalar_new(uint64_t a, uint64_t b, bool negative);
+scalar_t*       scalar_from(int64_t n);
+void            scalar_clear(scalar_t* scalar);
+void            scalar_clear_all(scalar_t* items, size_t n);
+void            scalar_get_bignum(const scalar_t* scalar, bignum_t* a, bignum_t* b);
+scalar_status_t scalar_set_bignum(scalar_t* result, bignum_t* a, bignum_t* b, bool negative);
+scalar_status_t scalar_set_int128(scalar_t* result, __int128 n);
+void            scalar_copy(scalar_t* dst, const scalar_t* src);
+scalar_t*       scalar_duplicate(const scalar_t* scalar);
+double          scalar_to_double(const scalar_t* scalar);
+scalar_cmp_t    scalar_compare(const scalar_t* x, const scalar_t* y);
+int             scalar_compare_abs(const scalar_t* x, const scalar_t* y);
+bool            scalar_is_negative(const scalar_t* scalar);
+bool            scalar_equals(const scalar_t* x, const scalar_t* y);
+bool            scalar_greater_equal(const scalar_t* x, const scalar_t* y);
+bool            scalar_greater_than(const scalar_t* x, const scalar_t* y);
+bool            scalar_less_equal(const scalar_t* x, const scalar_t* y);
+bool            scalar_less_than(const scalar_t* x, const scalar_t* y);
+void            scalar_opposite(scalar_t* result, const scalar_t* scalar);
+void            scalar_abs(scalar_t* result, const scalar_t* scalar);
+void            scalar_inverse(scalar_t* result, const scalar_t* scalar);
+scalar_status_t scalar_scale(scalar_t* result, const scalar_t* scalar, uint64_t n, bool negative);
+scalar_status_t scalar_add(scalar_t* result, const scalar_t* x, const scalar_t* y);
+scalar_status_t scalar_sub(scalar_t* result, const scalar_t* x, const scalar_t* y);
+scalar_status_t scalar_mul(scalar_t* result, const scalar_t* x, const scalar_t* y);
+scalar_status_t scalar_div(scalar_t* result, const scalar_t* x, const scalar_t* y);
+scalar_t        scalar_opposite_val(const scalar_t* scalar);
+scalar_t        scalar_abs_val(const scalar_t* scalar);
+scalar_t        scalar_inverse_val(const scalar_t* scalar);
+scalar_t        scalar_scale_val(const scalar_t* scalar, uint64_t n, bool negative);
+scalar_t        scalar_add_val(const scalar_t* x, const scalar_t* y);
+scalar_t        scalar_sub_val(const scalar_t* x, const scalar_t* y);
+scalar_t        scalar_mul_val(const scalar_t* x, const scalar_t* y);
+scalar_t        scalar_div_val(const scalar_t* x, const scalar_t* y);
+scalar_t*       scalar_inverse_get(const scalar_t* scalar);
+scalar_t*       scalar_abs_get(const scalar_t* scalar);
+scalar_t*       scalar_opposite_get(const scalar_t* scalar);
+scalar_t*       scalar_scale_get(const scalar_t* scalar, uint64_t n, bool negative);
+scalar_t*       scalar_add_get(const scalar_t* x, const scalar_t* y);
+scalar_t*       scalar_sub_get(const scalar_t* x, const scalar_t* y);
+scalar_t*       scalar_mul_get(const scalar_t* x, const scalar_t* y);
+scalar_t*       scalar_div_get(const scalar_t* x, const scalar_t* y);
+void            scalar_acc_add(scalar_acc_t* acc, const scalar_t* x);
+void            scalar_acc_add_mul(scalar_acc_t* acc, const scalar_t* x, const scalar_t* y);
+void            scalar_acc_sub_mul(scalar_acc_t* acc, const scalar_t* x, const scalar_t* y);
+scalar_status_t scalar_acc_get(scalar_t* result, const scalar_acc_t* acc);
+void            scalar_acc_clear(scalar_acc_t* acc);
+size_t          scalar_write(char* dst, const scalar_t* scalar);
+char*           scalar_string(const scalar_t* scalar);
+size_t          scalar_string_length(const scalar_t* scalar);
 
 #endif /* scalar.h */
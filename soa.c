@@ -0,0 +1,533 @@
+#include "soa.h"
+#include "gcd.h"
+#include "utils.h"
+#include <stdlib.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define SOA_X86
+#include <immintrin.h>
+#endif
+
+// Arrays start on a cache line, which is also the AVX-512 register width
+#define SOA_ALIGN 64
+
+static void* soa_alloc(size_t n)
+{
+    size_t size = (n * sizeof(uint64_t) + SOA_ALIGN - 1) / SOA_ALIGN * SOA_ALIGN;
+
+    void* data = aligned_alloc(SOA_ALIGN, size > 0 ? size : SOA_ALIGN);
+    CHECK_NOT_NULL(data);
+
+    return data;
+}
+
+soa_t* soa_new(size_t n)
+{
+    soa_t* soa = malloc(sizeof(*soa));
+    CHECK_NOT_NULL(soa);
+
+    soa->n   = n;
+    soa->num = soa_alloc(n);
+    soa->den = soa_alloc(n);
+
+    for (size_t i = 0; i < n; i++) {
+        soa->num[i] = 0;
+        soa->den[i] = 1;
+    }
+
+    return soa;
+}
+
+// Copies count scalars, stride scalars apart, into the buffer from index i.
+// Returns false if one of them is promoted.
+static bool soa_load(soa_t* soa, size_t i, const scalar_t* items, size_t count, size_t stride)
+{
+    for (size_t k = 0; k < count; k++) {
+        const scalar_t* x = &items[k * stride];
+
+        if (scalar_is_big(x)) {
+            return false;
+        }
+
+        soa->num[i + k] = x->num;
+        soa->den[i + k] = x->den;
+    }
+
+    return true;
+}
+
+soa_t* soa_from_vector(const vector_t* vector)
+{
+    CHECK_NOT_NULL(vector);
+
+    soa_t* soa = soa_new(vector->n);
+
+    if (!soa_load(soa, 0, vector->items, vector->n, vector->stride)) {
+        soa_delete(soa);
+    }
+
+    return soa;
+}
+
+// The matrix is flattened row by row
+soa_t* soa_from_matrix(const matrix_t* matrix)
+{
+    CHECK_NOT_NULL(matrix);
+
+    soa_t* soa = soa_new(matrix->m * matrix->n);
+
+    for (size_t i = 0; i < matrix->m; i++) {
+        if (!soa_load(soa, i * matrix->n, matrix_row_ptr(matrix, i), matrix->n, 1)) {
+            soa_delete(soa);
+            return NULL;
+        }
+    }
+
+    return soa;
+}
+
+// Value i of the buffer in lowest terms
+static scalar_t soa_scalar(const soa_t* soa, size_t i)
+{
+    int64_t  num = soa->num[i];
+    uint64_t den = soa->den[i];
+
+    if (num == 0) {
+        return zero;
+    }
+
+    uint64_t g = uint64_gcd(num < 0 ? -(uint64_t)num : (uint64_t)num, den);
+
+    return (scalar_t){ .num = num / (int64_t)g, .den = den / g };
+}
+
+vector_t* soa_to_vector(const soa_t* soa)
+{
+    CHECK_NOT_NULL(soa);
+
+    vector_t* vector = vector_new(soa->n);
+
+    for (size_t i = 0; i < soa->n; i++) {
+        vector->items[i] = soa_scalar(soa, i);
+    }
+
+    vector_refresh_integer(vector);
+
+    return vector;
+}
+
+matrix_t* soa_to_matrix(const soa_t* soa, size_t m, size_t n)
+{
+    CHECK_NOT_NULL(soa);
+
+    if (m * n != soa->n) {
+        ERROR("dimension mismatch (buffer holds %zu values, matrix is %zu x %zu)", soa->n, m, n);
+    }
+
+    matrix_t* matrix = matrix_new(m, n);
+
+    for (size_t i = 0; i < soa->n; i++) {
+        matrix->data[i] = soa_scalar(soa, i);
+    }
+
+    matrix_refresh_integer(matrix);
+
+    return matrix;
+}
+
+void soa_normalize(soa_t* soa)
+{
+    CHECK_NOT_NULL(soa);
+
+    for (size_t i = 0; i < soa->n; i++) {
+        if (soa->den[i] != 1) {
+            scalar_t x  = soa_scalar(soa, i);
+            soa->num[i] = x.num;
+            soa->den[i] = x.den;
+        }
+    }
+}
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+// Stores a / b reduced in lane i, returns false if it doesn't fit
+static bool soa_store(soa_t* r, size_t i, int128_t a, uint128_t b)
+{
+    bool      negative = a < 0;
+    uint128_t x        = negative ? -(uint128_t)a : (uint128_t)a;
+
+    if (x == 0) {
+        r->num[i] = 0;
+        r->den[i] = 1;
+        return true;
+    }
+
+    uint128_t g = x <= UINT64_MAX && b <= UINT64_MAX ? uint64_gcd(x, b) : uint128_gcd(x, b);
+
+    x /= g;
+    b /= g;
+
+    if (x > INT64_MAX || b > UINT64_MAX) {
+        return false;
+    }
+
+    r->num[i] = negative ? -(int64_t)x : (int64_t)x;
+    r->den[i] = b;
+    return true;
+}
+
+// The general case of r = u + v or r = u - v on the lanes [i0, i1), one at
+// a time. Equal denominators only add numerators, others go through 128 bits.
+static bool soa_add_lanes(soa_t* r, const soa_t* u, const soa_t* v, size_t i0, size_t i1, bool sub)
+{
+    bool fits = true;
+
+    for (size_t i = i0; i < i1; i++) {
+        int64_t  xn = u->num[i];
+        int64_t  yn = sub ? -v->num[i] : v->num[i];
+        uint64_t xd = u->den[i];
+        uint64_t yd = v->den[i];
+        int64_t  s;
+
+        if (xd == yd && !__builtin_add_overflow(xn, yn, &s) && s != INT64_MIN) {
+            r->num[i] = s;
+            r->den[i] = xd;
+            continue;
+        }
+
+        // As in scalar_add, the numerator can only share a factor of g with
+        // the lcm, which is all that's cancelled unless the result doesn't
+        // fit without a full reduction
+        uint64_t g  = xd == yd ? xd : uint64_gcd(xd, yd);
+        uint64_t bx = xd / g;
+        int128_t xx = (int128_t)xn * (yd / g);
+        int128_t yy = (int128_t)yn * bx;
+
+        if (__builtin_add_overflow(xx, yy, &xx)) {
+            fits = false;
+            continue;
+        }
+
+        uint128_t a = xx < 0 ? -(uint128_t)xx : (uint128_t)xx;
+        uint64_t  h = g == 1 || a == 0 ? 1 : uint64_gcd(a <= UINT64_MAX ? (uint64_t)a : (uint64_t)(a % g), g);
+        uint128_t b = (uint128_t)bx * (yd / h);
+
+        if (a / h <= INT64_MAX && b <= UINT64_MAX) {
+            r->num[i] = xx / h;
+            r->den[i] = a == 0 ? 1 : b;
+        } else if (!soa_store(r, i, xx, (uint128_t)bx * yd)) {
+            fits = false;
+        }
+    }
+
+    return fits;
+}
+
+// r = u . (sn / sd) on the lanes [i0, i1)
+static bool soa_scale_lanes(soa_t* r, const soa_t* u, int64_t sn, uint64_t sd, size_t i0, size_t i1)
+{
+    bool fits = true;
+
+    for (size_t i = i0; i < i1; i++) {
+        int64_t p;
+
+        if (sd == 1 && !__builtin_mul_overflow(u->num[i], sn, &p) && p != INT64_MIN) {
+            r->num[i] = p;
+            r->den[i] = u->den[i];
+            continue;
+        }
+
+        if (!soa_store(r, i, (int128_t)u->num[i] * sn, (uint128_t)u->den[i] * sd)) {
+            fits = false;
+        }
+    }
+
+    return fits;
+}
+
+#ifdef SOA_X86
+
+// Four lanes at a time. Blocks where the denominators match and the
+// numerators don't overflow are done in registers, the others lane by lane.
+__attribute__((target("avx2"))) static bool soa_add_avx2(soa_t* r, const soa_t* u, const soa_t* v, bool sub)
+{
+    __m256i min  = _mm256_set1_epi64x(INT64_MIN);
+    bool    fits = true;
+    size_t  i    = 0;
+
+    for (; i + 4 <= u->n; i += 4) {
+        __m256i un = _mm256_loadu_si256((__m256i*)&u->num[i]);
+        __m256i vn = _mm256_loadu_si256((__m256i*)&v->num[i]);
+        __m256i ud = _mm256_loadu_si256((__m256i*)&u->den[i]);
+        __m256i vd = _mm256_loadu_si256((__m256i*)&v->den[i]);
+
+        // Signed overflow shows in the sign bit: the result's sign differs
+        // from both operands' for an addition, and from the minuend's for a
+        // subtraction of an operand of the other sign
+        __m256i s, overflow;
+        if (sub) {
+            s        = _mm256_sub_epi64(un, vn);
+            overflow = _mm256_and_si256(_mm256_xor_si256(un, vn), _mm256_xor_si256(un, s));
+        } else {
+            s        = _mm256_add_epi64(un, vn);
+            overflow = _mm256_and_si256(_mm256_xor_si256(un, s), _mm256_xor_si256(vn, s));
+        }
+
+        __m256i bad = _mm256_or_si256(overflow, _mm256_cmpeq_epi64(s, min));
+        bad         = _mm256_or_si256(bad, _mm256_andnot_si256(_mm256_cmpeq_epi64(ud, vd), _mm256_set1_epi64x(-1)));
+
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(bad)) == 0) {
+            _mm256_storeu_si256((__m256i*)&r->num[i], s);
+            _mm256_storeu_si256((__m256i*)&r->den[i], ud);
+        } else {
+            fits &= soa_add_lanes(r, u, v, i, i + 4, sub);
+        }
+    }
+
+    return soa_add_lanes(r, u, v, i, u->n, sub) && fits;
+}
+
+// Low 64 bits of the lane products, AVX2 has no 64-bit multiply. With
+// a = ah.2^32 + al and b = bh.2^32 + bl, a.b = al.bl + (ah.bl + al.bh).2^32
+// modulo 2^64, which holds for two's complement operands as well.
+__attribute__((target("avx2"))) static inline __m256i soa_mullo_avx2(__m256i a, __m256i b)
+{
+    __m256i lo    = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                     _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+
+    return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// Integer scaling: lanes with |num| <= INT64_MAX / |k| can't overflow, so
+// the products are exact and denominators carry over
+__attribute__((target("avx2"))) static bool soa_scale_avx2(soa_t* r, const soa_t* u, int64_t k)
+{
+    int64_t limit = INT64_MAX / (k < 0 ? -k : k);
+    __m256i hi    = _mm256_set1_epi64x(limit);
+    __m256i lo    = _mm256_set1_epi64x(-limit);
+    __m256i kk    = _mm256_set1_epi64x(k);
+    bool    fits  = true;
+    size_t  i     = 0;
+
+    for (; i + 4 <= u->n; i += 4) {
+        __m256i un  = _mm256_loadu_si256((__m256i*)&u->num[i]);
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(un, hi), _mm256_cmpgt_epi64(lo, un));
+
+        if (_mm256_movemask_pd(_mm256_castsi256_pd(bad)) == 0) {
+            _mm256_storeu_si256((__m256i*)&r->num[i], soa_mullo_avx2(un, kk));
+            _mm256_storeu_si256((__m256i*)&r->den[i], _mm256_loadu_si256((__m256i*)&u->den[i]));
+        } else {
+            fits &= soa_scale_lanes(r, u, k, 1, i, i + 4);
+        }
+    }
+
+    return soa_scale_lanes(r, u, k, 1, i, u->n) && fits;
+}
+
+// Eight lanes at a time, the tail runs under a lane mask. Only the lanes
+// that fail the fast path fall back to the lane kernel.
+__attribute__((target("avx512f"))) static bool soa_add_avx512(soa_t* r, const soa_t* u, const soa_t* v, bool sub)
+{
+    __m512i min  = _mm512_set1_epi64(INT64_MIN);
+    __m512i zero = _mm512_setzero_si512();
+    bool    fits = true;
+
+    for (size_t i = 0; i < u->n; i += 8) {
+        __mmask8 live = u->n - i >= 8 ? 0xff : (__mmask8)((1u << (u->n - i)) - 1);
+
+        __m512i un = _mm512_maskz_loadu_epi64(live, &u->num[i]);
+        __m512i vn = _mm512_maskz_loadu_epi64(live, &v->num[i]);
+        __m512i ud = _mm512_maskz_loadu_epi64(live, &u->den[i]);
+        __m512i vd = _mm512_maskz_loadu_epi64(live, &v->den[i]);
+
+        __m512i s, overflow;
+        if (sub) {
+            s        = _mm512_sub_epi64(un, vn);
+            overflow = _mm512_and_si512(_mm512_xor_si512(un, vn), _mm512_xor_si512(un, s));
+        } else {
+            s        = _mm512_add_epi64(un, vn);
+            overflow = _mm512_and_si512(_mm512_xor_si512(un, s), _mm512_xor_si512(vn, s));
+        }
+
+        __mmask8 bad = _mm512_cmplt_epi64_mask(overflow, zero) | _mm512_cmpeq_epi64_mask(s, min)
+                     | _mm512_cmpneq_epi64_mask(ud, vd);
+        __mmask8 good = live & ~bad;
+
+        _mm512_mask_storeu_epi64(&r->num[i], good, s);
+        _mm512_mask_storeu_epi64(&r->den[i], good, ud);
+
+        for (unsigned lanes = live & bad; lanes != 0; lanes &= lanes - 1) {
+            size_t lane = i + __builtin_ctz(lanes);
+            fits &= soa_add_lanes(r, u, v, lane, lane + 1, sub);
+        }
+    }
+
+    return fits;
+}
+
+__attribute__((target("avx512f,avx512dq"))) static bool soa_scale_avx512(soa_t* r, const soa_t* u, int64_t k)
+{
+    int64_t limit = INT64_MAX / (k < 0 ? -k : k);
+    __m512i hi    = _mm512_set1_epi64(limit);
+    __m512i lo    = _mm512_set1_epi64(-limit);
+    __m512i kk    = _mm512_set1_epi64(k);
+    bool    fits  = true;
+
+    for (size_t i = 0; i < u->n; i += 8) {
+        __mmask8 live = u->n - i >= 8 ? 0xff : (__mmask8)((1u << (u->n - i)) - 1);
+
+        __m512i  un   = _mm512_maskz_loadu_epi64(live, &u->num[i]);
+        __m512i  ud   = _mm512_maskz_loadu_epi64(live, &u->den[i]);
+        __mmask8 bad  = _mm512_cmpgt_epi64_mask(un, hi) | _mm512_cmpgt_epi64_mask(lo, un);
+        __mmask8 good = live & ~bad;
+
+        _mm512_mask_storeu_epi64(&r->num[i], good, _mm512_mullo_epi64(un, kk));
+        _mm512_mask_storeu_epi64(&r->den[i], good, ud);
+
+        for (unsigned lanes = live & bad; lanes != 0; lanes &= lanes - 1) {
+            size_t lane = i + __builtin_ctz(lanes);
+            fits &= soa_scale_lanes(r, u, k, 1, lane, lane + 1);
+        }
+    }
+
+    return fits;
+}
+
+#endif
+
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+// -1 until the first kernel runs, then the instruction set in use
+static int soa_current_isa = -1;
+
+static soa_isa_t soa_best_isa(void)
+{
+#ifdef SOA_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq")) {
+        return SOA_ISA_AVX512;
+    }
+
+    if (__builtin_cpu_supports("avx2")) {
+        return SOA_ISA_AVX2;
+    }
+#endif
+
+    return SOA_ISA_SCALAR;
+}
+
+// The instruction set the kernels run on, the best one the CPU supports
+// unless soa_set_isa lowered it
+soa_isa_t soa_isa(void)
+{
+    int isa = __atomic_load_n(&soa_current_isa, __ATOMIC_RELAXED);
+
+    if (isa < 0) {
+        isa = soa_best_isa();
+        __atomic_store_n(&soa_current_isa, isa, __ATOMIC_RELAXED);
+    }
+
+    return isa;
+}
+
+// Selects the instruction set of the kernels, capped to what the CPU
+// supports. Returns the one actually selected.
+soa_isa_t soa_set_isa(soa_isa_t isa)
+{
+    soa_isa_t best = soa_best_isa();
+
+    if (isa > best) {
+        isa = best;
+    }
+
+    __atomic_store_n(&soa_current_isa, isa, __ATOMIC_RELAXED);
+    return isa;
+}
+
+static void soa_check(const soa_t* r, const soa_t* u, const soa_t* v)
+{
+    CHECK_NOT_NULL(r);
+    CHECK_NOT_NULL(u);
+    CHECK_NOT_NULL(v);
+
+    if (u->n != v->n || r->n != u->n) {
+        ERROR("buffer size mismatch (r=%zu, u=%zu, v=%zu)", r->n, u->n, v->n);
+    }
+}
+
+static scalar_status_t soa_add_dispatch(soa_t* r, const soa_t* u, const soa_t* v, bool sub)
+{
+    soa_check(r, u, v);
+
+    bool fits;
+
+    switch (soa_isa()) {
+#ifdef SOA_X86
+    case SOA_ISA_AVX512:
+        fits = soa_add_avx512(r, u, v, sub);
+        break;
+    case SOA_ISA_AVX2:
+        fits = soa_add_avx2(r, u, v, sub);
+        break;
+#endif
+    default:
+        fits = soa_add_lanes(r, u, v, 0, u->n, sub);
+        break;
+    }
+
+    return fits ? SCALAR_OK : SCALAR_OVERFLOW;
+}
+
+// r = u + v elementwise, r may alias u or v. Returns SCALAR_OVERFLOW if a
+// value doesn't fit a 64-bit fraction, the lanes concerned are then left
+// unspecified.
+scalar_status_t soa_add(soa_t* r, const soa_t* u, const soa_t* v)
+{
+    return soa_add_dispatch(r, u, v, false);
+}
+
+// r = u - v elementwise, same contract as soa_add
+scalar_status_t soa_sub(soa_t* r, const soa_t* u, const soa_t* v)
+{
+    return soa_add_dispatch(r, u, v, true);
+}
+
+// r = scalar . u elementwise, r may alias u. Integer factors run on the SIMD
+// kernels, other fractions lane by lane.
+scalar_status_t soa_scale(soa_t* r, const soa_t* u, const scalar_t* scalar)
+{
+    soa_check(r, u, u);
+    CHECK_NOT_NULL(scalar);
+
+    if (scalar_is_big(scalar)) {
+        return SCALAR_OVERFLOW;
+    }
+
+    if (scalar->num == 0) {
+        for (size_t i = 0; i < r->n; i++) {
+            r->num[i] = 0;
+            r->den[i] = 1;
+        }
+        return SCALAR_OK;
+    }
+
+    bool fits;
+
+    switch (scalar->den == 1 ? soa_isa() : SOA_ISA_SCALAR) {
+#ifdef SOA_X86
+    case SOA_ISA_AVX512:
+        fits = soa_scale_avx512(r, u, scalar->num);
+        break;
+    case SOA_ISA_AVX2:
+        fits = soa_scale_avx2(r, u, scalar->num);
+        break;
+#endif
+    default:
+        fits = soa_scale_lanes(r, u, scalar->num, scalar->den, 0, u->n);
+        break;
+    }
+
+    return fits ? SCALAR_OK : SCALAR_OVERFLOW;
+}
@@ -0,0 +1,52 @@
+#ifndef TD_SOA_H
+#define TD_SOA_H
+
+#include "matrix.h"
+#include "scalar.h"
+#include "vector.h"
+#include <stddef.h>
+#include <stdint.h>
+
+// A buffer of rationals laid out as a structure of arrays: the i-th value
+// is num[i] / den[i], the numerator carrying the sign as in scalar_t. The
+// arrays are contiguous and 64-byte aligned, which lets the elementwise
+// kernels below run on SIMD registers.
+//
+// Values are not kept in lowest terms: the fast paths leave common factors
+// in place, soa_normalize reduces them and converting back to scalars
+// always does. Numerators stay within +/-INT64_MAX and promoted scalars
+// can't be stored, conversions return NULL when they meet one.
+typedef struct soa {
+    size_t    n;
+    int64_t*  num;
+    uint64_t* den;
+} soa_t;
+
+// The instruction sets the kernels can run on, in increasing order
+typedef enum soa_isa {
+    SOA_ISA_SCALAR,
+    SOA_ISA_AVX2,
+    SOA_ISA_AVX512,
+} soa_isa_t;
+
+#define soa_delete(soa)       \
+    if ((soa) != NULL) {      \
+        free((soa)->num);     \
+        free((soa)->den);     \
+        free(soa);            \
+        (soa) = NULL;         \
+    }
+
+soa_t*          soa_new(size_t n);
+soa_t*          soa_from_vector(const vector_t* vector);
+soa_t*          soa_from_matrix(const matrix_t* matrix);
+vector_t*       soa_to_vector(const soa_t* soa);
+matrix_t*       soa_to_matrix(const soa_t* soa, size_t m, size_t n);
+void            soa_normalize(soa_t* soa);
+scalar_status_t soa_add(soa_t* r, const soa_t* u, const soa_t* v);
+scalar_status_t soa_sub(soa_t* r, const soa_t* u, const soa_t* v);
+scalar_status_t soa_scale(soa_t* r, const soa_t* u, const scalar_t* scalar);
+soa_isa_t       soa_isa(void);
+soa_isa_t       soa_set_isa(soa_isa_t isa);
+
+#endif /* soa.h */
@@ -0,0 +1,146 @@
+#include "../alloc.h"
+#include "../lu.h"
+#include "../matrix.h"
+#include "../vector.h"
+#include "test.h"
+
+static bool arena_test(T* t)
+{
+    arena_t*     arena    = arena_new(1024);
+    allocator_t* previous = alloc_use(&arena->base);
+
+    // blocks come back in order, 16-byte aligned, from the first chunk
+    scalar_t* x = scalar_new(1, 3, false);
+    scalar_t* y = scalar_new(2, 3, true);
+    ASSERT_EQUALS((uintptr_t)x % 16, 0);
+    ASSERT_EQUALS((char*)y - (char*)x, 32);
+
+    // deleting the latest block takes it back
+    scalar_delete(y);
+    y = scalar_new(5, 1, false);
+    ASSERT_EQUALS((char*)y - (char*)x, 32);
+
+    // larger than a chunk, it gets one of its own
+    arena_mark_t mark = arena_mark(arena);
+    matrix_t*    a    = matrix_new(10, 10);
+    vector_t*    v    = vector_new(3);
+    ASSERT_EQUALS((uintptr_t)a->data % 16, 0);
+    ASSERT_EQUALS(v->items, (scalar_t*)(v + 1));
+    ASSERT_TRUE(scalar_equals(&matrix_at(a, 9, 9), &zero));
+
+    // and the same memory is handed out again after a rewind
+    arena_rewind(arena, mark);
+    matrix_t* b = matrix_new(10, 10);
+    ASSERT_EQUALS(a, b);
+
+    // deletes find the arena whatever the current allocator
+    alloc_use(previous);
+    matrix_delete(b);
+
+    alloc_use(&arena->base);
+    arena_reset(arena);
+    scalar_t* z = scalar_new(7, 1, false);
+    ASSERT_EQUALS(z, x);
+
+    alloc_use(previous);
+    arena_delete(arena);
+    ASSERT_NULL(arena);
+    return TEST_PASS;
+}
+
+static bool slab_test(T* t)
+{
+    slab_t*      slab     = slab_new();
+    allocator_t* previous = alloc_use(&slab->base);
+
+    scalar_t* x = scalar_new(1, 3, false);
+    scalar_t* y = scalar_new(2, 3, true);
+    scalar_t* z = scalar_duplicate(x);
+
+    // a freed block is the next one of its class, in any order
+    scalar_t* old = x;
+    scalar_delete(x);
+    scalar_t* w = scalar_new(4, 1, false);
+    ASSERT_EQUALS(w, old);
+    ASSERT_EQUALS(z->num, 1);
+    ASSERT_EQUALS(z->den, 3);
+
+    scalar_t* u = scalar_from(9);
+    ASSERT_NOT_EQUAL(u, w);
+
+    // blocks past the classes are on the heap
+    matrix_t* a = matrix_new(30, 30);
+    matrix_delete(a);
+
+    scalar_delete(u);
+    scalar_delete(w);
+    scalar_delete(z);
+    scalar_delete(y);
+    slab_reset(slab);
+
+    alloc_use(previous);
+    slab_delete(slab);
+    return TEST_PASS;
+}
+
+// A whole factorization and solve on an arena gives the same result as on
+// the heap, and the arena is then dropped in one go
+static bool arena_lu_test(T* t)
+{
+    matrix_t* a = matrix_new(12, 12);
+    vector_t* b = vector_new(12);
+
+    for (size_t i = 0; i < 144; i++) {
+        scalar_t* x = scalar_new((i * 37 + 11) % 23, 1 + i % 7, i % 5 == 0);
+        scalar_copy(&a->data[i], x);
+        scalar_delete(x);
+    }
+    for (size_t i = 0; i < 12; i++) {
+        scalar_t* x = scalar_from(i);
+        scalar_copy(&b->items[i], x);
+        scalar_delete(x);
+    }
+    matrix_refresh_integer(a);
+    vector_refresh_integer(b);
+
+    lu_t*     lu = lu_new(a);
+    vector_t* x  = lu_solve(lu, b);
+
+    arena_t*     arena    = arena_new(4096);
+    allocator_t* previous = alloc_use(&arena->base);
+
+    lu_t*     lu2 = lu_new(a);
+    vector_t* y   = lu_solve(lu2, b);
+    scalar_t* d   = scalar_duplicate(&y->items[0]);
+
+    for (size_t i = 0; i < 12; i++) {
+        ASSERT_TRUE(scalar_equals(&x->items[i], &y->items[i]));
+    }
+
+    // promoted values own heap memory, clearing them is all a reset needs
+    scalar_clear(d);
+    scalar_clear_all(y->items, y->n);
+    scalar_clear_all(lu2->LU->data, 144);
+    free(lu2);
+    arena_reset(arena);
+
+    alloc_use(previous);
+    arena_delete(arena);
+
+    vector_delete(x);
+    lu_delete(lu);
+    vector_delete(b);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(arena);
+    TEST(slab);
+    TEST(arena_lu);
+
+    TEST_END();
+}
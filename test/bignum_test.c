@@ -0,0 +1,106 @@
+#include "../bignum.h"
+#include "test.h"
+#include <string.h>
+
+static bool bignum_string_equals(bignum_t* x, const char* expected)
+{
+    char* str = malloc(bignum_string_length(x) + 1);
+    bignum_write(str, x);
+
+    bool equals = strcmp(str, expected) == 0;
+    free(str);
+    return equals;
+}
+
+static bool bignum_mul_test(T* t)
+{
+    bignum_t x = BIGNUM_INIT, y = BIGNUM_INIT;
+
+    // (2^64 - 1)^2 = 2^128 - 2^65 + 1
+    bignum_set_u64(&x, UINT64_MAX);
+    bignum_mul(&y, &x, &x);
+    ASSERT_EQUALS(bignum_bits(&y), 128);
+    ASSERT_TRUE(bignum_string_equals(&y, "340282366920938463426481119284349108225"));
+
+    // r may alias an operand
+    bignum_mul(&y, &y, &x);
+    bignum_add_u64(&y, &y, 1);
+    ASSERT_TRUE(bignum_string_equals(&y, "6277101735386680762814942322444851025767571854389858533376"));
+
+    bignum_sub(&y, &y, &y);
+    ASSERT_TRUE(bignum_is_zero(&y));
+    ASSERT_TRUE(bignum_string_equals(&y, "0"));
+
+    bignum_clear(&y);
+    bignum_clear(&x);
+    return TEST_PASS;
+}
+
+static bool bignum_divmod_test(T* t)
+{
+    bignum_t x = BIGNUM_INIT, y = BIGNUM_INIT, q = BIGNUM_INIT, r = BIGNUM_INIT;
+
+    // x = 3^100, y = 3^40 . 7 + 5
+    bignum_set_u64(&x, 1);
+    for (size_t i = 0; i < 100; i++) {
+        bignum_mul_u64(&x, &x, 3);
+    }
+
+    bignum_set_u64(&y, 1);
+    for (size_t i = 0; i < 40; i++) {
+        bignum_mul_u64(&y, &y, 3);
+    }
+    bignum_mul_u64(&y, &y, 7);
+    bignum_add_u64(&y, &y, 5);
+
+    bignum_divmod(&q, &r, &x, &y);
+
+    // q.y + r = x and r < y
+    ASSERT_TRUE(bignum_cmp(&r, &y) < 0);
+    bignum_mul(&q, &q, &y);
+    bignum_add(&q, &q, &r);
+    ASSERT_EQUALS(bignum_cmp(&q, &x), 0);
+
+    ASSERT_EQUALS(bignum_divmod_u64(&q, &x, 1000000007), 886041711);
+
+    bignum_clear(&r);
+    bignum_clear(&q);
+    bignum_clear(&y);
+    bignum_clear(&x);
+    return TEST_PASS;
+}
+
+static bool bignum_gcd_test(T* t)
+{
+    bignum_t x = BIGNUM_INIT, y = BIGNUM_INIT, g = BIGNUM_INIT;
+
+    // gcd(2^100 . 3^5, 2^70 . 5) = 2^70
+    bignum_set_u64(&x, 243);
+    bignum_set_u64(&y, 5);
+    for (size_t i = 0; i < 100; i++) {
+        bignum_mul_u64(&x, &x, 2);
+        if (i < 70) {
+            bignum_mul_u64(&y, &y, 2);
+        }
+    }
+
+    bignum_gcd(&g, &x, &y);
+    ASSERT_EQUALS(bignum_bits(&g), 71);
+    ASSERT_TRUE(bignum_string_equals(&g, "1180591620717411303424"));
+
+    bignum_clear(&g);
+    bignum_clear(&y);
+    bignum_clear(&x);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(bignum_mul);
+    TEST(bignum_divmod);
+    TEST(bignum_gcd);
+
+    TEST_END();
+}
@@ -0,0 +1,212 @@
+#include "../cd.h"
+#include "fixture.h"
+#include "test.h"
+
+#define SIZE 23
+
+// Fractions over divisors of 360, so the common denominator stays 360
+static scalar_t fraction(uint64_t seed, size_t i)
+{
+    static const uint64_t dens[] = { 1, 2, 3, 4, 5, 6, 8, 9, 10, 12, 360 };
+
+    uint64_t a = fixture_spread(seed, i) % 1000;
+
+    return scalar_make(a, dens[(seed + i) % 11], (a + i) % 2);
+}
+
+static bool vector_cd_convert_test(T* t)
+{
+    vector_t*    u = vector_fixture(SIZE, 1, fraction);
+    vector_cd_t* x = vector_cd_from(u);
+
+    ASSERT_NOT_NULL(x);
+    ASSERT_EQUALS(x->den, 360);
+
+    vector_t* v = vector_cd_to_vector(x);
+    ASSERT_TRUE(vector_equals(u, v));
+
+    // every third item, through a strided view
+    vector_t     w = vector_view(u->items, SIZE / 3, 3);
+    vector_cd_t* z = vector_cd_from(&w);
+
+    ASSERT_NOT_NULL(z);
+    vector_t* zv = vector_cd_to_vector(z);
+    for (size_t i = 0; i < SIZE / 3; i++) {
+        ASSERT_TRUE(scalar_equals(&zv->items[i], &vector_at(&w, i)));
+    }
+    vector_delete(zv);
+    vector_cd_delete(z);
+
+    // no common denominator fits 64 bits
+    scalar_t* big   = scalar_new(1, 4294967311u, false);
+    scalar_t* other = scalar_new(1, 4294967357u, false);
+    vector_set(v, 0, big);
+    vector_set(v, 1, other);
+    ASSERT_NULL(vector_cd_from(v));
+
+    scalar_delete(other);
+    scalar_delete(big);
+    vector_delete(v);
+    vector_cd_delete(x);
+    vector_delete(u);
+    return TEST_PASS;
+}
+
+static bool vector_cd_add_test(T* t)
+{
+    vector_t*    u = vector_fixture(SIZE, 1, fraction);
+    vector_t*    v = vector_fixture(SIZE, 2, fraction);
+    vector_cd_t* x = vector_cd_from(u);
+    vector_cd_t* y = vector_cd_from(v);
+
+    ASSERT_EQUALS(vector_cd_add(x, y), SCALAR_OK);
+    vector_add(u, v);
+    vector_t* sum = vector_cd_to_vector(x);
+    ASSERT_TRUE(vector_equals(sum, u));
+    vector_delete(sum);
+
+    // different denominators meet at their lcm
+    for (size_t i = 0; i < SIZE; i++) {
+        y->num[i] *= 7;
+    }
+    y->den *= 7;
+    ASSERT_EQUALS(vector_cd_sub(x, y), SCALAR_OK);
+    ASSERT_EQUALS(x->den, 2520);
+    vector_sub(u, v);
+    sum = vector_cd_to_vector(x);
+    ASSERT_TRUE(vector_equals(sum, u));
+    vector_delete(sum);
+
+    vector_cd_normalize(x);
+    sum = vector_cd_to_vector(x);
+    ASSERT_TRUE(vector_equals(sum, u));
+    vector_delete(sum);
+
+    // an overflowing sum leaves u as it was
+    x->num[SIZE - 1] = INT64_MAX;
+    y->num[SIZE - 1] = 1;
+    y->den           = x->den;
+    vector_t* before = vector_cd_to_vector(x);
+    ASSERT_EQUALS(vector_cd_add(x, y), SCALAR_OVERFLOW);
+    vector_t* after = vector_cd_to_vector(x);
+    ASSERT_TRUE(vector_equals(before, after));
+
+    ASSERT_EQUALS(vector_cd_sub(x, x), SCALAR_OK);
+    vector_cd_normalize(x);
+    ASSERT_EQUALS(x->num[0], 0);
+    ASSERT_EQUALS(x->den, 1);
+
+    vector_delete(after);
+    vector_delete(before);
+    vector_cd_delete(y);
+    vector_cd_delete(x);
+    vector_delete(v);
+    vector_delete(u);
+    return TEST_PASS;
+}
+
+static bool vector_cd_dot_prod_test(T* t)
+{
+    vector_t*    u = vector_fixture(SIZE, 3, fraction);
+    vector_t*    v = vector_fixture(SIZE, 4, fraction);
+    vector_cd_t* x = vector_cd_from(u);
+    vector_cd_t* y = vector_cd_from(v);
+
+    scalar_t* p = vector_cd_dot_prod(x, y);
+    scalar_t* q = vector_dot_prod(u, v);
+    ASSERT_TRUE(scalar_equals(p, q));
+    scalar_delete(p);
+    scalar_delete(q);
+
+    // sums past 128 bits spill into a promoted result
+    for (size_t i = 0; i < SIZE; i++) {
+        x->num[i] = INT64_MAX - (int64_t)i;
+        y->num[i] = INT64_MAX;
+    }
+
+    vector_t* a = vector_cd_to_vector(x);
+    vector_t* b = vector_cd_to_vector(y);
+
+    p = vector_cd_dot_prod(x, y);
+    q = vector_dot_prod(a, b);
+    ASSERT_TRUE(scalar_is_big(p));
+    ASSERT_TRUE(scalar_equals(p, q));
+
+    scalar_delete(p);
+    scalar_delete(q);
+    vector_delete(b);
+    vector_delete(a);
+    vector_cd_delete(y);
+    vector_cd_delete(x);
+    vector_delete(v);
+    vector_delete(u);
+    return TEST_PASS;
+}
+
+static bool matrix_cd_prod_test(T* t)
+{
+    matrix_t*    a = matrix_fixture(SIZE, SIZE + 2, 5, fraction);
+    matrix_t*    b = matrix_fixture(SIZE + 2, SIZE - 3, 6, fraction);
+    matrix_cd_t* x = matrix_cd_from(a);
+    matrix_cd_t* y = matrix_cd_from(b);
+
+    ASSERT_NOT_NULL(x);
+    ASSERT_NOT_NULL(y);
+
+    matrix_t*    c = matrix_prod(a, b);
+    matrix_cd_t* z = matrix_cd_prod(x, y);
+    ASSERT_NOT_NULL(z);
+
+    matrix_t* d = matrix_cd_to_matrix(z);
+    ASSERT_TRUE(matrix_equals(c, d));
+    matrix_delete(d);
+    matrix_cd_delete(z);
+
+    // Scaling both sides by 2^40 needs 128-bit sums and a 128-bit
+    // denominator, which reduces back to 64 bits
+    for (size_t i = 0; i < x->m * x->n; i++) {
+        x->num[i] *= 1LL << 40;
+    }
+    for (size_t i = 0; i < y->m * y->n; i++) {
+        y->num[i] *= 1LL << 40;
+    }
+    x->den <<= 40;
+    y->den <<= 40;
+
+    z = matrix_cd_prod(x, y);
+    ASSERT_NOT_NULL(z);
+    d = matrix_cd_to_matrix(z);
+    ASSERT_TRUE(matrix_equals(c, d));
+    matrix_delete(d);
+    matrix_cd_delete(z);
+
+    // Ones over two primes above 2^32: the product has no 64-bit denominator
+    for (size_t i = 0; i < x->m * x->n; i++) {
+        x->num[i] = 1;
+    }
+    for (size_t i = 0; i < y->m * y->n; i++) {
+        y->num[i] = 1;
+    }
+    x->den = 4294967311u;
+    y->den = 4294967357u;
+    ASSERT_NULL(matrix_cd_prod(x, y));
+
+    matrix_delete(c);
+    matrix_delete(b);
+    matrix_delete(a);
+    matrix_cd_delete(y);
+    matrix_cd_delete(x);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(vector_cd_convert);
+    TEST(vector_cd_add);
+    TEST(vector_cd_dot_prod);
+    TEST(matrix_cd_prod);
+
+    TEST_END();
+}
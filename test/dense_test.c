@@ -0,0 +1,186 @@
+#include "../dense.h"
+#include "fixture.h"
+#include "test.h"
+#include <math.h>
+
+static dense_isa_t isas[] = { DENSE_ISA_SCALAR, DENSE_ISA_AVX2, DENSE_ISA_AVX512 };
+
+// Small integers keep every product and sum exact in both element types,
+// so the results can be compared with the rational ones for equality
+static scalar_t small(uint64_t seed, size_t i)
+{
+    uint64_t a = fixture_spread(seed, i) % 17;
+
+    return scalar_make(a, 1, (a + i) % 3 == 0);
+}
+
+static bool matrix_d_prod_test(T* t)
+{
+    // odd sizes leave partial strips and row blocks on every side, and the
+    // larger one goes through panels and the pool
+    size_t sizes[][3] = { { 1, 1, 1 }, { 7, 5, 3 }, { 37, 41, 35 }, { 130, 300, 133 } };
+
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        dense_set_isa(isas[k]);
+
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            matrix_t* a = matrix_fixture(sizes[s][0], sizes[s][1], 1, small);
+            matrix_t* b = matrix_fixture(sizes[s][1], sizes[s][2], 2, small);
+            matrix_t* c = matrix_prod(a, b);
+
+            matrix_d_t* x = matrix_d_from(a);
+            matrix_d_t* y = matrix_d_from(b);
+            matrix_d_t* z = matrix_d_prod(x, y);
+            matrix_f_t* u = matrix_f_from(a);
+            matrix_f_t* v = matrix_f_from(b);
+            matrix_f_t* w = matrix_f_prod(u, v);
+
+            ASSERT_EQUALS(z->m, c->m);
+            ASSERT_EQUALS(z->n, c->n);
+            for (size_t i = 0; i < c->m * c->n; i++) {
+                ASSERT_TRUE(z->data[i] == scalar_to_double(&c->data[i]));
+                ASSERT_TRUE(w->data[i] == (float)scalar_to_double(&c->data[i]));
+            }
+
+            matrix_f_delete(w);
+            matrix_f_delete(v);
+            matrix_f_delete(u);
+            matrix_d_delete(z);
+            matrix_d_delete(y);
+            matrix_d_delete(x);
+            matrix_delete(c);
+            matrix_delete(b);
+            matrix_delete(a);
+        }
+    }
+
+    dense_set_isa(DENSE_ISA_AVX512);
+    return TEST_PASS;
+}
+
+static bool vector_d_dot_prod_test(T* t)
+{
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        dense_set_isa(isas[k]);
+
+        for (size_t n = 0; n < 70; n += 3) {
+            matrix_t* a = matrix_fixture(2, n, n, small);
+            vector_t* p = matrix_row(a, 0);
+            vector_t* q = matrix_row(a, 1);
+            scalar_t* r = vector_dot_prod(p, q);
+
+            vector_d_t* x = vector_d_from(p);
+            vector_d_t* y = vector_d_from(q);
+            ASSERT_TRUE(vector_d_dot_prod(x, y) == scalar_to_double(r));
+
+            // x = -2 (p + q) - q
+            vector_d_add(x, y);
+            vector_d_scale(x, -2);
+            vector_d_sub(x, y);
+            for (size_t i = 0; i < n; i++) {
+                double pi = scalar_to_double(&p->items[i]);
+                double qi = scalar_to_double(&q->items[i]);
+                ASSERT_TRUE(x->items[i] == -2 * (pi + qi) - qi);
+            }
+
+            vector_d_delete(y);
+            vector_d_delete(x);
+            scalar_delete(r);
+            vector_delete(q);
+            vector_delete(p);
+            matrix_delete(a);
+        }
+    }
+
+    dense_set_isa(DENSE_ISA_AVX512);
+    return TEST_PASS;
+}
+
+static bool matrix_d_transpose_test(T* t)
+{
+    matrix_t*   a  = matrix_fixture(19, 37, 3, small);
+    matrix_t*   at = matrix_transpose(a);
+    matrix_d_t* x  = matrix_d_from(a);
+    matrix_d_t* y  = matrix_d_transpose(x);
+
+    ASSERT_EQUALS(y->m, 37);
+    ASSERT_EQUALS(y->n, 19);
+    for (size_t i = 0; i < 37 * 19; i++) {
+        ASSERT_TRUE(y->data[i] == scalar_to_double(&at->data[i]));
+    }
+
+    matrix_d_delete(y);
+    matrix_d_delete(x);
+    matrix_delete(at);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool matrix_d_lu_test(T* t)
+{
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        dense_set_isa(isas[k]);
+
+        for (size_t n = 1; n <= 300; n += 299 / (n + 1) + 1) {
+            matrix_t*   a = matrix_fixture(n, n, n, small);
+            matrix_d_t* x = matrix_d_from(a);
+            matrix_d_t *l, *u, *p;
+
+            matrix_d_lu(x, &l, &u, &p);
+
+            matrix_d_t* pa = matrix_d_prod(p, x);
+            matrix_d_t* lu = matrix_d_prod(l, u);
+
+            for (size_t i = 0; i < n; i++) {
+                for (size_t j = 0; j < n; j++) {
+                    // partial pivoting keeps |L| <= 1
+                    ASSERT_TRUE(j > i || fabs(matrix_at(l, i, j)) <= 1);
+                    ASSERT_TRUE(j >= i || matrix_at(u, i, j) == 0);
+                    ASSERT_TRUE(fabs(matrix_at(pa, i, j) - matrix_at(lu, i, j)) <= 1e-9 * n * 16);
+                }
+            }
+
+            matrix_d_delete(lu);
+            matrix_d_delete(pa);
+            matrix_d_delete(p);
+            matrix_d_delete(u);
+            matrix_d_delete(l);
+            matrix_d_delete(x);
+            matrix_delete(a);
+        }
+    }
+
+    // the same contract as matrix_lu on an exact case, with a row swap
+    int64_t     av[] = { 0, 2, 1, 1, 1, 1, 2, 1, 3 };
+    matrix_f_t* y    = matrix_f_new(3, 3);
+    matrix_f_t *l, *u, *p;
+
+    for (size_t i = 0; i < 9; i++) {
+        y->data[i] = av[i];
+    }
+
+    matrix_f_lu(y, &l, &u, &p);
+    ASSERT_TRUE(matrix_at(p, 0, 2) == 1);
+    ASSERT_TRUE(matrix_at(u, 0, 0) == 2);
+    ASSERT_TRUE(fabsf(matrix_at(u, 0, 0) * matrix_at(u, 1, 1) * matrix_at(u, 2, 2)) == 3);
+
+    matrix_f_delete(p);
+    matrix_f_delete(u);
+    matrix_f_delete(l);
+    matrix_f_delete(y);
+
+    dense_set_isa(DENSE_ISA_AVX512);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(matrix_d_prod);
+    TEST(vector_d_dot_prod);
+    TEST(matrix_d_transpose);
+    TEST(matrix_d_lu);
+
+    TEST_END();
+}
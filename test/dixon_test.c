@@ -0,0 +1,101 @@
+#include "../dixon.h"
+#include "../lu.h"
+#include "fixture.h"
+#include "test.h"
+
+static bool matrix_solve_exact_test(T* t)
+{
+    // integer and rational systems, and integer entries up to 2^62 for
+    // the most headroom the residuals need
+    for (size_t n = 0; n <= 40; n += n < 8 ? 1 : 16) {
+        for (uint64_t seed = 0; seed < 4; seed++) {
+            int       bits = seed == 3 ? 62 : 12;
+            uint64_t  den  = seed % 3 == 0 ? 1 : 30;
+            matrix_t* a    = matrix_random(n, n, bits, den, seed + 100 * n);
+            vector_t* b    = vector_random(n, bits, den, seed + 100 * n + 50);
+
+            if (!matrix_is_inversible(a)) {
+                matrix_delete(a);
+                vector_delete(b);
+                continue;
+            }
+
+            lu_t*     lu = lu_new(a);
+            vector_t* x  = lu_solve(lu, b);
+            vector_t* y  = matrix_solve_exact(a, b);
+
+            ASSERT_EQUALS(y->n, n);
+            ASSERT_EQUALS(y->integer, x->integer);
+            for (size_t i = 0; i < n; i++) {
+                ASSERT_TRUE(scalar_equals(&x->items[i], &y->items[i]));
+            }
+
+            vector_delete(y);
+            vector_delete(x);
+            lu_delete(lu);
+            vector_delete(b);
+            matrix_delete(a);
+        }
+    }
+
+    // a zero leading pivot
+    int64_t   av[] = { 0, 2, 1, 1, 1, 1, 2, 1, 3 };
+    int64_t   bv[] = { 1, 0, -1 };
+    matrix_t* a    = matrix_square(3);
+    vector_t* b    = vector_new(3);
+
+    for (size_t i = 0; i < 9; i++) {
+        scalar_t* x = scalar_from(av[i]);
+        scalar_copy(&a->data[i], x);
+        scalar_delete(x);
+    }
+
+    for (size_t i = 0; i < 3; i++) {
+        scalar_t* x = scalar_from(bv[i]);
+        scalar_copy(&b->items[i], x);
+        scalar_delete(x);
+    }
+
+    matrix_refresh_integer(a);
+    vector_refresh_integer(b);
+
+    // x = (-1/3, 2/3, -1/3)
+    vector_t* x = matrix_solve_exact(a, b);
+    ASSERT_EQUALS(x->items[0].num, -1);
+    ASSERT_EQUALS(x->items[0].den, 3);
+    ASSERT_EQUALS(x->items[1].num, 2);
+    ASSERT_EQUALS(x->items[1].den, 3);
+    ASSERT_EQUALS(x->items[2].num, -1);
+    ASSERT_EQUALS(x->items[2].den, 3);
+    vector_delete(x);
+
+    // a promoted entry goes through LU
+    scalar_t* big = scalar_new(UINT64_MAX, 3, false);
+    scalar_mul(&a->data[0], big, big);
+    matrix_refresh_integer(a);
+
+    lu_t*     lu = lu_new(a);
+    vector_t* y  = lu_solve(lu, b);
+    vector_t* z  = matrix_solve_exact(a, b);
+
+    for (size_t i = 0; i < 3; i++) {
+        ASSERT_TRUE(scalar_equals(&y->items[i], &z->items[i]));
+    }
+
+    vector_delete(z);
+    vector_delete(y);
+    lu_delete(lu);
+    scalar_delete(big);
+    vector_delete(b);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(matrix_solve_exact);
+
+    TEST_END();
+}
@@ -0,0 +1,122 @@
+#ifndef FIXTURE_H
+#define FIXTURE_H
+
+#include "../matrix.h"
+#include "../scalar.h"
+#include "../vector.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Inputs and comparisons shared by the tests. Every sequence is a fixed
+// function of its seed, so a failing case can be replayed.
+
+// A 64-bit linear congruential generator, returning the top 53 bits of the
+// state
+static inline uint64_t fixture_next(uint64_t* state)
+{
+    *state = *state * 6364136223846793005u + 1442695040888963407u;
+    return *state >> 11;
+}
+
+// A magnitude of up to bits bits over a denominator of up to den, with a
+// random sign
+static inline scalar_t scalar_random(int bits, uint64_t den, uint64_t* seed)
+{
+    uint64_t a = fixture_next(seed) & (((uint64_t)1 << bits) - 1);
+    uint64_t b = 1 + fixture_next(seed) % den;
+
+    return scalar_make(a, b, fixture_next(seed) & 1);
+}
+
+static inline matrix_t* matrix_random(size_t m, size_t n, int bits, uint64_t den, uint64_t seed)
+{
+    matrix_t* matrix = matrix_new(m, n);
+
+    for (size_t i = 0; i < m * n; i++) {
+        matrix->data[i] = scalar_random(bits, den, &seed);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static inline vector_t* vector_random(size_t n, int bits, uint64_t den, uint64_t seed)
+{
+    vector_t* vector = vector_new(n);
+
+    for (size_t i = 0; i < n; i++) {
+        vector->items[i] = scalar_random(bits, den, &seed);
+    }
+
+    vector_refresh_integer(vector);
+    return vector;
+}
+
+// For inputs of a given shape rather than random ones: a test provides the
+// entry at index i, usually built on fixture_spread(seed, i), and the
+// factories below fill a vector or, row after row, a matrix with them
+typedef scalar_t (*fixture_entry_t)(uint64_t seed, size_t i);
+
+static inline uint64_t fixture_spread(uint64_t seed, size_t i)
+{
+    return seed * 2654435761u + i * 40503u;
+}
+
+static inline vector_t* vector_fixture(size_t n, uint64_t seed, fixture_entry_t entry)
+{
+    vector_t* vector = vector_new(n);
+
+    for (size_t i = 0; i < n; i++) {
+        vector->items[i] = entry(seed, i);
+    }
+
+    vector_refresh_integer(vector);
+    return vector;
+}
+
+static inline matrix_t* matrix_fixture(size_t m, size_t n, uint64_t seed, fixture_entry_t entry)
+{
+    matrix_t* matrix = matrix_new(m, n);
+
+    for (size_t i = 0; i < m * n; i++) {
+        matrix->data[i] = entry(seed, i);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static inline bool vector_equals(const vector_t* u, const vector_t* v)
+{
+    if (u->n != v->n) {
+        return false;
+    }
+
+    for (size_t i = 0; i < u->n; i++) {
+        if (!scalar_equals(&vector_at(u, i), &vector_at(v, i))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static inline bool matrix_equals(const matrix_t* a, const matrix_t* b)
+{
+    if (a->m != b->m || a->n != b->n) {
+        return false;
+    }
+
+    for (size_t i = 0; i < a->m; i++) {
+        for (size_t j = 0; j < a->n; j++) {
+            if (!scalar_equals(&matrix_at(a, i, j), &matrix_at(b, i, j))) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+#endif /* fixture.h */
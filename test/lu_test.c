@@ -0,0 +1,290 @@
+#include "../lu.h"
+#include "../matrix.h"
+#include "../pool.h"
+#include "../vector.h"
+#include "fixture.h"
+#include "test.h"
+
+static matrix_t* matrix_of(size_t n, int64_t* vals)
+{
+    matrix_t* matrix = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_from(vals[i]);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    return matrix;
+}
+
+static bool lu_new_test(T* t)
+{
+    int64_t   vals[] = { 1, 3, 5, 2, 4, 7, 1, 1, 0 };
+    matrix_t* a      = matrix_of(3, vals);
+    lu_t*     lu     = lu_new(a);
+
+    ASSERT_NOT_NULL(lu);
+    ASSERT_FALSE(lu->singular);
+
+    // |2| is the largest entry of the first column
+    ASSERT_EQUALS(lu->perm[0], 1);
+
+    // rebuild P.A and L.U
+    matrix_t* l  = matrix_eye(3);
+    matrix_t* u  = matrix_square(3);
+    matrix_t* pa = matrix_square(3);
+
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            scalar_copy(j < i ? &matrix_at(l, i, j) : &matrix_at(u, i, j), &matrix_at(lu->LU, i, j));
+            scalar_copy(&matrix_at(pa, i, j), &matrix_at(a, lu->perm[i], j));
+        }
+    }
+
+    matrix_t* prod = matrix_prod(l, u);
+    ASSERT_TRUE(matrix_equals(prod, pa));
+
+    matrix_delete(prod);
+    matrix_delete(pa);
+    matrix_delete(u);
+    matrix_delete(l);
+    lu_delete(lu);
+    ASSERT_NULL(lu);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool lu_singular_test(T* t)
+{
+    int64_t   vals[] = { 1, 2, 3, 2, 4, 6, 0, 1, 1 };
+    matrix_t* a      = matrix_of(3, vals);
+    lu_t*     lu     = lu_new(a);
+
+    ASSERT_TRUE(lu->singular);
+
+    lu_delete(lu);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool matrix_lu_test(T* t)
+{
+    int64_t   vals[] = { 0, 1, 2, 3, 1, 4, 1, 1, 2, 0, 1, 1, 5, 2, 0, 1 };
+    matrix_t* a      = matrix_of(4, vals);
+    matrix_t *l, *u, *p;
+
+    matrix_lu(a, &l, &u, &p);
+
+    matrix_t* pa = matrix_prod(p, a);
+    matrix_t* lu = matrix_prod(l, u);
+    ASSERT_TRUE(matrix_equals(pa, lu));
+
+    for (size_t i = 0; i < 4; i++) {
+        ASSERT_TRUE(scalar_equals(&matrix_at(l, i, i), &one));
+        for (size_t j = i + 1; j < 4; j++) {
+            ASSERT_TRUE(scalar_equals(&matrix_at(l, i, j), &zero));
+            ASSERT_TRUE(scalar_equals(&matrix_at(u, j, i), &zero));
+        }
+    }
+
+    matrix_delete(lu);
+    matrix_delete(pa);
+    matrix_delete(p);
+    matrix_delete(u);
+    matrix_delete(l);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool lu_solve_test(T* t)
+{
+    int64_t   vals[] = { 2, 1, -1, -3, -1, 2, -2, 1, 2 };
+    matrix_t* a      = matrix_of(3, vals);
+    lu_t*     lu     = lu_new(a);
+
+    // 2x + y - z = 8, -3x - y + 2z = -11, -2x + y + 2z = -3 => (2, 3, -1)
+    int64_t   bv[] = { 8, -11, -3 };
+    int64_t   xv[] = { 2, 3, -1 };
+    vector_t* b    = vector_new(3);
+
+    for (size_t i = 0; i < 3; i++) {
+        scalar_t* x = scalar_from(bv[i]);
+        vector_set(b, i, x);
+        scalar_delete(x);
+    }
+
+    vector_t* x = lu_solve(lu, b);
+
+    for (size_t i = 0; i < 3; i++) {
+        scalar_t* z = scalar_from(xv[i]);
+        ASSERT_TRUE(scalar_equals(&x->items[i], z));
+        scalar_delete(z);
+    }
+
+    // the same system against several right-hand sides at once
+    matrix_t* bs = matrix_new(3, 40);
+    for (size_t i = 0; i < 3; i++) {
+        for (size_t j = 0; j < 40; j++) {
+            scalar_t* y = scalar_new(i + j, 1 + j % 3, j % 2);
+            matrix_set(bs, i, j, y);
+            scalar_delete(y);
+        }
+    }
+
+    matrix_t* xs   = lu_solve_many(lu, bs);
+    matrix_t* prod = matrix_prod(a, xs);
+    ASSERT_TRUE(matrix_equals(prod, bs));
+
+    matrix_delete(prod);
+    matrix_delete(xs);
+    matrix_delete(bs);
+    vector_delete(x);
+    vector_delete(b);
+    lu_delete(lu);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool lu_inverse_test(T* t)
+{
+    int64_t   vals[] = { 0, 1, 2, 3, 1, 4, 1, 1, 2, 0, 1, 1, 5, 2, 0, 1 };
+    matrix_t* a      = matrix_of(4, vals);
+    matrix_t* eye    = matrix_eye(4);
+
+    matrix_t* inverse = matrix_inverse(a);
+    matrix_t* prod    = matrix_prod(a, inverse);
+    ASSERT_TRUE(matrix_equals(prod, eye));
+
+    lu_t*     lu  = lu_new(a);
+    scalar_t* det = lu_det(lu);
+    scalar_t* ref = matrix_det(a);
+    ASSERT_TRUE(scalar_equals(det, ref));
+
+    scalar_delete(ref);
+    scalar_delete(det);
+    lu_delete(lu);
+    matrix_delete(prod);
+    matrix_delete(inverse);
+    matrix_delete(eye);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+// Fractions, half of them zeros to keep them small, and with singular set
+// a column that is twice another one
+static matrix_t* lu_random(size_t n, unsigned seed, bool singular)
+{
+    matrix_t* matrix = matrix_square(n);
+
+    srand(seed);
+    for (size_t i = 0; i < n * n; i++) {
+        matrix->data[i] = rand() % 2 ? zero : scalar_make(rand() % 19, 1 + rand() % 6, rand() % 2);
+    }
+
+    for (size_t i = 0; singular && i < n; i++) {
+        scalar_scale(&matrix_at(matrix, i, n - 1), &matrix_at(matrix, i, 1), 2, false);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static bool lu_factorize_tiled_test(T* t)
+{
+    struct {
+        size_t n, tile;
+        bool   singular;
+    } cases[] = {
+        { 9, 2, false }, { 37, 8, false }, { 37, 8, true }, { 48, 16, false }, { 50, 7, true },
+    };
+    size_t threads[] = { 1, 4 };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        size_t    n = cases[c].n;
+        matrix_t* a = lu_random(n, 7 + c, cases[c].singular);
+        matrix_t* x = matrix_square(n);
+        size_t    px[64], py[64];
+        bool      ox, oy;
+
+        for (size_t i = 0; i < n * n; i++) {
+            scalar_copy(&x->data[i], &a->data[i]);
+        }
+
+        bool rx = lu_factorize(x, px, &ox);
+        ASSERT_EQUALS(rx, !cases[c].singular);
+
+        // the same pivots and factors whatever the tiles and the threads
+        for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+            pool_set_threads(threads[k]);
+            lu_set_tile(cases[c].tile);
+
+            matrix_t* y = matrix_square(n);
+
+            for (size_t i = 0; i < n * n; i++) {
+                scalar_copy(&y->data[i], &a->data[i]);
+            }
+
+            bool ry = lu_factorize_tiled(y, py, &oy);
+
+            ASSERT_EQUALS(rx, ry);
+            ASSERT_EQUALS(ox, oy);
+            for (size_t i = 0; i < n; i++) {
+                ASSERT_EQUALS(px[i], py[i]);
+            }
+            ASSERT_TRUE(matrix_equals(x, y));
+
+            matrix_delete(y);
+        }
+
+        matrix_delete(x);
+        matrix_delete(a);
+    }
+
+    // lu_new and matrix_lu take the tiled path from 128 on. A band with the
+    // larger entries below the diagonal pivots at every step.
+    pool_set_threads(4);
+    lu_set_tile(32);
+
+    matrix_t* a = matrix_square(130);
+    matrix_t *l, *u, *p;
+
+    for (size_t i = 0; i < 130; i++) {
+        matrix_at(a, i, i) = scalar_of(1 + i % 5);
+
+        if (i + 1 < 130) {
+            matrix_at(a, i, i + 1) = scalar_of(-1);
+            matrix_at(a, i + 1, i) = scalar_of(7);
+        }
+    }
+
+    matrix_lu(a, &l, &u, &p);
+
+    matrix_t* pa = matrix_prod(p, a);
+    matrix_t* lu = matrix_prod(l, u);
+    ASSERT_TRUE(matrix_equals(pa, lu));
+
+    matrix_delete(lu);
+    matrix_delete(pa);
+    matrix_delete(p);
+    matrix_delete(u);
+    matrix_delete(l);
+    matrix_delete(a);
+
+    pool_set_threads(0);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(lu_new);
+    TEST(lu_singular);
+    TEST(matrix_lu);
+    TEST(lu_solve);
+    TEST(lu_inverse);
+    TEST(lu_factorize_tiled);
+
+    TEST_END();
+}
@@ -0,0 +1,751 @@
+#include "../matrix.h"
+#include "../vector.h"
+#include "test.h"
+#include <pthread.h>
+#include <string.h>
+
+static bool matrix_new_test(T* t)
+{
+    matrix_t* matrix = matrix_new(3, 5);
+    ASSERT_NOT_NULL(matrix);
+    ASSERT_EQUALS(matrix->m, 3);
+    ASSERT_EQUALS(matrix->n, 5);
+    ASSERT_EQUALS(matrix->ld, 5);
+
+    // rows are laid out back to back
+    ASSERT_EQUALS(matrix_row_ptr(matrix, 1), matrix->data + 5);
+    ASSERT_EQUALS(&matrix_at(matrix, 2, 4), matrix->data + 14);
+
+    for (size_t i = 0; i < 3 * 5; i++) {
+        ASSERT_TRUE(scalar_equals(&matrix->data[i], &zero));
+    }
+
+    matrix_delete(matrix);
+    ASSERT_NULL(matrix);
+    return TEST_PASS;
+}
+
+static bool matrix_transpose_test(T* t)
+{
+    matrix_t* matrix = matrix_new(2, 3);
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            scalar_t* x = scalar_from(i * 3 + j);
+            matrix_set(matrix, i, j, x);
+            scalar_delete(x);
+        }
+    }
+
+    matrix_t* transpose = matrix_transpose(matrix);
+    ASSERT_EQUALS(transpose->m, 3);
+    ASSERT_EQUALS(transpose->n, 2);
+
+    for (size_t i = 0; i < 2; i++) {
+        for (size_t j = 0; j < 3; j++) {
+            ASSERT_TRUE(scalar_equals(&matrix_at(transpose, j, i), &matrix_at(matrix, i, j)));
+        }
+    }
+
+    matrix_delete(transpose);
+    matrix_delete(matrix);
+    return TEST_PASS;
+}
+
+static bool matrix_prod_test(T* t)
+{
+    // [1 2 3]   [1 0]   [ 4  5]
+    // [4 5 6] x [0 1] = [10 11]
+    //           [1 1]
+    matrix_t* a = matrix_new(2, 3);
+    matrix_t* b = matrix_new(3, 2);
+
+    int64_t av[] = { 1, 2, 3, 4, 5, 6 };
+    int64_t bv[] = { 1, 0, 0, 1, 1, 1 };
+    int64_t cv[] = { 4, 5, 10, 11 };
+
+    for (size_t i = 0; i < 6; i++) {
+        scalar_t* x = scalar_from(av[i]);
+        scalar_t* y = scalar_from(bv[i]);
+        scalar_copy(&a->data[i], x);
+        scalar_copy(&b->data[i], y);
+        scalar_delete(x);
+        scalar_delete(y);
+    }
+
+    matrix_t* c = matrix_prod(a, b);
+    ASSERT_EQUALS(c->m, 2);
+    ASSERT_EQUALS(c->n, 2);
+
+    for (size_t i = 0; i < 4; i++) {
+        scalar_t* z = scalar_from(cv[i]);
+        ASSERT_TRUE(scalar_equals(&c->data[i], z));
+        scalar_delete(z);
+    }
+
+    matrix_delete(c);
+    matrix_delete(b);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool matrix_prod_strassen_test(T* t)
+{
+    // odd sizes on every dimension exercise the peeling fix-ups
+    size_t m = 37, k = 41, n = 35;
+
+    matrix_t* a = matrix_new(m, k);
+    matrix_t* b = matrix_new(k, n);
+
+    for (size_t i = 0; i < m * k; i++) {
+        scalar_t* x = scalar_new(i % 7, 1 + i % 3, i % 5 == 0);
+        scalar_copy(&a->data[i], x);
+        scalar_delete(x);
+    }
+
+    for (size_t i = 0; i < k * n; i++) {
+        scalar_t* x = scalar_new(i % 5, 1 + i % 2, i % 3 == 0);
+        scalar_copy(&b->data[i], x);
+        scalar_delete(x);
+    }
+
+    matrix_refresh_integer(a);
+    matrix_refresh_integer(b);
+
+    matrix_set_strassen_cutoff(0);
+    matrix_t* classic = matrix_prod(a, b);
+
+    matrix_set_strassen_cutoff(8);
+    matrix_t* fast = matrix_prod(a, b);
+
+    matrix_set_strassen_cutoff(0);
+
+    for (size_t i = 0; i < m * n; i++) {
+        ASSERT_TRUE(scalar_equals(&classic->data[i], &fast->data[i]));
+    }
+
+    matrix_delete(fast);
+    matrix_delete(classic);
+    matrix_delete(b);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static matrix_t* matrix_of(size_t m, size_t n, int64_t* num, uint64_t* den)
+{
+    matrix_t* matrix = matrix_new(m, n);
+
+    for (size_t i = 0; i < m * n; i++) {
+        scalar_t* x = scalar_new(num[i] < 0 ? -num[i] : num[i], den == NULL ? 1 : den[i], num[i] < 0);
+        scalar_copy(&matrix->data[i], x);
+        scalar_delete(x);
+    }
+
+    matrix_refresh_integer(matrix);
+    return matrix;
+}
+
+static bool matrix_det_test(T* t)
+{
+    // the first pivot is zero, so the elimination has to swap rows
+    int64_t   av[] = { 0, 2, 1, 1, 1, 1, 2, 1, 3 };
+    matrix_t* a    = matrix_of(3, 3, av, NULL);
+    scalar_t* det  = matrix_det(a);
+    scalar_t* z    = scalar_from(-3);
+
+    ASSERT_TRUE(scalar_equals(det, z));
+    ASSERT_TRUE(matrix_is_inversible(a));
+
+    scalar_delete(z);
+    scalar_delete(det);
+    matrix_delete(a);
+
+    // 1/2 * 1/5 - 1/3 * 1/4 = 1/60
+    int64_t   bv[] = { 1, 1, 1, 1 };
+    uint64_t  bd[] = { 2, 3, 4, 5 };
+    matrix_t* b    = matrix_of(2, 2, bv, bd);
+
+    det = matrix_det(b);
+    ASSERT_EQUALS(det->num, 1);
+    ASSERT_EQUALS(det->den, 60);
+
+    scalar_delete(det);
+    matrix_delete(b);
+
+    // the last row is the sum of the others
+    int64_t   cv[] = { 1, 2, 3, 4, -5, 6, 5, -3, 9 };
+    matrix_t* c    = matrix_of(3, 3, cv, NULL);
+
+    det = matrix_det(c);
+    ASSERT_TRUE(scalar_equals(det, &zero));
+    ASSERT_FALSE(matrix_is_inversible(c));
+
+    scalar_delete(det);
+    matrix_delete(c);
+
+    // 2^40 . I has a 120-bit determinant, which comes out promoted
+    int64_t   dv[] = { 1L << 40, 0, 0, 0, 1L << 40, 0, 0, 0, 1L << 40 };
+    matrix_t* d    = matrix_of(3, 3, dv, NULL);
+
+    det = matrix_det(d);
+    ASSERT_TRUE(scalar_is_big(det));
+
+    char* str = scalar_string(det);
+    ASSERT_TRUE(strcmp(str, "1329227995784915872903807060280344576") == 0);
+    free(str);
+
+    scalar_delete(det);
+    matrix_delete(d);
+
+    // the first row has no 64-bit common denominator, so the elimination
+    // runs modulo primes: 1/p - 1/q = (q - p) / pq
+    int64_t   ev[] = { 1, 1, 1, 1 };
+    uint64_t  ed[] = { 1099511627791, 1099511627803, 1, 1 };
+    matrix_t* e    = matrix_of(2, 2, ev, ed);
+
+    scalar_t* r = scalar_sub_get(&matrix_at(e, 0, 0), &matrix_at(e, 0, 1));
+
+    det = matrix_det(e);
+    ASSERT_TRUE(scalar_is_big(det));
+    ASSERT_TRUE(scalar_equals(det, r));
+    ASSERT_TRUE(matrix_is_inversible(e));
+
+    scalar_delete(r);
+    scalar_delete(det);
+    matrix_delete(e);
+    return TEST_PASS;
+}
+
+static bool matrix_integer_test(T* t)
+{
+    int64_t   av[] = { 1, -2, 3, 4, 5, -6 };
+    int64_t   bv[] = { 7, 8, -9, 10, 11, 12 };
+    matrix_t* a    = matrix_of(2, 3, av, NULL);
+    matrix_t* b    = matrix_of(3, 2, bv, NULL);
+
+    ASSERT_TRUE(a->integer);
+
+    // [1 -2  3] x [ 7  8]   [ 58  24]
+    // [4  5 -6]   [-9 10] = [-83  10]
+    //             [11 12]
+    int64_t   cv[] = { 58, 24, -83, 10 };
+    matrix_t* c    = matrix_prod(a, b);
+    matrix_t* ref  = matrix_of(2, 2, cv, NULL);
+
+    ASSERT_TRUE(c->integer);
+    for (size_t i = 0; i < 4; i++) {
+        ASSERT_TRUE(scalar_equals(&c->data[i], &ref->data[i]));
+    }
+
+    // a fraction clears the flag, and the sum takes the rational path
+    scalar_t* half = scalar_new(1, 2, false);
+    matrix_set(c, 0, 1, half);
+    ASSERT_FALSE(c->integer);
+
+    matrix_add(c, ref);
+    scalar_t* x = scalar_new(49, 2, false);
+    ASSERT_TRUE(scalar_equals(&matrix_at(c, 0, 1), x));
+    ASSERT_FALSE(c->integer);
+
+    // and comes back once the fractions are gone: [116 0; -166 20] / 2
+    // is integer, another halving isn't
+    matrix_set(c, 0, 1, &zero);
+    matrix_scale(c, half);
+    ASSERT_TRUE(c->integer);
+    matrix_scale(c, half);
+    ASSERT_FALSE(c->integer);
+    scalar_t* two = scalar_from(2);
+    matrix_scale(c, two);
+    ASSERT_TRUE(c->integer);
+    ASSERT_EQUALS(matrix_at(c, 1, 0).num, -83);
+
+    // overflowing rows fall back on promotion
+    int64_t   dv[] = { INT64_MAX, 1, 2, 3 };
+    matrix_t* d    = matrix_of(2, 2, dv, NULL);
+    matrix_add(d, d);
+    ASSERT_TRUE(scalar_is_big(&matrix_at(d, 0, 0)));
+    ASSERT_EQUALS(matrix_at(d, 1, 1).num, 6);
+    ASSERT_FALSE(d->integer);
+
+    matrix_sub(d, d);
+    ASSERT_TRUE(d->integer);
+    ASSERT_TRUE(scalar_equals(&matrix_at(d, 0, 0), &zero));
+
+    // products past 64 bits as well
+    int64_t   ev[] = { 1L << 40, 1L << 40, 1, 1 };
+    matrix_t* e    = matrix_of(2, 2, ev, NULL);
+    matrix_t* f    = matrix_prod(e, e);
+    ASSERT_TRUE(scalar_is_big(&matrix_at(f, 0, 0)));
+    ASSERT_FALSE(f->integer);
+
+    // dot products too
+    vector_t* u   = matrix_row(e, 0);
+    vector_t* v   = matrix_col(e, 0);
+    scalar_t* dot = vector_dot_prod(u, v);
+    ASSERT_TRUE(u->integer && v->integer);
+    ASSERT_TRUE(scalar_is_big(dot));
+    ASSERT_TRUE(scalar_equals(dot, &matrix_at(f, 0, 0)));
+
+    scalar_delete(dot);
+    vector_delete(v);
+    vector_delete(u);
+    matrix_delete(f);
+    matrix_delete(e);
+    matrix_delete(d);
+    scalar_delete(two);
+    scalar_delete(x);
+    scalar_delete(half);
+    matrix_delete(ref);
+    matrix_delete(c);
+    matrix_delete(b);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool matrix_chol_test(T* t)
+{
+    // L = [1 0 0; 3 1 0; -4 5 1], D = (4, 1, 9)
+    int64_t   av[] = { 4, 12, -16, 12, 37, -43, -16, -43, 98 };
+    int64_t   lv[] = { 4, 0, 0, 3, 1, 0, -4, 5, 9 };
+    matrix_t* a    = matrix_of(3, 3, av, NULL);
+    matrix_t* ref  = matrix_of(3, 3, lv, NULL);
+    matrix_t* ldl  = matrix_chol(a);
+
+    for (size_t i = 0; i < 9; i++) {
+        ASSERT_TRUE(scalar_equals(&ldl->data[i], &ref->data[i]));
+    }
+
+    matrix_delete(ldl);
+    matrix_delete(ref);
+    matrix_delete(a);
+
+    // B^T.B + I is positive-definite, large enough to go through blocks
+    size_t    n = 45;
+    matrix_t* b = matrix_square(n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t* x = scalar_new((i * 7) % 5, 1, i % 3 == 0);
+        scalar_copy(&b->data[i], x);
+        scalar_delete(x);
+    }
+
+    matrix_t* bt   = matrix_transpose(b);
+    matrix_t* gram = matrix_prod(bt, b);
+    matrix_t* eye  = matrix_eye(n);
+    matrix_add(gram, eye);
+
+    matrix_t* l;
+    vector_t* d;
+    matrix_ldl(gram, &l, &d);
+
+    matrix_t* dm   = matrix_from_diag(d);
+    matrix_t* lt   = matrix_transpose(l);
+    matrix_t* ld   = matrix_prod(l, dm);
+    matrix_t* prod = matrix_prod(ld, lt);
+
+    for (size_t i = 0; i < n * n; i++) {
+        ASSERT_TRUE(scalar_equals(&prod->data[i], &gram->data[i]));
+    }
+
+    matrix_delete(prod);
+    matrix_delete(ld);
+    matrix_delete(lt);
+    matrix_delete(dm);
+    vector_delete(d);
+    matrix_delete(l);
+    matrix_delete(eye);
+    matrix_delete(gram);
+    matrix_delete(bt);
+    matrix_delete(b);
+    return TEST_PASS;
+}
+
+// A copy of the block of matrix at (i, j) of size (m, n)
+static matrix_t* matrix_block(matrix_t* matrix, size_t i, size_t j, size_t m, size_t n)
+{
+    matrix_t* block = matrix_new(m, n);
+
+    for (size_t r = 0; r < m; r++) {
+        for (size_t c = 0; c < n; c++) {
+            scalar_copy(&matrix_at(block, r, c), &matrix_at(matrix, i + r, j + c));
+        }
+    }
+
+    matrix_refresh_integer(block);
+    return block;
+}
+
+static bool matrix_view_test(T* t)
+{
+    // 5 x 6, row 2 holds thirds of which column 4 is not an integer
+    matrix_t* a = matrix_new(5, 6);
+    for (size_t i = 0; i < 30; i++) {
+        scalar_t* x = scalar_new(i * 7 % 11, i / 6 == 2 ? 3 : 1, i % 4 == 0);
+        scalar_copy(&a->data[i], x);
+        scalar_delete(x);
+    }
+    matrix_refresh_integer(a);
+
+    vector_t r = matrix_row_view(a, 3);
+    vector_t c = matrix_col_view(a, 4);
+    vector_t d = matrix_col_view(a, 1);
+
+    ASSERT_EQUALS(r.items, matrix_row_ptr(a, 3));
+    ASSERT_EQUALS(c.stride, a->ld);
+    ASSERT_TRUE(r.integer);
+    ASSERT_FALSE(c.integer);
+    ASSERT_TRUE(d.integer);
+
+    // the same results as on copies
+    vector_t* rc = matrix_row(a, 3);
+    vector_t* cc = matrix_col(a, 4);
+    vector_t* dc = matrix_col(a, 1);
+    vector_t* ec = matrix_col(a, 5);
+    scalar_t* x  = vector_dot_prod(&c, &d);
+    scalar_t* y  = vector_dot_prod(cc, dc);
+
+    ASSERT_TRUE(scalar_equals(x, y));
+    for (size_t i = 0; i < 5; i++) {
+        ASSERT_TRUE(scalar_equals(&vector_at(&c, i), &cc->items[i]));
+    }
+
+    // writes land in the matrix
+    vector_t e = matrix_col_view(a, 5);
+    vector_add(&e, &c);
+    vector_add(ec, cc);
+    vector_sub(&r, rc);
+    matrix_refresh_integer(a);
+
+    // (3, 5) went on to be cleared with row 3
+    for (size_t i = 0; i < 5; i++) {
+        ASSERT_TRUE(i == 3 || scalar_equals(&matrix_at(a, i, 5), &ec->items[i]));
+    }
+    for (size_t j = 0; j < 6; j++) {
+        ASSERT_TRUE(scalar_equals(&matrix_at(a, 3, j), &zero));
+    }
+    ASSERT_FALSE(a->integer);
+
+    // products of blocks, one of them integer
+    matrix_t  v  = matrix_view(a, 1, 2, 4, 3);
+    matrix_t  w  = matrix_view(a, 3, 0, 2, 4);
+    matrix_t* vc = matrix_block(a, 1, 2, 4, 3);
+    matrix_t* wc = matrix_block(a, 3, 0, 2, 4);
+    matrix_t* bt = matrix_transpose(&v);
+    matrix_t* p  = matrix_prod(bt, &v);
+    matrix_t* pc = matrix_prod(bt, vc);
+    matrix_t* q  = matrix_prod(&w, &v);
+    matrix_t* qc = matrix_prod(wc, vc);
+
+    ASSERT_EQUALS(v.ld, a->ld);
+    ASSERT_FALSE(v.integer);
+    ASSERT_TRUE(w.integer);
+    for (size_t i = 0; i < 9; i++) {
+        ASSERT_TRUE(scalar_equals(&p->data[i], &pc->data[i]));
+    }
+    for (size_t i = 0; i < 6; i++) {
+        ASSERT_TRUE(scalar_equals(&q->data[i], &qc->data[i]));
+    }
+
+    matrix_delete(qc);
+    matrix_delete(q);
+    matrix_delete(pc);
+    matrix_delete(p);
+    matrix_delete(bt);
+    matrix_delete(wc);
+    matrix_delete(vc);
+    scalar_delete(y);
+    scalar_delete(x);
+    vector_delete(ec);
+    vector_delete(dc);
+    vector_delete(cc);
+    vector_delete(rc);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool matrix_ptr_test(T* t)
+{
+    int64_t   av[] = { 2, 0, 1, 1, 3, 0, 0, 1, 4 };
+    matrix_t* a    = matrix_of(3, 3, av, NULL);
+
+    // entries are updated in place, the flag refreshed afterwards
+    scalar_t* p = matrix_ptr(a, 1, 2);
+    ASSERT_EQUALS(p, &matrix_at(a, 1, 2));
+
+    scalar_t half = scalar_make(1, 2, false);
+    scalar_add(p, p, &half);
+    matrix_refresh_integer(a);
+    ASSERT_FALSE(a->integer);
+
+    scalar_t v = matrix_val(a, 1, 2);
+    ASSERT_TRUE(scalar_equals(&v, &half));
+
+    // 2.(12 - 1/2) - 0 + 1.(1 - 0) = 24
+    scalar_t det = matrix_det_val(a);
+    ASSERT_EQUALS(det.num, 24);
+    ASSERT_EQUALS(det.den, 1);
+
+    // the same on the rows, through strided views as well
+    vector_t  r = matrix_row_view(a, 0);
+    vector_t  c = matrix_col_view(a, 2);
+    scalar_t* q = vector_ptr(&c, 1);
+    ASSERT_EQUALS(q, p);
+
+    // 2.1 + 0.(1/2) + 1.4 = 6
+    scalar_t dot = vector_dot_prod_val(&r, &c);
+    ASSERT_EQUALS(dot.num, 6);
+    ASSERT_EQUALS(dot.den, 1);
+
+    scalar_t  w = vector_val(&c, 2);
+    scalar_t* g = vector_get(&c, 2);
+    ASSERT_TRUE(scalar_equals(&w, g));
+    ASSERT_EQUALS(w.num, 4);
+
+    scalar_delete(g);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+#define CONCURRENT_THREADS 4
+#define CONCURRENT_N       72
+
+typedef struct matrix_concurrent_job {
+    matrix_t* a;
+    matrix_t* b;
+
+    // The results of every round, compared to the serial ones afterwards
+    matrix_t* c[3];
+    scalar_t  dot[3];
+    scalar_t  det[3];
+} matrix_concurrent_job_t;
+
+static void* matrix_concurrent_worker(void* arg)
+{
+    matrix_concurrent_job_t* job = arg;
+
+    for (size_t r = 0; r < 3; r++) {
+        matrix_t view = matrix_view(job->b, 0, 0, 6, 6);
+        vector_t row  = matrix_row_view(job->b, r);
+        vector_t col  = matrix_col_view(job->b, r);
+
+        job->c[r]   = matrix_prod(job->a, job->b);
+        job->dot[r] = vector_dot_prod_val(&row, &col);
+        job->det[r] = matrix_det_val(&view);
+    }
+
+    return NULL;
+}
+
+// Every thread multiplies its own matrix by a shared right operand, which
+// holds fractions and promoted entries, while the others read it as well
+static bool matrix_concurrent_test(T* t)
+{
+    size_t    n      = CONCURRENT_N;
+    matrix_t* shared = matrix_new(n, n);
+    matrix_t* copy   = matrix_new(n, n);
+
+    for (size_t i = 0; i < n * n; i++) {
+        scalar_t x = scalar_make(1 + i % 11, 1 + i % 4, i % 3 == 0);
+
+        // 2^62 / 3 on the diagonal: its products get promoted
+        if (i % (n + 1) == 0) {
+            scalar_t big = scalar_make((uint64_t)1 << 62, 3, false);
+            scalar_mul(&x, &x, &big);
+            scalar_mul(&x, &x, &big);
+        }
+
+        scalar_copy(&shared->data[i], &x);
+        scalar_copy(&copy->data[i], &x);
+        scalar_clear(&x);
+    }
+
+    matrix_refresh_integer(shared);
+    ASSERT_TRUE(scalar_is_big(&matrix_at(shared, 0, 0)));
+
+    matrix_concurrent_job_t jobs[CONCURRENT_THREADS];
+    pthread_t               threads[CONCURRENT_THREADS];
+
+    for (size_t k = 0; k < CONCURRENT_THREADS; k++) {
+        matrix_t* a = matrix_new(n, n);
+
+        for (size_t i = 0; i < n * n; i++) {
+            a->data[i] = scalar_make((i * (k + 3)) % 13, 1 + (i + k) % 5, (i + k) % 4 == 0);
+        }
+        matrix_refresh_integer(a);
+
+        jobs[k] = (matrix_concurrent_job_t){ .a = a, .b = shared };
+    }
+
+    for (size_t k = 0; k < CONCURRENT_THREADS; k++) {
+        ASSERT_EQUALS(pthread_create(&threads[k], NULL, matrix_concurrent_worker, &jobs[k]), 0);
+    }
+
+    for (size_t k = 0; k < CONCURRENT_THREADS; k++) {
+        pthread_join(threads[k], NULL);
+    }
+
+    // the shared operand is untouched
+    for (size_t i = 0; i < n * n; i++) {
+        ASSERT_TRUE(scalar_equals(&shared->data[i], &copy->data[i]));
+    }
+
+    // and every result matches the serial one
+    matrix_t view = matrix_view(shared, 0, 0, 6, 6);
+    scalar_t det  = matrix_det_val(&view);
+
+    for (size_t k = 0; k < CONCURRENT_THREADS; k++) {
+        matrix_t* c = matrix_prod(jobs[k].a, shared);
+
+        for (size_t r = 0; r < 3; r++) {
+            vector_t row = matrix_row_view(shared, r);
+            vector_t col = matrix_col_view(shared, r);
+            scalar_t dot = vector_dot_prod_val(&row, &col);
+
+            for (size_t i = 0; i < n * n; i++) {
+                ASSERT_TRUE(scalar_equals(&jobs[k].c[r]->data[i], &c->data[i]));
+            }
+
+            ASSERT_TRUE(scalar_equals(&jobs[k].dot[r], &dot));
+            ASSERT_TRUE(scalar_equals(&jobs[k].det[r], &det));
+
+            scalar_clear(&dot);
+            scalar_clear(&jobs[k].det[r]);
+            scalar_clear(&jobs[k].dot[r]);
+            matrix_delete(jobs[k].c[r]);
+        }
+
+        matrix_delete(c);
+        matrix_delete(jobs[k].a);
+    }
+
+    scalar_clear(&det);
+    matrix_delete(copy);
+    matrix_delete(shared);
+    return TEST_PASS;
+}
+
+typedef struct matrix_string_sink {
+    char*  str;
+    size_t len;
+    size_t chunks;
+} matrix_string_sink_t;
+
+static bool matrix_string_collect(void* ctx, const char* chunk, size_t len)
+{
+    matrix_string_sink_t* sink = ctx;
+
+    memcpy(sink->str + sink->len, chunk, len);
+    sink->len += len;
+    sink->chunks++;
+    return true;
+}
+
+static bool matrix_string_test(T* t)
+{
+    int64_t   av[] = { 1, -22, 1, 333, 0, -5, 4, 5, 6 };
+    uint64_t  ad[] = { 1, 1, 2, 1, 1, 7, 1, 1, 1 };
+    matrix_t* a    = matrix_of(3, 3, av, ad);
+
+    // columns right-aligned on their widest entry
+    const char* ref = "⎡  1 -22  1/2⎤\n"
+                      "⎢333   0 -5/7⎥\n"
+                      "⎣  4   5    6⎦";
+
+    char* str = matrix_string(a);
+    ASSERT_TRUE(strcmp(str, ref) == 0);
+    ASSERT_EQUALS(matrix_string_length(a), strlen(ref) + 1);
+    free(str);
+
+    // a single row reads like a vector
+    matrix_t row = matrix_view(a, 1, 0, 1, 3);
+    str          = matrix_string(&row);
+    ASSERT_TRUE(strcmp(str, "[333 0 -5/7]") == 0);
+    free(str);
+
+    // truncated like snprintf, the size needed is returned, with the
+    // column widths in a scratch array or measured on the fly
+    char   buf[64];
+    size_t widths[3];
+    ASSERT_EQUALS(matrix_format(a, buf, 8, widths), strlen(ref) + 1);
+    ASSERT_TRUE(memcmp(buf, ref, 7) == 0);
+    ASSERT_EQUALS(buf[7], '\0');
+    ASSERT_EQUALS(matrix_format(a, buf, 8, NULL), strlen(ref) + 1);
+    ASSERT_TRUE(memcmp(buf, ref, 7) == 0);
+    ASSERT_EQUALS(buf[7], '\0');
+
+    ASSERT_EQUALS(matrix_format(a, buf, sizeof(buf), NULL), strlen(ref) + 1);
+    ASSERT_TRUE(strcmp(buf, ref) == 0);
+    ASSERT_EQUALS(matrix_format(a, buf, sizeof(buf), widths), strlen(ref) + 1);
+    ASSERT_TRUE(strcmp(buf, ref) == 0);
+    ASSERT_EQUALS(widths[0], 3);
+    ASSERT_EQUALS(widths[2], 4);
+
+    // a larger matrix, with a promoted entry, goes out in several chunks
+    matrix_t* wide = matrix_new(60, 60);
+    scalar_t  x    = scalar_make((uint64_t)1 << 40, 3, true);
+    scalar_t  big  = zero;
+
+    for (size_t i = 0; i < 60 * 60; i++) {
+        wide->data[i] = scalar_make(i * 7919 % 1000, 1 + i % 11, i % 3 == 0);
+    }
+    scalar_mul(&big, &x, &x);
+    scalar_copy(&matrix_at(wide, 17, 42), &big);
+    matrix_refresh_integer(wide);
+
+    size_t len = matrix_string_length(wide);
+    str        = matrix_string(wide);
+    ASSERT_EQUALS(strlen(str) + 1, len);
+    ASSERT_TRUE(strstr(str, "1208925819614629174706176/9") != NULL);
+
+    // with and without the scratch widths
+    size_t               cols[60];
+    matrix_string_sink_t sink = { .str = malloc(len) };
+    ASSERT_TRUE(matrix_stream(wide, cols, matrix_string_collect, &sink));
+    ASSERT_EQUALS(sink.len, len - 1);
+    ASSERT_TRUE(sink.chunks > 1);
+    ASSERT_TRUE(memcmp(sink.str, str, len - 1) == 0);
+
+    sink.len = 0;
+    ASSERT_TRUE(matrix_stream(wide, NULL, matrix_string_collect, &sink));
+    ASSERT_EQUALS(sink.len, len - 1);
+    ASSERT_TRUE(memcmp(sink.str, str, len - 1) == 0);
+
+    // and the same through a FILE and a file descriptor
+    FILE* file = tmpfile();
+    ASSERT_TRUE(matrix_fprint(wide, file));
+    ASSERT_TRUE(matrix_write_fd(wide, -1) == false);
+    fflush(file);
+    ASSERT_TRUE(matrix_write_fd(wide, fileno(file)));
+
+    rewind(file);
+    for (size_t k = 0; k < 2; k++) {
+        ASSERT_EQUALS(fread(sink.str, 1, len - 1, file), len - 1);
+        ASSERT_TRUE(memcmp(sink.str, str, len - 1) == 0);
+    }
+    fclose(file);
+
+    scalar_clear(&big);
+    free(sink.str);
+    free(str);
+    matrix_delete(wide);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(matrix_new);
+    TEST(matrix_transpose);
+    TEST(matrix_prod);
+    TEST(matrix_prod_strassen);
+    TEST(matrix_det);
+    TEST(matrix_integer);
+    TEST(matrix_chol);
+    TEST(matrix_view);
+    TEST(matrix_ptr);
+    TEST(matrix_concurrent);
+    TEST(matrix_string);
+
+    TEST_END();
+}
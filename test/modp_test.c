@@ -0,0 +1,250 @@
+#include "../modp.h"
+#include "fixture.h"
+#include "test.h"
+#include <string.h>
+
+// Laplace expansion along the first of the rows left, the reference for
+// small determinants
+static void det_laplace(matrix_t* matrix, size_t row, bool* used, scalar_t* det)
+{
+    size_t n = matrix->n;
+
+    if (row == n) {
+        scalar_copy(det, &one);
+        return;
+    }
+
+    scalar_t minor = zero, x = zero;
+    bool     odd   = false;
+
+    scalar_copy(det, &zero);
+
+    for (size_t j = 0; j < n; j++) {
+        if (used[j]) {
+            continue;
+        }
+
+        used[j] = true;
+        det_laplace(matrix, row + 1, used, &minor);
+        used[j] = false;
+
+        scalar_mul(&x, &matrix_at(matrix, row, j), &minor);
+        if (odd) {
+            scalar_sub(det, det, &x);
+        } else {
+            scalar_add(det, det, &x);
+        }
+        odd = !odd;
+    }
+
+    scalar_clear(&x);
+    scalar_clear(&minor);
+}
+
+static bool modp_field_test(T* t)
+{
+    uint64_t primes[] = { 3, 1000000007, 9223372036854775783u };
+
+    for (size_t k = 0; k < sizeof(primes) / sizeof(primes[0]); k++) {
+        modp_t f;
+        modp_init(&f, primes[k]);
+
+        uint64_t seed = k;
+        for (int i = 0; i < 1000; i++) {
+            uint64_t a = fixture_next(&seed) % f.p, b = fixture_next(&seed) % f.p;
+            uint64_t x = modp_to(&f, a), y = modp_to(&f, b);
+
+            ASSERT_EQUALS(modp_from(&f, x), a);
+            ASSERT_EQUALS(modp_from(&f, modp_mul(&f, x, y)), (uint64_t)((uint128_t)a * b % f.p));
+            ASSERT_EQUALS(modp_from(&f, modp_add(&f, x, y)), (uint64_t)(((uint128_t)a + b) % f.p));
+            ASSERT_EQUALS(modp_from(&f, modp_sub(&f, x, y)), (uint64_t)(((uint128_t)a + f.p - b) % f.p));
+
+            if (a != 0) {
+                ASSERT_EQUALS(modp_from(&f, modp_mul(&f, x, modp_inverse(&f, x))), 1);
+            }
+        }
+
+        // 2^128 + 5 . 2^64 + 7
+        uint64_t limbs[] = { 7, 5, 1 };
+        uint64_t r2      = (uint128_t)((uint128_t)1 << 64) % f.p * (((uint128_t)1 << 64) % f.p) % f.p;
+        uint64_t r       = ((uint128_t)r2 + (uint128_t)5 * (((uint128_t)1 << 64) % f.p) + 7) % f.p;
+        ASSERT_EQUALS(modp_from(&f, modp_reduce(&f, limbs, 3)), r);
+    }
+
+    return TEST_PASS;
+}
+
+static bool is_prime_trial(uint64_t n)
+{
+    for (uint64_t d = 2; d * d <= n; d++) {
+        if (n % d == 0) {
+            return false;
+        }
+    }
+
+    return n > 1;
+}
+
+static bool modp_is_prime_test(T* t)
+{
+    ASSERT_FALSE(modp_is_prime(0));
+    ASSERT_FALSE(modp_is_prime(1));
+    ASSERT_TRUE(modp_is_prime(2));
+    ASSERT_TRUE(modp_is_prime(1361));
+    ASSERT_FALSE(modp_is_prime(1369));
+    ASSERT_TRUE(modp_is_prime(1000000007));
+
+    // strong pseudoprimes to several small bases
+    ASSERT_FALSE(modp_is_prime(3215031751u));
+    ASSERT_FALSE(modp_is_prime(3825123056546413051u));
+
+    // composites where a square reaches 1 before -1
+    uint64_t roots[] = { 3057601, 3828001, 5148001, 5968873 };
+    for (size_t i = 0; i < sizeof(roots) / sizeof(roots[0]); i++) {
+        ASSERT_FALSE(modp_is_prime(roots[i]));
+    }
+
+    // every number of two ranges, the second around 3057601, against trial
+    // division
+    uint64_t ranges[][2] = { { 0, 200000 }, { 3057000, 3058000 } };
+    for (size_t r = 0; r < 2; r++) {
+        for (uint64_t n = ranges[r][0]; n < ranges[r][1]; n++) {
+            ASSERT_EQUALS(modp_is_prime(n), is_prime_trial(n));
+        }
+    }
+
+    ASSERT_EQUALS(modp_prime(0), 9223372036854775783u);
+    for (size_t i = 1; i < 100; i++) {
+        ASSERT_TRUE(modp_prime(i) < modp_prime(i - 1));
+        ASSERT_TRUE(modp_is_prime(modp_prime(i)));
+    }
+
+    return TEST_PASS;
+}
+
+static bool modp_crt_test(T* t)
+{
+    uint64_t primes[4], residues[4];
+    for (size_t i = 0; i < 4; i++) {
+        primes[i] = modp_prime(i);
+    }
+
+    // -(3 . 2^130 + 12345), within M / 2 ~ 2^251
+    bignum_t x = BIGNUM_INIT, y = BIGNUM_INIT;
+    bool     negative;
+
+    bignum_set_u64(&x, 3);
+    for (int i = 0; i < 130; i++) {
+        bignum_add(&x, &x, &x);
+    }
+    bignum_add_u64(&x, &x, 12345);
+
+    for (size_t i = 0; i < 4; i++) {
+        residues[i] = primes[i] - bignum_divmod_u64(NULL, &x, primes[i]);
+    }
+
+    modp_crt(&y, &negative, primes, residues, 4);
+    ASSERT_TRUE(negative);
+    ASSERT_EQUALS(bignum_cmp(&x, &y), 0);
+
+    for (size_t i = 0; i < 4; i++) {
+        residues[i] = 42;
+    }
+
+    modp_crt(&y, &negative, primes, residues, 4);
+    ASSERT_FALSE(negative);
+    ASSERT_EQUALS(bignum_to_u64(&y), 42);
+
+    bignum_clear(&y);
+    bignum_clear(&x);
+    return TEST_PASS;
+}
+
+static bool matrix_modp_det_test(T* t)
+{
+    bool used[6] = { false };
+
+    // entries and denominators large enough for the minors to overflow
+    // 128 bits, against the expansion on scalars
+    for (size_t n = 1; n <= 6; n++) {
+        for (uint64_t seed = 0; seed < 4; seed++) {
+            matrix_t* a = matrix_random(n, n, seed % 2 == 0 ? 62 : 20, seed < 2 ? 1 : 1000003, seed + 10 * n);
+            scalar_t  r = zero, det = zero;
+
+            det_laplace(a, 0, used, &r);
+            matrix_modp_det(a, &det);
+            ASSERT_TRUE(scalar_equals(&det, &r));
+
+            scalar_t* d = matrix_det(a);
+            ASSERT_TRUE(scalar_equals(d, &r));
+            ASSERT_EQUALS(matrix_is_inversible(a), r.num != 0);
+
+            scalar_delete(d);
+            scalar_clear(&det);
+            scalar_clear(&r);
+            matrix_delete(a);
+        }
+    }
+
+    // det(A B) = det(A) det(B), on sizes that go through the pool
+    matrix_t* a  = matrix_random(40, 40, 40, 7, 1);
+    matrix_t* b  = matrix_random(40, 40, 40, 1, 2);
+    matrix_t* ab = matrix_prod(a, b);
+    scalar_t  x = zero, y = zero, z = zero;
+
+    matrix_modp_det(a, &x);
+    matrix_modp_det(b, &y);
+    matrix_modp_det(ab, &z);
+    scalar_mul(&x, &x, &y);
+
+    ASSERT_TRUE(scalar_is_big(&z));
+    ASSERT_TRUE(scalar_equals(&x, &z));
+
+    scalar_clear(&z);
+    scalar_clear(&y);
+    scalar_clear(&x);
+    matrix_delete(ab);
+    matrix_delete(b);
+    matrix_delete(a);
+    return TEST_PASS;
+}
+
+static bool matrix_rank_test(T* t)
+{
+    matrix_t* zeros = matrix_new(3, 5);
+    ASSERT_EQUALS(matrix_rank(zeros), 0);
+    matrix_delete(zeros);
+
+    // a product through an inner dimension of r has rank r
+    size_t shapes[][3] = { { 5, 7, 3 }, { 7, 5, 5 }, { 30, 20, 12 }, { 1, 9, 1 } };
+
+    for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+        size_t    m = shapes[s][0], n = shapes[s][1], r = shapes[s][2];
+        matrix_t* a = matrix_random(m, r, 50, 97, s);
+        matrix_t* b = matrix_random(r, n, 50, 1, s + 100);
+        matrix_t* c = matrix_prod(a, b);
+
+        ASSERT_EQUALS(matrix_rank(a), r);
+        ASSERT_EQUALS(matrix_rank(c), r);
+        ASSERT_EQUALS(matrix_is_inversible(c), m == n && n == r);
+
+        matrix_delete(c);
+        matrix_delete(b);
+        matrix_delete(a);
+    }
+
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(modp_field);
+    TEST(modp_is_prime);
+    TEST(modp_crt);
+    TEST(matrix_modp_det);
+    TEST(matrix_rank);
+
+    TEST_END();
+}
@@ -0,0 +1,139 @@
+#include "../pool.h"
+#include "test.h"
+#include <stdatomic.h>
+
+#define COUNT 10000
+
+static atomic_int visits[COUNT];
+
+static void visit(void* arg, size_t index)
+{
+    (void)arg;
+
+    // make the cost uneven so that stealing kicks in
+    volatile size_t spin = index % 7 == 0 ? 20000 : 10;
+    while (spin > 0) {
+        spin--;
+    }
+
+    atomic_fetch_add(&visits[index], 1);
+}
+
+static bool pool_run_test(T* t)
+{
+    size_t threads[] = { 1, 2, 4, 0 };
+
+    for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+        pool_set_threads(threads[k]);
+
+        for (size_t i = 0; i < COUNT; i++) {
+            atomic_store(&visits[i], 0);
+        }
+
+        pool_run(visit, NULL, COUNT);
+
+        for (size_t i = 0; i < COUNT; i++) {
+            ASSERT_EQUALS(atomic_load(&visits[i]), 1);
+        }
+    }
+
+    pool_shutdown();
+    return TEST_PASS;
+}
+
+static bool pool_set_threads_test(T* t)
+{
+    pool_set_threads(3);
+    ASSERT_EQUALS(pool_threads(), 3);
+
+    pool_set_threads(0);
+    ASSERT_TRUE(pool_threads() >= 1);
+
+    pool_shutdown();
+    return TEST_PASS;
+}
+
+#define GRAPH_TASKS 500
+
+typedef struct graph_state {
+    atomic_size_t clock;
+
+    // When each task ran, on the clock above
+    atomic_size_t at[GRAPH_TASKS];
+} graph_state_t;
+
+static void graph_visit(void* arg, size_t index)
+{
+    graph_state_t* state = arg;
+
+    visit(NULL, index);
+    atomic_store(&state->at[index], atomic_fetch_add(&state->clock, 1) + 1);
+}
+
+static bool pool_graph_test(T* t)
+{
+    static graph_state_t state;
+    size_t               threads[] = { 1, 4 };
+
+    for (size_t k = 0; k < sizeof(threads) / sizeof(threads[0]); k++) {
+        pool_set_threads(threads[k]);
+
+        pool_graph_t* graph = pool_graph_new();
+
+        atomic_store(&state.clock, 0);
+        for (size_t i = 0; i < GRAPH_TASKS; i++) {
+            atomic_store(&visits[i], 0);
+            atomic_store(&state.at[i], 0);
+            pool_graph_add(graph, graph_visit, &state, i, GRAPH_TASKS - i);
+        }
+
+        // every task waits on a few earlier ones
+        for (size_t i = 1; i < GRAPH_TASKS; i++) {
+            pool_graph_depend(graph, i, (i * 7919 + 13) % i);
+            pool_graph_depend(graph, i, i / 2);
+        }
+
+        pool_graph_run(graph);
+
+        for (size_t i = 1; i < GRAPH_TASKS; i++) {
+            ASSERT_EQUALS(atomic_load(&visits[i]), 1);
+            ASSERT_TRUE(atomic_load(&state.at[i]) > atomic_load(&state.at[(i * 7919 + 13) % i]));
+            ASSERT_TRUE(atomic_load(&state.at[i]) > atomic_load(&state.at[i / 2]));
+        }
+
+        pool_graph_delete(graph);
+        ASSERT_NULL(graph);
+    }
+
+    // on one thread, ready tasks go by priority: 0 first, then 2 before 1
+    pool_set_threads(1);
+
+    pool_graph_t* graph = pool_graph_new();
+
+    atomic_store(&state.clock, 0);
+    pool_graph_add(graph, graph_visit, &state, 0, 5);
+    pool_graph_add(graph, graph_visit, &state, 1, 2);
+    pool_graph_add(graph, graph_visit, &state, 2, 1);
+    pool_graph_depend(graph, 1, 0);
+    pool_graph_depend(graph, 2, 0);
+    pool_graph_run(graph);
+
+    ASSERT_EQUALS(atomic_load(&state.at[0]), 1);
+    ASSERT_EQUALS(atomic_load(&state.at[2]), 2);
+    ASSERT_EQUALS(atomic_load(&state.at[1]), 3);
+
+    pool_graph_delete(graph);
+    pool_shutdown();
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(pool_run);
+    TEST(pool_set_threads);
+    TEST(pool_graph);
+
+    TEST_END();
+}
@@ -1,14 +1,35 @@
+#include "../decimal.h"
+#include "../gcd.h"
 #include "../scalar.h"
 #include "test.h"
+#include <inttypes.h>
+#include <math.h>
+#include <string.h>
 
 static bool scalar_new_test(T* t)
 {
     scalar_t* scalar = scalar_new(1, 2, false);
     ASSERT_NOT_NULL(scalar);
-    ASSERT_EQUALS(scalar->a, 1);
-    ASSERT_EQUALS(scalar->b, 2);
-    ASSERT_FALSE(scalar->negative);
-    free(scalar);
+    ASSERT_EQUALS(scalar->num, 1);
+    ASSERT_EQUALS(scalar->den, 2);
+    ASSERT_FALSE(scalar_is_negative(scalar));
+    ASSERT_EQUALS(sizeof(*scalar), 16);
+    scalar_delete(scalar);
+
+    // inline numerators stop at INT64_MAX, so -2^63 and 2^64 - 1 promote
+    scalar = scalar_from(INT64_MIN);
+    ASSERT_TRUE(scalar_is_big(scalar));
+    ASSERT_TRUE(scalar_is_negative(scalar));
+    scalar_delete(scalar);
+
+    scalar = scalar_new(UINT64_MAX, 3, false);
+    ASSERT_FALSE(scalar_is_big(scalar));
+    ASSERT_EQUALS(scalar->num, UINT64_MAX / 3);
+    scalar_delete(scalar);
+
+    scalar = scalar_new(UINT64_MAX, 2, true);
+    ASSERT_TRUE(scalar_is_big(scalar));
+    scalar_delete(scalar);
     return TEST_PASS;
 }
 
@@ -31,28 +52,36 @@ static bool scalar_mul_test(T* t)
     // 1/2 * (-1/2) = -1/4
     scalar_mul(r, x, y);
 
-    ASSERT_EQUALS(r->a, z->a);
-    ASSERT_EQUALS(r->b, z->b);
-    ASSERT_EQUALS(r->negative, z->negative);
+    ASSERT_EQUALS(r->num, z->num);
+    ASSERT_EQUALS(r->den, z->den);
 
     // (-1/2) * 1/2 = -1/4
     scalar_mul(r, y, x);
 
-    ASSERT_EQUALS(r->a, z->a);
-    ASSERT_EQUALS(r->b, z->b);
-    ASSERT_EQUALS(r->negative, z->negative);
+    ASSERT_EQUALS(r->num, z->num);
+    ASSERT_EQUALS(r->den, z->den);
 
     // (-1/4) * (-1/4) = 1/16
     scalar_mul(r, r, r);
 
-    z->negative = false;
+    z->num = 1;
+    z->den = 16;
+
+    ASSERT_EQUALS(r->num, z->num);
+    ASSERT_EQUALS(r->den, z->den);
+
+    // a zero factor on either side, or divided, gives 0/1
+    scalar_mul(r, &zero, y);
+    ASSERT_EQUALS(r->num, 0);
+    ASSERT_EQUALS(r->den, 1);
 
-    z->a = 1;
-    z->b = 16;
+    scalar_mul(r, z, &zero);
+    ASSERT_EQUALS(r->num, 0);
+    ASSERT_EQUALS(r->den, 1);
 
-    ASSERT_EQUALS(r->a, z->a);
-    ASSERT_EQUALS(r->b, z->b);
-    ASSERT_EQUALS(r->negative, z->negative);
+    scalar_div(r, &zero, z);
+    ASSERT_EQUALS(r->num, 0);
+    ASSERT_EQUALS(r->den, 1);
 
     scalar_delete(r);
     scalar_delete(z);
@@ -61,6 +90,299 @@ static bool scalar_mul_test(T* t)
     return TEST_PASS;
 }
 
+static bool scalar_add_test(T* t)
+{
+    int64_t cases[][3] = {
+        { -3, -1, -4 },
+        { -3, 1, -2 },
+        { 3, -1, 2 },
+        { 1, -1, 0 },
+        { -1, 3, 2 },
+        { 2, 3, 5 },
+    };
+
+    scalar_t* r = scalar_from(0);
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        scalar_t* x = scalar_from(cases[i][0]);
+        scalar_t* y = scalar_from(cases[i][1]);
+        scalar_t* z = scalar_from(cases[i][2]);
+
+        scalar_add(r, x, y);
+        ASSERT_TRUE(scalar_equals(r, z));
+
+        scalar_delete(z);
+        scalar_delete(y);
+        scalar_delete(x);
+    }
+
+    // (-1/2) + 1/3 = -1/6
+    scalar_t* x = scalar_new(1, 2, true);
+    scalar_t* y = scalar_new(1, 3, false);
+
+    scalar_add(r, x, y);
+
+    ASSERT_EQUALS(r->num, -1);
+    ASSERT_EQUALS(r->den, 6);
+    ASSERT_TRUE(scalar_is_negative(r));
+
+    scalar_delete(y);
+    scalar_delete(x);
+    scalar_delete(r);
+    return TEST_PASS;
+}
+
+static bool scalar_overflow_test(T* t)
+{
+    uint64_t big = (uint64_t)1 << 40;
+
+    scalar_t* x = scalar_new(big, 3, false);
+    scalar_t* y = scalar_new(3, big, false);
+    scalar_t* r = scalar_from(0);
+
+    // 2^40/3 * 3/2^40 = 1, the factors cancel before anything is multiplied
+    ASSERT_EQUALS(scalar_mul(r, x, y), SCALAR_OK);
+    ASSERT_TRUE(scalar_equals(r, &one));
+
+    // 2^40/3 * 2^40/3 needs 80 bits, r is promoted
+    ASSERT_EQUALS(scalar_mul(r, x, x), SCALAR_OVERFLOW);
+    ASSERT_TRUE(scalar_is_big(r));
+    ASSERT_TRUE(scalar_greater_than(r, x));
+
+    char* str = scalar_string(r);
+    ASSERT_TRUE(strcmp(str, "1208925819614629174706176/9") == 0);
+    free(str);
+
+    // 2^80 / 9 as a double, and its opposite
+    ASSERT_TRUE(fabs(scalar_to_double(r) / 0x1p80 * 9 - 1) < 1e-15);
+    scalar_opposite(r, r);
+    ASSERT_TRUE(fabs(scalar_to_double(r) / 0x1p80 * 9 + 1) < 1e-15);
+    scalar_opposite(r, r);
+    ASSERT_TRUE(scalar_to_double(y) == 3 / 0x1p40);
+
+    // and demoted again once the value fits: 2^80/9 . (3/2^40)^2 = 1
+    ASSERT_EQUALS(scalar_mul(r, r, y), SCALAR_OK);
+    ASSERT_FALSE(scalar_is_big(r));
+    ASSERT_EQUALS(scalar_mul(r, r, y), SCALAR_OK);
+    ASSERT_TRUE(scalar_equals(r, &one));
+
+    // a promoted sum cancelled by a subtraction
+    scalar_t* w = scalar_from(INT64_MAX);
+    ASSERT_EQUALS(scalar_add(r, w, w), SCALAR_OVERFLOW);
+    ASSERT_EQUALS(scalar_sub(r, r, w), SCALAR_OK);
+    ASSERT_TRUE(scalar_equals(r, w));
+    scalar_delete(w);
+
+    // 1/2^40 + 1/2^40 = 1/2^39, the lcm is never formed as a product
+    ASSERT_EQUALS(scalar_add(r, y, y), SCALAR_OK);
+    ASSERT_EQUALS(r->num, 3);
+    ASSERT_EQUALS(r->den, big / 2);
+
+    // -3 < -1
+    scalar_t* u = scalar_from(-3);
+    scalar_t* v = scalar_from(-1);
+    ASSERT_TRUE(scalar_less_than(u, v));
+
+    scalar_delete(v);
+    scalar_delete(u);
+    scalar_delete(r);
+    scalar_delete(y);
+    scalar_delete(x);
+    return TEST_PASS;
+}
+
+static bool scalar_acc_test(T* t)
+{
+    scalar_acc_t acc = SCALAR_ACC_INIT;
+    scalar_t*    r   = scalar_from(0);
+
+    // sum 1/k . 1/(k + 1) for k = 1..10 telescopes to 10/11, deferred over
+    // the lcm of the denominators
+    for (uint64_t k = 1; k <= 10; k++) {
+        scalar_t* x = scalar_new(1, k, false);
+        scalar_t* y = scalar_new(1, k + 1, false);
+        scalar_acc_add_mul(&acc, x, y);
+        scalar_delete(y);
+        scalar_delete(x);
+    }
+
+    ASSERT_EQUALS(scalar_acc_get(r, &acc), SCALAR_OK);
+    ASSERT_EQUALS(r->num, 10);
+    ASSERT_EQUALS(r->den, 11);
+    scalar_acc_clear(&acc);
+
+    // (2^63 - 1)^2 four times overflows 128 bits, the pending part is folded
+    scalar_t* w = scalar_from(INT64_MAX);
+    scalar_t* e = scalar_from(0);
+    scalar_t* p = scalar_mul_get(w, w);
+
+    for (size_t i = 0; i < 4; i++) {
+        scalar_acc_add_mul(&acc, w, w);
+        scalar_add(e, e, p);
+    }
+
+    ASSERT_EQUALS(scalar_acc_get(r, &acc), SCALAR_OVERFLOW);
+    ASSERT_TRUE(scalar_equals(r, e));
+
+    // and cancelled back to an inline zero
+    for (size_t i = 0; i < 4; i++) {
+        scalar_acc_sub_mul(&acc, w, w);
+    }
+
+    ASSERT_EQUALS(scalar_acc_get(r, &acc), SCALAR_OK);
+    ASSERT_TRUE(scalar_equals(r, &zero));
+    scalar_acc_clear(&acc);
+
+    // 1/2^80 has no 64-bit denominator and goes to the eager sum
+    scalar_t* y = scalar_new(1, (uint64_t)1 << 40, false);
+    scalar_acc_add(&acc, &one);
+    scalar_acc_add_mul(&acc, y, y);
+    scalar_acc_add_mul(&acc, y, y);
+    scalar_acc_sub_mul(&acc, &one, &one);
+
+    ASSERT_EQUALS(scalar_acc_get(r, &acc), SCALAR_OVERFLOW);
+    scalar_mul(e, y, y);
+    scalar_add(e, e, e);
+    ASSERT_TRUE(scalar_equals(r, e));
+
+    // promoted operands as well
+    scalar_acc_add(&acc, r);
+    ASSERT_EQUALS(scalar_acc_get(r, &acc), SCALAR_OVERFLOW);
+    scalar_add(e, e, e);
+    ASSERT_TRUE(scalar_equals(r, e));
+    scalar_acc_clear(&acc);
+
+    scalar_delete(y);
+    scalar_delete(p);
+    scalar_delete(e);
+    scalar_delete(w);
+    scalar_delete(r);
+    return TEST_PASS;
+}
+
+static bool scalar_val_test(T* t)
+{
+    // results by value take nothing from the current allocator
+    arena_t*     arena    = arena_new(1024);
+    allocator_t* previous = alloc_use(&arena->base);
+
+    scalar_t x = scalar_make(6, 4, false);
+    scalar_t y = scalar_of(-5);
+    ASSERT_EQUALS(x.num, 3);
+    ASSERT_EQUALS(x.den, 2);
+
+    scalar_t s = scalar_add_val(&x, &y);
+    ASSERT_EQUALS(s.num, -7);
+    ASSERT_EQUALS(s.den, 2);
+
+    scalar_t d = scalar_div_val(&x, &y);
+    ASSERT_EQUALS(d.num, -3);
+    ASSERT_EQUALS(d.den, 10);
+
+    scalar_t n = scalar_inverse_val(&d);
+    ASSERT_EQUALS(n.num, -10);
+    ASSERT_EQUALS(n.den, 3);
+
+    scalar_t a = scalar_abs_val(&n);
+    scalar_t o = scalar_opposite_val(&n);
+    ASSERT_TRUE(scalar_equals(&a, &o));
+
+    scalar_t k = scalar_scale_val(&x, 4, true);
+    ASSERT_EQUALS(k.num, -6);
+    ASSERT_EQUALS(k.den, 1);
+
+    ASSERT_EQUALS(arena->used, 0);
+
+    // a promoted result is cleared like any other temporary
+    scalar_t w = scalar_of(INT64_MAX);
+    scalar_t p = scalar_mul_val(&w, &w);
+    ASSERT_TRUE(scalar_is_big(&p));
+
+    scalar_t q = scalar_sub_val(&p, &p);
+    ASSERT_TRUE(scalar_equals(&q, &zero));
+    scalar_clear(&p);
+
+    // and the *_get helpers agree, from the current allocator
+    scalar_t* g = scalar_mul_get(&x, &y);
+    scalar_t  m = scalar_mul_val(&x, &y);
+    ASSERT_TRUE(scalar_equals(g, &m));
+    ASSERT_NOT_EQUAL(arena->used, 0);
+    scalar_delete(g);
+
+    alloc_use(previous);
+    arena_delete(arena);
+    return TEST_PASS;
+}
+
+static bool uint64_gcd_test(T* t)
+{
+    uint64_t cases[][2] = {
+        { 0, 0 },
+        { 0, 12 },
+        { 1, 99 },
+        { 48, 18 },
+        { 1024, 96 },
+        { 96, 4096 },
+        { 3 * 5 * 7 * 11 * 13, 5 * 13 * 17 },
+        { UINT64_MAX, UINT64_MAX - 1 },
+        { (uint64_t)1 << 63, (uint64_t)3 << 61 },
+    };
+
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint64_t a = cases[i][0];
+        uint64_t b = cases[i][1];
+
+        ASSERT_EQUALS(uint64_gcd_binary(a, b), uint64_gcd_euclid(a, b));
+        ASSERT_EQUALS(uint64_gcd_binary(b, a), uint64_gcd_euclid(a, b));
+    }
+
+    return TEST_PASS;
+}
+
+static bool scalar_write_test(T* t)
+{
+    char str[64], ref[64];
+
+    // every length on both sides of each power of ten
+    for (size_t k = 0; k < 20; k++) {
+        uint64_t p = decimal_powers[k];
+        uint64_t xs[] = { p - 1, p, p + 1, p * 3 };
+
+        for (size_t i = 0; i < 4; i++) {
+            size_t len = sprintf(ref, "%" PRIu64, xs[i]);
+
+            ASSERT_EQUALS(decimal_length(xs[i]), len);
+            decimal_write(str, xs[i], len);
+            ASSERT_TRUE(memcmp(str, ref, len) == 0);
+        }
+    }
+    ASSERT_EQUALS(decimal_length(UINT64_MAX), 20);
+
+    // zero padded to the length asked for
+    decimal_write(str, 42, 5);
+    ASSERT_TRUE(memcmp(str, "00042", 5) == 0);
+
+    scalar_t xs[] = {
+        zero,
+        scalar_of(-7),
+        scalar_of(INT64_MAX),
+        scalar_of(-INT64_MAX),
+        scalar_make(INT64_MAX, UINT64_MAX, true),
+        scalar_make(100, 999, false),
+    };
+
+    for (size_t i = 0; i < sizeof(xs) / sizeof(xs[0]); i++) {
+        size_t len = xs[i].den == 1 ? sprintf(ref, "%" PRId64, xs[i].num)
+                                    : sprintf(ref, "%" PRId64 "/%" PRIu64, xs[i].num, xs[i].den);
+
+        ASSERT_EQUALS(scalar_write(str, &xs[i]), len);
+        ASSERT_EQUALS(scalar_string_length(&xs[i]), len + 1);
+        ASSERT_TRUE(strcmp(str, ref) == 0);
+    }
+
+    return TEST_PASS;
+}
+
 int main(void)
 {
     TEST_INIT();
@@ -68,6 +390,12 @@ int main(void)
     TEST(scalar_new);
     TEST(scalar_delete);
     TEST(scalar_mul);
+    TEST(scalar_add);
+    TEST(scalar_overflow);
+    TEST(scalar_acc);
+    TEST(scalar_val);
+    TEST(uint64_gcd);
+    TEST(scalar_write);
 
     TEST_END();
 }
\ No newline at end of file
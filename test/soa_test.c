@@ -0,0 +1,133 @@
+#include "../soa.h"
+#include "fixture.h"
+#include "test.h"
+
+#define SIZE 37
+
+static soa_isa_t isas[] = { SOA_ISA_SCALAR, SOA_ISA_AVX2, SOA_ISA_AVX512 };
+
+// Integers, fractions over a shared denominator and unrelated fractions,
+// so that every block mixes the fast and the general lanes
+static scalar_t mixed(uint64_t seed, size_t i)
+{
+    uint64_t a = fixture_spread(seed, i) % 100000;
+    uint64_t b = i % 3 == 0 ? 1 : i % 3 == 1 ? 6 : 1 + (a + i) % 97;
+
+    return scalar_make(a, b, (a + seed) % 2);
+}
+
+static bool soa_add_test(T* t)
+{
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        soa_set_isa(isas[k]);
+
+        vector_t* u = vector_fixture(SIZE, 1, mixed);
+        vector_t* v = vector_fixture(SIZE, 2, mixed);
+        soa_t*    x = soa_from_vector(u);
+        soa_t*    y = soa_from_vector(v);
+        soa_t*    r = soa_new(SIZE);
+
+        ASSERT_EQUALS(soa_add(r, x, y), SCALAR_OK);
+        vector_t* sum = soa_to_vector(r);
+        vector_add(u, v);
+        ASSERT_TRUE(vector_equals(sum, u));
+
+        // in place, twice back to where it started
+        ASSERT_EQUALS(soa_sub(r, r, y), SCALAR_OK);
+        ASSERT_EQUALS(soa_sub(r, r, x), SCALAR_OK);
+        soa_normalize(r);
+        for (size_t i = 0; i < SIZE; i++) {
+            ASSERT_EQUALS(r->num[i], 0);
+            ASSERT_EQUALS(r->den[i], 1);
+        }
+
+        vector_delete(sum);
+        soa_delete(r);
+        soa_delete(y);
+        soa_delete(x);
+        vector_delete(v);
+        vector_delete(u);
+    }
+
+    soa_set_isa(SOA_ISA_AVX512);
+    return TEST_PASS;
+}
+
+static bool soa_scale_test(T* t)
+{
+    scalar_t* factors[] = { scalar_from(-3), scalar_from(1L << 40), scalar_new(5, 7, true) };
+
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        soa_set_isa(isas[k]);
+
+        for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); f++) {
+            vector_t* u = vector_fixture(SIZE, 3, mixed);
+            soa_t*    x = soa_from_vector(u);
+
+            ASSERT_EQUALS(soa_scale(x, x, factors[f]), SCALAR_OK);
+            vector_t* scaled = soa_to_vector(x);
+            vector_scale(u, factors[f]);
+            ASSERT_TRUE(vector_equals(scaled, u));
+
+            vector_delete(scaled);
+            soa_delete(x);
+            vector_delete(u);
+        }
+    }
+
+    for (size_t f = 0; f < sizeof(factors) / sizeof(factors[0]); f++) {
+        scalar_delete(factors[f]);
+    }
+
+    soa_set_isa(SOA_ISA_AVX512);
+    return TEST_PASS;
+}
+
+static bool soa_overflow_test(T* t)
+{
+    for (size_t k = 0; k < sizeof(isas) / sizeof(isas[0]); k++) {
+        soa_set_isa(isas[k]);
+
+        soa_t* x = soa_new(SIZE);
+        soa_t* r = soa_new(SIZE);
+
+        // INT64_MAX + 1 doesn't fit, even though its neighbours do
+        x->num[9] = INT64_MAX;
+        x->num[10] = 1;
+        ASSERT_EQUALS(soa_add(r, x, x), SCALAR_OVERFLOW);
+        ASSERT_EQUALS(r->num[10], 2);
+
+        scalar_t* half = scalar_new(1, 2, false);
+        ASSERT_EQUALS(soa_scale(r, x, half), SCALAR_OK);
+        ASSERT_EQUALS(r->den[9], 2);
+
+        scalar_delete(half);
+        soa_delete(r);
+        soa_delete(x);
+    }
+
+    // promoted values have no place in a buffer
+    vector_t* u = vector_new(3);
+    scalar_t* w = scalar_from(INT64_MAX);
+    scalar_add(&u->items[1], w, w);
+
+    soa_t* x = soa_from_vector(u);
+    ASSERT_NULL(x);
+
+    scalar_delete(w);
+    vector_delete(u);
+
+    soa_set_isa(SOA_ISA_AVX512);
+    return TEST_PASS;
+}
+
+int main(void)
+{
+    TEST_INIT();
+
+    TEST(soa_add);
+    TEST(soa_scale);
+    TEST(soa_overflow);
+
+    TEST_END();
+}
@@ -26,7 +26,7 @@
 
 #define IF_NULL(callback, ptr_expr)                     \
     {                                                   \
-        void* ptr = (ptr_expr);                         \
+        const void* ptr = (ptr_expr);                   \
         if (ptr == NULL) {                              \
             (callback)(#ptr_expr " evaluated to NULL"); \
         }                                               \
@@ -34,10 +34,15 @@
 
 #define CHECK_NOT_NULL(ptr_expr)                         \
     {                                                    \
-        void* ptr = (ptr_expr);                          \
+        const void* ptr = (ptr_expr);                    \
         if (ptr == NULL) {                               \
             ERROR("%s", #ptr_expr " evaluated to NULL"); \
         }                                                \
     }
 
+/* -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- -*- */
+
+typedef __int128          int128_t;
+typedef unsigned __int128 uint128_t;
+
 #endif /* utils.h */
\ No newline at end of file
@@ -1,25 +1,28 @@
 #include "vector.h"
+#include "integer.h"
 #include "matrix.h"
 #include "utils.h"
 
 vector_t* vector_new(size_t n)
 {
-    vector_t* vector = malloc(sizeof(*vector));
-    CHECK_NOT_NULL(vector);
-
-    vector->n = n;
+    // The header and the items share a single block, taken from the
+    // current allocator
+    vector_t* vector = alloc_new(sizeof(*vector) + n * sizeof(scalar_t));
 
-    vector->items = malloc(n * sizeof(scalar_t));
-    CHECK_NOT_NULL(vector->items);
+    vector->n       = n;
+    vector->integer = true;
+    vector->stride  = 1;
+    vector->items   = (scalar_t*)(vector + 1);
 
+    // Raw stores: scalar_copy would read the uninitialized destination
     for (size_t i = 0; i < n; i++) {
-        scalar_copy(&vector->items[i], &zero);
+        vector->items[i] = zero;
     }
 
     return vector;
 }
 
-vector_t* vector_from(scalar_t* vals, size_t n)
+vector_t* vector_from(const scalar_t* vals, size_t n)
 {
     CHECK_NOT_NULL(vals);
 
@@ -29,45 +32,71 @@ vector_t* vector_from(scalar_t* vals, size_t n)
         scalar_copy(&vector->items[i], &vals[i]);
     }
 
+    vector_refresh_integer(vector);
     return vector;
 }
 
-void vector_copy(vector_t* u, vector_t* v)
+// A view of n items stored stride scalars apart from items on. It shares
+// that storage, so it must not be deleted, and writing through it leaves the
+// integer flag of the vector or matrix owning the storage to be refreshed.
+vector_t vector_view(scalar_t* items, size_t n, size_t stride)
+{
+    CHECK_NOT_NULL(items);
+
+    vector_t view = { .n = n, .stride = stride, .items = items };
+
+    vector_refresh_integer(&view);
+    return view;
+}
+
+void vector_copy(vector_t* u, const vector_t* v)
 {
     CHECK_NOT_NULL(u);
     CHECK_NOT_NULL(v);
 
-    u->n = v->n;
+    u->n       = v->n;
+    u->integer = v->integer;
     for (size_t i = 0; i < v->n; i++) {
-        scalar_copy(&u->items[i], &v->items[i]);
+        scalar_copy(&vector_at(u, i), &vector_at(v, i));
     }
 }
 
-void vector_scale(vector_t* vector, scalar_t* scalar)
+void vector_refresh_integer(vector_t* vector)
 {
     CHECK_NOT_NULL(vector);
-    CHECK_NOT_NULL(scalar);
 
-    for (size_t i = 0; i < vector->n; i++) {
-        scalar_mul(&vector->items[i], &vector->items[i], scalar);
+    if (vector->stride == 1) {
+        vector->integer = integer_all(vector->items, vector->n);
+        return;
+    }
+
+    vector->integer = true;
+    for (size_t i = 0; i < vector->n && vector->integer; i++) {
+        vector->integer = vector_at(vector, i).den == 1;
     }
 }
 
-void vector_add(vector_t* u, vector_t* v)
+void vector_scale(vector_t* vector, const scalar_t* scalar)
 {
-    CHECK_NOT_NULL(u);
-    CHECK_NOT_NULL(v);
+    CHECK_NOT_NULL(vector);
+    CHECK_NOT_NULL(scalar);
 
-    if (u->n != v->n) {
-        ERROR("vector dimension mismatch (u=%zu, v=%zu)\n", u->n, v->n);
+    // The int64 kernels run on contiguous items, strided views take the
+    // scalar loop
+    if (vector->integer && vector->stride == 1 && scalar->den == 1
+        && integer_bits(vector->items, vector->n) + integer_bits(scalar, 1) <= 63) {
+        integer_scale(vector->items, vector->n, scalar->num);
+        return;
     }
 
-    for (size_t i = 0; i < v->n; i++) {
-        scalar_add(&u->items[i], &u->items[i], &v->items[i]);
+    for (size_t i = 0; i < vector->n; i++) {
+        scalar_mul(&vector_at(vector, i), &vector_at(vector, i), scalar);
     }
+
+    vector_refresh_integer(vector);
 }
 
-void vector_sub(vector_t* u, vector_t* v)
+static void vector_add_sub(vector_t* u, const vector_t* v, bool sub)
 {
     CHECK_NOT_NULL(u);
     CHECK_NOT_NULL(v);
@@ -76,12 +105,33 @@ void vector_sub(vector_t* u, vector_t* v)
         ERROR("vector dimension mismatch (u=%zu, v=%zu)\n", u->n, v->n);
     }
 
+    if (u->integer && v->integer && u->stride == 1 && v->stride == 1
+        && integer_add(u->items, v->items, u->n, sub)) {
+        return;
+    }
+
     for (size_t i = 0; i < v->n; i++) {
-        scalar_sub(&u->items[i], &u->items[i], &v->items[i]);
+        if (sub) {
+            scalar_sub(&vector_at(u, i), &vector_at(u, i), &vector_at(v, i));
+        } else {
+            scalar_add(&vector_at(u, i), &vector_at(u, i), &vector_at(v, i));
+        }
     }
+
+    vector_refresh_integer(u);
+}
+
+void vector_add(vector_t* u, const vector_t* v)
+{
+    vector_add_sub(u, v, false);
 }
 
-scalar_t* vector_dot_prod(vector_t* u, vector_t* v)
+void vector_sub(vector_t* u, const vector_t* v)
+{
+    vector_add_sub(u, v, true);
+}
+
+scalar_t vector_dot_prod_val(const vector_t* u, const vector_t* v)
 {
     CHECK_NOT_NULL(u);
     CHECK_NOT_NULL(v);
@@ -90,64 +140,112 @@ scalar_t* vector_dot_prod(vector_t* u, vector_t* v)
         ERROR("vector dimension mismatch (u=%zu, v=%zu)", u->n, v->n);
     }
 
-    scalar_t* prod = scalar_from(0);
+    scalar_t     prod = zero;
+    scalar_acc_t acc  = SCALAR_ACC_INIT;
+    int128_t     sum;
+
+    if (u->integer && v->integer && u->stride == 1 && v->stride == 1
+        && integer_dot(u->items, v->items, u->n, &sum)) {
+        scalar_set_int128(&prod, sum);
+        return prod;
+    }
 
-    scalar_t* tmp = scalar_from(0);
     for (size_t i = 0; i < u->n; i++) {
-        scalar_mul(tmp, &u->items[i], &v->items[i]);
-        scalar_add(prod, prod, tmp);
+        scalar_acc_add_mul(&acc, &vector_at(u, i), &vector_at(v, i));
     }
-    free(tmp);
+
+    scalar_acc_get(&prod, &acc);
+    scalar_acc_clear(&acc);
 
     return prod;
 }
 
-scalar_t* vector_get(vector_t* vector, size_t i)
+scalar_t* vector_dot_prod(const vector_t* u, const vector_t* v)
 {
+    scalar_t  value = vector_dot_prod_val(u, v);
+    scalar_t* prod  = alloc_new(sizeof(*prod));
+
+    *prod = value;
+    return prod;
+}
+
+static const scalar_t* vector_item(const vector_t* vector, size_t i)
+{
+    CHECK_NOT_NULL(vector);
+
     if (i >= vector->n) {
         ERROR("index out of bounds (i=%zu, size=%zu)", i, vector->n);
     }
 
-    return scalar_duplicate(&vector->items[i]);
+    return &vector_at(vector, i);
 }
 
-void vector_set(vector_t* vector, size_t i, scalar_t* scalar)
+// The item itself, to read or update in place without a copy. A write that
+// leaves a non-integer there clears the integer flag only through
+// vector_refresh_integer.
+scalar_t* vector_ptr(vector_t* vector, size_t i)
 {
-    if (i >= vector->n) {
-        ERROR("index out of bounds (i=%zu,size=%zu)", i, vector->n);
+    vector_item(vector, i);
+    return &vector_at(vector, i);
+}
+
+// A copy of the item, to be cleared by the caller if it is promoted
+scalar_t vector_val(const vector_t* vector, size_t i)
+{
+    scalar_t value = zero;
+
+    scalar_copy(&value, vector_item(vector, i));
+    return value;
+}
+
+scalar_t* vector_get(const vector_t* vector, size_t i)
+{
+    return scalar_duplicate(vector_item(vector, i));
+}
+
+void vector_set(vector_t* vector, size_t i, const scalar_t* scalar)
+{
+    CHECK_NOT_NULL(scalar);
+
+    scalar_t* item = vector_ptr(vector, i);
+
+    if (scalar->den != 1) {
+        vector->integer = false;
     }
 
-    scalar_copy(&vector->items[i], scalar);
+    scalar_copy(item, scalar);
 }
 
-char* vector_string(vector_t* vector)
+char* vector_string(const vector_t* vector)
 {
     CHECK_NOT_NULL(vector);
 
     char* str = malloc(vector_string_length(vector));
     CHECK_NOT_NULL(str);
 
-    char *ofs, *tmp;
+    char* ofs = str;
 
-    ofs = str + sprintf(str, "[");
+    *ofs++ = '[';
     for (size_t i = 0; i < vector->n; i++) {
-        tmp = scalar_string(&vector->items[i]);
-        ofs += sprintf(ofs, i == 0 ? "%s" : " %s", tmp);
-        free(tmp);
+        if (i > 0) {
+            *ofs++ = ' ';
+        }
+        ofs += scalar_write(ofs, &vector_at(vector, i));
     }
-    sprintf(ofs, "]");
+    *ofs++ = ']';
+    *ofs   = '\0';
 
     return str;
 }
 
-size_t vector_string_length(vector_t* vector)
+size_t vector_string_length(const vector_t* vector)
 {
     CHECK_NOT_NULL(vector);
 
     size_t len = 3; // '[' + ']' + '\0'
 
     for (size_t i = 0; i < vector->n; i++) {
-        len += scalar_string_length(&vector->items[i]) + 2; // ' ' + scalar
+        len += scalar_string_length(&vector_at(vector, i)) + 2; // ' ' + scalar
     }
 
     // remove first ' ' if vector isn't empty
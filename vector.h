@@ -1,33 +1,54 @@
 #ifndef TD_VECTOR_H
 #define TD_VECTOR_H
 
+#include "alloc.h"
 #include "scalar.h"
+#include <stdbool.h>
 #include <stddef.h>
 
 typedef struct matrix matrix_t;
 
 typedef struct vector {
-    size_t    n;
+    // Aligned like a scalar, so the items allocated right after the header
+    // are as well
+    _Alignas(scalar_t) size_t n;
+
+    // Set when every item is an inline integer, the arithmetic below then
+    // runs on int64 kernels. The functions of the library keep it exact;
+    // code writing items directly has to call vector_refresh_integer.
+    bool integer;
+
+    // The distance (in scalars) between two consecutive items: 1 for the
+    // vectors the library allocates, anything for views into other storage
+    size_t stride;
+
     scalar_t* items;
 } vector_t;
 
-#define vector_delete(vector)  \
-    if ((vector) != NULL) {    \
-        free((vector)->items); \
-        free(vector);          \
-        (vector) = NULL;       \
+#define vector_at(vector, i) ((vector)->items[(i) * (vector)->stride])
+
+#define vector_delete(vector)                            \
+    if ((vector) != NULL) {                              \
+        scalar_clear_all((vector)->items, (vector)->n); \
+        alloc_free(vector);                              \
+        (vector) = NULL;                                 \
     }
 
 vector_t* vector_new(size_t n);
-vector_t* vector_from(scalar_t* vals, size_t n);
-void      vector_copy(vector_t* dst, vector_t* src);
-void      vector_scale(vector_t* vector, scalar_t* scalar);
-void      vector_add(vector_t* u, vector_t* v);
-void      vector_sub(vector_t* u, vector_t* v);
-scalar_t* vector_dot_prod(vector_t* u, vector_t* v);
-scalar_t* vector_get(vector_t* vector, size_t i);
-void      vector_set(vector_t* vector, size_t i, scalar_t* x);
-char*     vector_string(vector_t* vector);
-size_t    vector_string_length(vector_t* vector);
+vector_t* vector_from(const scalar_t* vals, size_t n);
+vector_t  vector_view(scalar_t* items, size_t n, size_t stride);
+void      vector_copy(vector_t* dst, const vector_t* src);
+void      vector_refresh_integer(vector_t* vector);
+void      vector_scale(vector_t* vector, const scalar_t* scalar);
+void      vector_add(vector_t* u, const vector_t* v);
+void      vector_sub(vector_t* u, const vector_t* v);
+scalar_t  vector_dot_prod_val(const vector_t* u, const vector_t* v);
+scalar_t* vector_dot_prod(const vector_t* u, const vector_t* v);
+scalar_t* vector_ptr(vector_t* vector, size_t i);
+scalar_t  vector_val(const vector_t* vector, size_t i);
+scalar_t* vector_get(const vector_t* vector, size_t i);
+void      vector_set(vector_t* vector, size_t i, const scalar_t* x);
+char*     vector_string(const vector_t* vector);
+size_t    vector_string_length(const vector_t* vector);
 
 #endif /* vector.h */